@@ -0,0 +1,8 @@
+#version 330 core
+
+out vec4 o_FinalColor;
+
+void main()
+{
+	o_FinalColor = vec4(1.0, 0.0, 1.0, 1.0);
+}
\ No newline at end of file
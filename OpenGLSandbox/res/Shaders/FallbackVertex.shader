@@ -0,0 +1,9 @@
+#version 330 core
+
+// drawn in place of a program that is still compiling
+layout(location = 0) in vec2 a_Position;
+
+void main()
+{
+	gl_Position = vec4(a_Position, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 TexCoords;
+in vec4 QuadColor;
+out vec4 color;
+
+uniform sampler2DArray u_Textures;
+
+void main()
+{
+    color = QuadColor * texture(u_Textures, TexCoords);
+}
\ No newline at end of file
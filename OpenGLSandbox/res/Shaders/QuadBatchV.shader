@@ -0,0 +1,23 @@
+#version 330 core
+layout(location = 0) in vec2 a_Corner; // unit quad, (0,0) to (1,1)
+layout(location = 1) in vec3 a_TransformX; // <x axis, x translation>
+layout(location = 2) in vec3 a_TransformY; // <y axis, y translation>
+layout(location = 3) in vec4 a_UVRect;
+layout(location = 4) in vec4 a_Color;
+layout(location = 5) in float a_Layer;
+out vec3 TexCoords; // <uv, texture array layer>
+out vec4 QuadColor;
+
+layout(std140) uniform Frame
+{
+    mat4 u_ScreenProjection; // pixels to clip space
+    vec4 u_Time; // x: seconds since start
+};
+
+void main()
+{
+    vec2 position = vec2(dot(a_TransformX, vec3(a_Corner, 1.0)), dot(a_TransformY, vec3(a_Corner, 1.0)));
+    gl_Position = u_ScreenProjection * vec4(position, 0.0, 1.0);
+    TexCoords = vec3(mix(a_UVRect.xy, a_UVRect.zw, a_Corner), a_Layer);
+    QuadColor = a_Color;
+}
\ No newline at end of file
@@ -1,11 +1,32 @@
 #version 330 core
-layout(location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
-out vec2 TexCoords;
+layout(location = 0) in vec3 a_PositionScale; // <vec2 pen position, float scale>
+layout(location = 1) in uint a_GlyphIndex;
+layout(location = 2) in vec4 a_Color;
+out vec3 TexCoords; // <uv, atlas page>
+out vec4 TextColor;
 
-uniform mat4 projection;
+layout(std140) uniform Frame
+{
+    mat4 u_ScreenProjection; // pixels to clip space
+    vec4 u_Time; // x: seconds since start
+};
+uniform samplerBuffer u_Glyphs; // per glyph: <vec2 size, vec2 bearing>, <vec4 uv rect>, <float page>
+
+const int GlyphStride = 3;
 
 void main()
 {
-    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vertex.zw;
+    vec4 metrics = texelFetch(u_Glyphs, int(a_GlyphIndex) * GlyphStride);
+    vec4 uvRect = texelFetch(u_Glyphs, int(a_GlyphIndex) * GlyphStride + 1);
+    float page = texelFetch(u_Glyphs, int(a_GlyphIndex) * GlyphStride + 2).x;
+
+    // triangle strip corners (0,0) (1,0) (0,1) (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    float scale = a_PositionScale.z;
+    vec2 origin = a_PositionScale.xy + vec2(metrics.z, metrics.w - metrics.y) * scale;
+
+    gl_Position = u_ScreenProjection * vec4(origin + corner * metrics.xy * scale, 0.0, 1.0);
+    // glyph bitmaps are stored top row first
+    TexCoords = vec3(mix(uvRect.xy, uvRect.zw, vec2(corner.x, 1.0 - corner.y)), page);
+    TextColor = a_Color;
 }
\ No newline at end of file
@@ -1,32 +1,117 @@
 #include "Application.h"
 #include <iostream>
 #include <cassert>
-#include "Utilities/Timer.h"
+#include "Utilities/Profiler.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include "msdfgen.h"
-#include "msdfgen-ext.h"
+#include "Utilities/MSDFAtlasGenerator.h"
+#include "Utilities/FontCache.h"
+#include "Utilities/BitmapFontAtlas.h"
+#include "Utilities/ShaderCache.h"
+#include "Utilities/ShaderCompiler.h"
+#include "Utilities/FileSystem.h"
+#include "Renderer/RenderState.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Utilities/SPSCQueue.h"
+#include "Utilities/JobSystem.h"
 #include "stb_image_write.h"
 
 namespace OpenGLSandbox {
 
 	namespace Utils {
 
-		/// Clamps the number to the interval from 0 to b.
-		template <typename T>
-		inline T clamp(T n, T b) {
-			return n >= T(0) && n <= b ? n : T(n > T(0)) * b;
+		static void OnResize(GLFWwindow* window, int width, int height)
+		{
+			// note that width and height will be significantly larger than specified on retina displays.
+			Application* application = (Application*)glfwGetWindowUserPointer(window);
+			application->OnResize(width, height);
 		}
-		
-		inline byte pixelFloatToByte(float x) {
-			return byte(clamp(256.f * x, 255.f));
+
+		static void OnKey(GLFWwindow* window, int, int, int, int)
+		{
+			((Application*)glfwGetWindowUserPointer(window))->Invalidate();
 		}
 
-		static void OnResize(GLFWwindow* window, int width, int height)
+		static void OnMouseButton(GLFWwindow* window, int, int, int)
 		{
-			// make sure the viewport matches the new window dimensions; note that width and 
-			// height will be significantly larger than specified on retina displays.
-			glViewport(0, 0, width, height);
+			((Application*)glfwGetWindowUserPointer(window))->Invalidate();
+		}
+
+		static void OnCursorPosition(GLFWwindow* window, double, double)
+		{
+			((Application*)glfwGetWindowUserPointer(window))->Invalidate();
+		}
+
+		static void OnScroll(GLFWwindow* window, double, double)
+		{
+			((Application*)glfwGetWindowUserPointer(window))->Invalidate();
+		}
+
+		// the window was uncovered or restored and its contents are gone
+		static void OnRefresh(GLFWwindow* window)
+		{
+			((Application*)glfwGetWindowUserPointer(window))->Invalidate();
+		}
+
+		// Procedural 128x128 sprite images, PNGs with alpha and JPGs in turns, so the streamed scene
+		// has files to load. Files that exist are kept.
+		static std::vector<std::string> WriteSpriteImages(uint32_t count)
+		{
+			const int size = 128;
+			std::vector<std::string> paths(count);
+			std::error_code error;
+			std::filesystem::create_directories("cache/Sprites", error);
+			JobSystem::ParallelFor(count, [&](uint32_t begin, uint32_t end)
+			{
+				std::vector<unsigned char> pixels((size_t)size * size * 4);
+				for (uint32_t i = begin; i < end; i++)
+				{
+					bool png = (i & 1) == 0;
+					char path[64];
+					snprintf(path, sizeof(path), "cache/Sprites/Sprite%03u.%s", i, png ? "png" : "jpg");
+					paths[i] = path;
+					std::error_code existsError;
+					if (std::filesystem::exists(paths[i], existsError))
+						continue;
+
+					// a hue per image, spread by the golden ratio, over one of four patterns
+					float h = std::fmod(i * 0.618034f, 1.0f) * 6.0f;
+					glm::vec3 hue = glm::clamp(glm::abs(glm::mod(glm::vec3(h, h + 4.0f, h + 2.0f), 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+					for (int y = 0; y < size; y++)
+					{
+						for (int x = 0; x < size; x++)
+						{
+							glm::vec2 p = (glm::vec2(x, y) + 0.5f) / (float)size - 0.5f;
+							float distance = glm::length(p) * 2.0f;
+							float value = 1.0f;
+							switch (i / 2 % 4)
+							{
+							case 0: value = ((x / 16 + y / 16) & 1) ? 1.0f : 0.4f; break;
+							case 1: value = ((int)(distance * 6.0f) & 1) ? 1.0f : 0.5f; break;
+							case 2: value = (((x + y) / 12) & 1) ? 1.0f : 0.3f; break;
+							case 3: value = glm::clamp(1.2f - distance, 0.2f, 1.0f); break;
+							}
+							glm::vec3 color = glm::mix(glm::vec3(1.0f), hue, 0.7f) * value;
+							unsigned char* pixel = &pixels[((size_t)y * size + x) * 4];
+							pixel[0] = (unsigned char)(color.r * 255.0f);
+							pixel[1] = (unsigned char)(color.g * 255.0f);
+							pixel[2] = (unsigned char)(color.b * 255.0f);
+							pixel[3] = (unsigned char)(glm::clamp((1.0f - distance) * 8.0f, 0.0f, 1.0f) * 255.0f);
+						}
+					}
+					// JPG drops the alpha
+					if (png)
+						stbi_write_png(path, size, size, 4, pixels.data(), size * 4);
+					else
+						stbi_write_jpg(path, size, size, 4, pixels.data(), 90);
+				}
+			}, 1);
+			return paths;
 		}
 
 		static void APIENTRY glDebugOutput(GLenum source,
@@ -74,111 +159,134 @@ namespace OpenGLSandbox {
 			} std::cout << std::endl;
 			std::cout << std::endl;
 		}
-
-		static void ConvertMSDFGBitmapTOBytesArray(msdfgen::Bitmap<float, 3> bitmap, char* out, int& oWidth, int& oHeight)
-		{
-			std::vector<byte> pixels(3 * bitmap.width() * bitmap.height());
-			std::vector<byte>::iterator it = pixels.begin();
-			for (int y = bitmap.height() - 1; y >= 0; --y)
-				for (int x = 0; x < bitmap.width(); ++x) {
-					*it++ = Utils::pixelFloatToByte(bitmap(x, y)[0]);
-					*it++ = Utils::pixelFloatToByte(bitmap(x, y)[1]);
-					*it++ = Utils::pixelFloatToByte(bitmap(x, y)[2]);
-				}
-			memcpy(out, &pixels[0], 3 * bitmap.width() * bitmap.height());
-			oWidth = bitmap.width();
-			oHeight = bitmap.height();
-		}
 	}
 
-	Application::Application()
+	Application::Application(const ApplicationSpecification& specification)
+		: m_Specification(specification), m_Width(specification.Width), m_Height(specification.Height)
 	{
 		if (m_Window != NULL)
 			assert(false);
 
-		CreateWindows();
-
-		m_UnlitShader = std::make_unique<Shader>("res/Shaders/QuadVertexShader.shader", "res/Shaders/QuadFragmentShader.shader");
-		m_ScreenShader = std::make_unique<Shader>("res/Shaders/ScreenVertex.shader", "res/Shaders/ScreenFragment.shader");
-		m_TextShader = std::make_unique<Shader>("res/Shaders/TextV.shader", "res/Shaders/TextF.shader");
-
-		// FreeType
-		FT_Library ft;
-		// All functions return a value different than 0 whenever an error occurred
-		if (FT_Init_FreeType(&ft))
-		{
-			std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-			return ;
-		}
-
-
-		// load font as face
-		FT_Face face;
-		if (FT_New_Face(ft, "res/Fonts/Forte/ForteRegular.ttf", 0, &face)) {
-			std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
-			return ;
+		// started first so the atlas generation below is in the trace
+		if (!m_Specification.TracePath.empty())
+			Profiler::BeginCapture();
+
+		// with a packed copy of res/ every asset comes out of one mapping
+		if (FileSystem::MountArchive(AssetArchivePath))
+			std::cout << "Assets: reading res/ from " << AssetArchivePath << ", run with --pack-assets again after changing assets" << std::endl;
+
+		if (m_Specification.Headless) {
+			if (!m_HeadlessContext.Create())
+				return;
+			std::cout << "Headless: " << m_HeadlessContext.GetBackend() << ", " << glGetString(GL_RENDERER)
+				<< ", " << m_Width << "x" << m_Height << ", " << m_Specification.FrameCount << " frames" << std::endl;
+			InitializeGLState();
+			CreateBackBuffer();
 		}
 		else {
-			// set size to load glyphs as
-			FT_Set_Pixel_Sizes(face, 0, 48);
-
-			// disable byte-alignment restriction
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-			// load first 128 characters of ASCII set
-			for (unsigned char c = 0; c < 128; c++)
-			{
-				// Load character glyph 
-				if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-				{
-					std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-					continue;
-				}
-				// generate texture
-				unsigned int texture;
-				glGenTextures(1, &texture);
-				glBindTexture(GL_TEXTURE_2D, texture);
-				glTexImage2D(
-					GL_TEXTURE_2D,
-					0,
-					GL_RED,
-					face->glyph->bitmap.width,
-					face->glyph->bitmap.rows,
-					0,
-					GL_RED,
-					GL_UNSIGNED_BYTE,
-					face->glyph->bitmap.buffer
-				);
-				// set texture options
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-				// now store character for later use
-				Character character = {
-					texture,
-					glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-					glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-					static_cast<unsigned int>(face->glyph->advance.x)
-				};
-				Characters.insert(std::pair<char, Character>(c, character));
-			}
-			glBindTexture(GL_TEXTURE_2D, 0);
+			CreateWindows();
+			if (!m_Window)
+				return;
 		}
-		// destroy FreeType once we're finished
-		FT_Done_Face(face);
-		FT_Done_FreeType(ft);
 
-		CreateMSDFTexture();
+		// programs whose sources didn't change since the last run are loaded from their binaries,
+		// the others compile in the background while the render loop polls them
+		auto shaderStart = std::chrono::steady_clock::now();
+		m_ShaderCache = std::make_unique<ShaderCache>("cache/Shaders");
+		m_ShaderCompiler = std::make_unique<ShaderCompiler>(m_ShaderCache.get());
+		m_UnlitShader = std::make_unique<Shader>("res/Shaders/QuadVertexShader.shader", "res/Shaders/QuadFragmentShader.shader", *m_ShaderCompiler);
+		m_ScreenShader = std::make_unique<Shader>("res/Shaders/ScreenVertex.shader", "res/Shaders/ScreenFragment.shader", *m_ShaderCompiler);
+		m_TextShader = std::make_unique<Shader>("res/Shaders/TextV.shader", "res/Shaders/TextF.shader", *m_ShaderCompiler);
+		m_QuadShader = std::make_unique<Shader>("res/Shaders/QuadBatchV.shader", "res/Shaders/QuadBatchF.shader", *m_ShaderCompiler);
+		std::chrono::duration<double, std::milli> shaderTime = std::chrono::steady_clock::now() - shaderStart;
+		std::cout << "Shaders: " << m_ShaderCache->GetStatistics().Hits << " from cache, " << m_ShaderCompiler->GetStatistics().Pending
+			<< " compiling" << (m_ShaderCompiler->IsParallel() ? " in parallel" : "") << ", submitted in " << shaderTime.count() << " ms" << std::endl;
+
+		m_FrameUniformBuffer = std::make_unique<UniformBuffer>((uint32_t)sizeof(FrameUniforms), FrameUniformBinding);
+		for (Shader* shader : { m_UnlitShader.get(), m_ScreenShader.get(), m_TextShader.get(), m_QuadShader.get() })
+			shader->BindUniformBlock("Frame", FrameUniformBinding);
+
+		LoadFonts();
+
+		// sized for the quad scene, so its first frame doesn't have to grow the regions
+		m_StreamBuffer = std::make_unique<StreamBuffer>((1 << 20) + m_Specification.QuadCount * QuadRenderer::InstanceSize, m_Specification.StreamBufferMode);
+		std::cout << "StreamBuffer: " << StreamBuffer::GetModeName(m_StreamBuffer->GetMode()) << ", " << StreamBuffer::RegionCount
+			<< " regions of " << m_StreamBuffer->GetRegionSize() << " bytes" << std::endl;
+
+		m_TextRenderer = std::make_unique<TextRenderer>(*m_TextShader, *m_StreamBuffer);
+		m_TextRenderer->SetGlyphCache(*m_GlyphCache);
+
+		if (m_Specification.QuadCount)
+			CreateSpriteScene();
+
+		m_GPUProfiler = std::make_unique<GPUProfiler>();
+		if (!m_GPUProfiler->IsSupported())
+			std::cout << "GPUProfiler: no timer queries on this driver, GPU zones are off" << std::endl;
 	}
 
 	Application::~Application()
 	{
+		ReleaseGLResources();
+	}
+
+	void Application::ReleaseGLResources()
+	{
+		// in reverse order of creation; the streamer waits for its decode jobs first
+		m_RenderGraph.reset();
+		m_GPUProfiler.reset();
+		m_TextureStreamer.reset();
+		m_SpriteImages.clear();
+		m_SpriteImageTextures.clear();
+		if (m_SpriteTexture)
+			RenderState::DeleteTexture(m_SpriteTexture);
+		m_SpriteTexture = 0;
+		m_QuadRenderer.reset();
+		m_TextRenderer.reset();
+		m_StreamBuffer.reset();
+		if (m_FontTexture)
+			RenderState::DeleteTexture(m_FontTexture);
+		m_FontTexture = 0;
+		m_GlyphCache.reset();
+		m_FrameUniformBuffer.reset();
+		m_QuadShader.reset();
+		m_TextShader.reset();
+		m_ScreenShader.reset();
+		m_UnlitShader.reset();
+		m_ShaderCompiler.reset();
+		m_ShaderCache.reset();
+		if (m_BackBuffer) {
+			RenderState::DeleteFramebuffer(m_BackBuffer);
+			glDeleteRenderbuffers(1, &m_BackBufferColor);
+			glDeleteRenderbuffers(1, &m_BackBufferDepth);
+		}
+		m_BackBuffer = 0;
+		m_BackBufferColor = 0;
+		m_BackBufferDepth = 0;
+	}
+
+	void Application::OnResize(int width, int height)
+	{
+		// minimized
+		if (width <= 0 || height <= 0)
+			return;
 
+		// the graph follows when the next frame is rendered
+		m_Width = width;
+		m_Height = height;
+		m_FrameInvalidated = true;
+	}
+
+	void Application::MakeContextCurrent(bool current)
+	{
+		if (m_Window)
+			glfwMakeContextCurrent(current ? m_Window : nullptr);
+		else
+			m_HeadlessContext.MakeCurrent(current);
 	}
 
 	void Application::ProcessInputs()
 	{
+		PROFILE_SCOPE("Input");
 		// poll IO events (keys pressed/released, mouse moved etc.)
 		glfwPollEvents();
 		glfwSetInputMode(m_Window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -214,7 +322,13 @@ namespace OpenGLSandbox {
 			return;
 		}
 		glfwMakeContextCurrent(m_Window);
+		glfwSetWindowUserPointer(m_Window, this);
 		glfwSetFramebufferSizeCallback(m_Window, Utils::OnResize);
+		glfwSetKeyCallback(m_Window, Utils::OnKey);
+		glfwSetMouseButtonCallback(m_Window, Utils::OnMouseButton);
+		glfwSetCursorPosCallback(m_Window, Utils::OnCursorPosition);
+		glfwSetScrollCallback(m_Window, Utils::OnScroll);
+		glfwSetWindowRefreshCallback(m_Window, Utils::OnRefresh);
 		glfwSwapInterval(0); // 0 = Off, 1 = v_sync, 2 = v_sync/2, etc
 
 		// glad: load all OpenGL function pointers
@@ -225,6 +339,11 @@ namespace OpenGLSandbox {
 			return;
 		}
 
+		InitializeGLState();
+	}
+
+	void Application::InitializeGLState()
+	{
 		// enable OpenGL debug context if context allows for debug context
 		int flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
 		if (flags & GL_CONTEXT_FLAG_DEBUG_BIT)
@@ -238,14 +357,71 @@ namespace OpenGLSandbox {
 
 		// OpenGL state
 		// ------------
-		glEnable(GL_CULL_FACE);
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// a new context, nothing the cache holds applies to it
+		RenderState::Invalidate();
+		RenderState::SetEnabled(GL_CULL_FACE, true);
+		RenderState::SetEnabled(GL_BLEND, true);
+		RenderState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		RenderState::FrontFace(GL_CCW);
+	}
+
+	void Application::CreateBackBuffer()
+	{
+		// stands in for the window's framebuffer, which a headless context doesn't have
+		glGenFramebuffers(1, &m_BackBuffer);
+		RenderState::BindFramebuffer(GL_FRAMEBUFFER, m_BackBuffer);
+
+		glGenRenderbuffers(1, &m_BackBufferColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_BackBufferColor);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_Width, m_Height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_BackBufferColor);
 
+		glGenRenderbuffers(1, &m_BackBufferDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_BackBufferDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_BackBufferDepth);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			assert(false);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		RenderState::Viewport(0, 0, m_Width, m_Height);
 	}
 
-	void Application::Run()
+	int Application::WriteBenchmarkReport(FrameBenchmark& benchmark)
 	{
+		std::vector<unsigned char> pixels((size_t)m_Width * m_Height * 4);
+		RenderState::BindFramebuffer(GL_READ_FRAMEBUFFER, m_BackBuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		benchmark.Finish(Hash::Checksum(pixels.data(), pixels.size()));
+
+		const std::string& path = m_Specification.ReportPath;
+		stbi_flip_vertically_on_write(1);
+		stbi_write_png((path + ".png").c_str(), m_Width, m_Height, 4, pixels.data(), m_Width * 4);
+		if (!benchmark.WriteCSV(path + ".csv") || !benchmark.WriteJSON(path + ".json")) {
+			std::cout << "Failed to write " << path << ".csv/.json" << std::endl;
+			return 1;
+		}
+
+		FrameBenchmark::Summary summary = benchmark.GetSummary();
+		std::cout << "Headless: " << summary.Frames << " frames, cpu median " << summary.CPUMedian << " ms (p95 " << summary.CPUP95
+			<< "), gpu median " << summary.GPUMedian << " ms (p95 " << summary.GPUP95 << "), report in " << path << ".csv/.json/.png" << std::endl;
+		std::cout << "StreamBuffer: " << summary.BytesStreamed / std::max<uint32_t>(summary.Frames, 1) << " bytes per frame, "
+			<< summary.StreamStallTime << " ms stalled over the run" << std::endl;
+
+		if (m_Specification.BaselinePath.empty())
+			return 0;
+		std::cout << "Comparing with " << m_Specification.BaselinePath << std::endl;
+		bool passed = FrameBenchmark::CompareToBaseline(summary, m_Specification.BaselinePath, m_Specification.Tolerance, std::cout);
+		std::cout << (passed ? "no regressions" : "REGRESSED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	int Application::Run()
+	{
+		if (!m_Window && !m_HeadlessContext.IsValid())
+			return 1;
+
 		float vertices[] = {
 		//  positions           texture coordinates 
 		 0.5f,  0.5f, 0.0f,       1.0f, 1.0f,        // top right 
@@ -253,76 +429,34 @@ namespace OpenGLSandbox {
 		-0.5f, -0.5f, 0.0f,       0.0f, 0.0f,       // bottom left
 		-0.5f,  0.5f, 0.0f,       0.0f, 1.0f      // top left 
 		};
-		unsigned int indices[] = {  // note that we start from 0!
-			0, 1, 3,  // first Triangle
-			1, 2, 3   // second Triangle
+		unsigned int indices[] = {  // note that we start from 0! counter-clockwise, like the text and the screen quad
+			0, 3, 1,  // first Triangle
+			1, 3, 2   // second Triangle
 		};
 
 		float screenQuadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates. NOTE that this plane is now much smaller and at the top of the screen
 		// positions   // texCoords
-		 1.0f,   1.0f,  0.0f, 1.0f,
-		-1.0f,  -1.0f,  1.0f, 0.0f,
-		 1.0f,  -1.0f,  0.0f, 0.0f,
+		 1.0f,   1.0f,  1.0f, 1.0f,
+		-1.0f,  -1.0f,  0.0f, 0.0f,
+		 1.0f,  -1.0f,  1.0f, 0.0f,
 
-		-1.0f,  -1.0f,  0.0f, 1.0f,
-		 1.0f,   1.0f,  1.0f, 0.0f,
-		-1.0f,   1.0f,  1.0f, 1.0f
+		-1.0f,  -1.0f,  0.0f, 0.0f,
+		 1.0f,   1.0f,  1.0f, 1.0f,
+		-1.0f,   1.0f,  0.0f, 1.0f
 		};
 
-		///////////////// Create a framebuffer  ///////////////////////////////////////////
-		unsigned int FBO;
-		glGenFramebuffers(1, &FBO);
-		glEnable(GL_DEPTH_TEST); // enable depth testing (is disabled for rendering screen-space quad)
-		// Bind the framebuffer as current
-		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-
-		// create attachments
-		//   1. Texture attachment
-		unsigned int textureColorAttachmentBufferID_1;
-		glGenTextures(1, &textureColorAttachmentBufferID_1);
-		glBindTexture(GL_TEXTURE_2D, textureColorAttachmentBufferID_1);
-
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_Width, m_Height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// attach attachment(s) to framebuffer 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorAttachmentBufferID_1, 0);
-
-		// check if framebuffer was created successfully
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			assert(false);
-
-		// create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-		unsigned int rbo;
-		glGenRenderbuffers(1, &rbo);
-		glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_Width, m_Height); // use a single renderbuffer object for both a depth AND stencil buffer.
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-																									  // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			assert(false);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-
-
-
-		///////////////////////////////////////////////////////////////////////////////////////
-
 		//////////////////////////////////  Quad VAO, VBO, EBO /////////////////////////////////
 		unsigned int VBO, VAO, EBO;
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 		// bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-		glBindVertexArray(VAO);
+		RenderState::BindVertexArray(VAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 		// position attribute
@@ -335,19 +469,9 @@ namespace OpenGLSandbox {
 		glVertexAttribPointer(attributeTexCoordIndex, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 		glEnableVertexAttribArray(attributeTexCoordIndex);
 
-		 //note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex attribute's bound vertex buffer object so afterwards we can safely unbind
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
 		 //remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS stored in the VAO; keep the EBO bound.
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		 //Nothing is unbound afterwards, every draw binds what it uses through RenderState, which skips the binds that are already in place.
 
-		 //You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but this rarely happens. Modifying other
-		 //VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-		//it's okay to unbind the EBO after unbinding the VAO. 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		
 
 		////////////////////////////////////  Screen VAO, VBO, EBO /////////////////////////////////
 
@@ -355,9 +479,9 @@ namespace OpenGLSandbox {
 		glGenVertexArrays(1, &Screen_VAO);
 		glGenBuffers(1, &Screen_VBO);
 		// bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure vertex attributes(s).
-		glBindVertexArray(Screen_VAO);
+		RenderState::BindVertexArray(Screen_VAO);
 
-		glBindBuffer(GL_ARRAY_BUFFER, Screen_VBO);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, Screen_VBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(screenQuadVertices), screenQuadVertices, GL_STATIC_DRAW);
 
 		// position attribute
@@ -370,21 +494,6 @@ namespace OpenGLSandbox {
 		glVertexAttribPointer(ScreenAttributeTexCoordIndex, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 		glEnableVertexAttribArray(ScreenAttributeTexCoordIndex);
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// configure VAO/VBO for texture quads
-		unsigned int Text_VBO, Text_VAO;
-		glGenVertexArrays(1, &Text_VAO);
-		glGenBuffers(1, &Text_VBO);
-		glBindVertexArray(Text_VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, Text_VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
-
 		// uncomment this call to draw in wireframe polygons.
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -392,241 +501,499 @@ namespace OpenGLSandbox {
 		glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &nrAttributes);
 		std::cout << "Maximum number of vertex attributes supported: " << nrAttributes << std::endl;
 
-		int frames = 0;
-		float timer = 0.0f;
-		std::string windowTitle;
+		glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f));
 
-		glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(m_Width), 0.0f, static_cast<float>(m_Height));
+		///////////////// Render graph ///////////////////////////////////////////
+		// the scene is drawn offscreen and composited into the back buffer; the graph owns the
+		// offscreen targets and resizes them with the window
+		m_RenderGraph = std::make_unique<RenderGraph>(m_Width, m_Height);
+		m_RenderGraph->SetGPUProfiler(m_GPUProfiler.get());
+		RenderResource sceneColor = m_RenderGraph->CreateTexture("SceneColor", { GL_RGBA8 });
+		RenderResource sceneDepth = m_RenderGraph->CreateTexture("SceneDepth", { GL_DEPTH24_STENCIL8 });
+		RenderResource backBuffer = m_RenderGraph->ImportFramebuffer("BackBuffer", m_BackBuffer);
 
-		glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f));
+		m_RenderGraph->AddPass("Scene", [&](const RenderGraph&)
+		{
+			RenderState::SetEnabled(GL_DEPTH_TEST, true);
+			m_RenderQueue.Submit(RenderLayer::Translucent);
+			// text is the overlay
+			PROFILE_GPU_SCOPE(*m_GPUProfiler, "GPU Text Pass");
+			m_RenderQueue.Submit(RenderLayer::Overlay);
+		})
+			.Write(sceneColor, AttachmentLoad::Clear, glm::vec4(0.2f, 0.3f, 0.3f, 1.0f))
+			.Write(sceneDepth, AttachmentLoad::Clear, 1.0f);
+
+		// every sprite sits at the same depth, so they are blended in the order drawn, without the depth test
+		if (m_QuadRenderer) {
+			m_RenderGraph->AddPass("Sprites", [&](const RenderGraph&)
+			{
+				RenderState::SetEnabled(GL_DEPTH_TEST, false);
+				m_SpriteQueue.Submit();
+			})
+				.Write(sceneColor, AttachmentLoad::Load);
+		}
 
-		// render loop
-		// -----------
-		while (!glfwWindowShouldClose(m_Window))
+		// the quad covers the whole target, so the back buffer isn't cleared
+		m_RenderGraph->AddPass("Composite", [&](const RenderGraph& graph)
+		{
+			RenderState::SetEnabled(GL_DEPTH_TEST, false); // disable depth test so screen-space quad isn't discarded due to depth test.
+
+			m_ScreenShader->Bind();
+			m_ScreenShader->SetUniform1i("u_ColorAttachmentTexIndex", 0);
+			RenderState::BindVertexArray(Screen_VAO);
+			RenderState::BindTexture(0, GL_TEXTURE_2D, graph.GetTexture(sceneColor));
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		})
+			.Read(sceneColor)
+			.Write(backBuffer, AttachmentLoad::DontCare);
+
+		m_RenderGraph->Compile();
+		m_RenderGraph->PrintReport(std::cout);
+
+		// a benchmark run measures the finished programs from its first frame on, and streams the
+		// textures in over the same frames on every run
+		std::unique_ptr<FrameBenchmark> benchmark;
+		if (m_Specification.Headless) {
+			m_ShaderCompiler->WaitAll();
+			if (m_TextureStreamer)
+				m_TextureStreamer->DecodeAll();
+			benchmark = std::make_unique<FrameBenchmark>();
+		}
+
+		int frames = 0;
+		uint32_t totalFrames = 0;
+		bool shadersReported = m_ShaderCompiler->GetStatistics().Pending == 0;
+		bool texturesReported = !m_TextureStreamer;
+		float timer = 0.0f;
+		float previousTime = 0.0f;
+		std::string fpsText;	// for the next frame, set once a second
+		FrameResults results;	// of the last frame rendered
+
+		// static text is laid out once, only the fps label changes and only once a second
+		m_TextRenderer->CreateTextBlock("This is sample text", glm::vec2(25.0f, 25.0f), 1.0f, glm::vec3(0.5, 0.8f, 0.2f));
+		m_TextRenderer->CreateTextBlock("(B) LearnOpenGL.com", glm::vec2(540.0f, 570.0f), 0.5f, glm::vec3(0.3, 0.7f, 0.9f));
+		m_TextRenderer->CreateTextBlock(u8"Gr\u00FC\u00DFe aus K\u00F6ln", glm::vec2(25.0f, 80.0f), 0.5f, glm::vec3(0.9f, 0.6f, 0.2f));
+		TextBlockHandle fpsLabel = m_TextRenderer->CreateTextBlock("fps: -", glm::vec2(25.0f, 570.0f), 0.5f, glm::vec3(1.0f));
+
+		// the main thread produces a frame's data, then it is rendered from that data alone; with a
+		// render thread the two run a frame apart, each on its own FrameData
+		FrameData frameData[2];
+		for (FrameData& frame : frameData)
+			frame.SpriteTransforms.resize(m_Sprites.size());
+
+		// headless runs use a fixed clock, so every run renders the same frames
+		auto currentTime = [&]()
 		{
-			// input
-			// -----
-			ProcessInputs();
+			return m_Specification.Headless ? totalFrames / 60.0f : (float)glfwGetTime();
+		};
 
-			// other operations: 
-			float timeValue = (float)glfwGetTime();
-			//float greenValue = (sin(timeValue) / 2.0f) + 0.5f;
+		// input, time and simulation; main thread, no GL
+		auto produceFrame = [&](FrameData& frame)
+		{
+			PROFILE_SCOPE("Produce");
+			if (m_Window)
+				ProcessInputs();
+			m_FrameInvalidated = false;
+			frame.InputTime = Profiler::Now();
+			frame.Index = totalFrames;
+			frame.Time = currentTime();
+			frame.Width = m_Width;
+			frame.Height = m_Height;
+			frame.FpsText = std::move(fpsText);
+			fpsText.clear();
+
+			if (m_QuadRenderer)
+				UpdateSprites(std::min(frame.Time - previousTime, 0.1f), frame.SpriteTransforms);
+			previousTime = frame.Time;
+		};
 
-			// Quad shader uniform
-			m_UnlitShader->Bind();
-			m_UnlitShader->SetUniform4m("u_MVP", scale);
-			m_UnlitShader->SetUniform4f("u_Color", 0.0f, 0.0f, 0.0f, 1.0f);
-			m_UnlitShader->SetUniform1i("u_fontTexture", 0);
-			m_UnlitShader->Unbind();
+		// everything that touches GL; the thread that owns the context
+		auto renderFrame = [&](FrameData& frame)
+		{
+			PROFILE_SCOPE("Render");
+			// the GPU zones are a few frames old
+			m_GPUProfiler->BeginFrame();
+			if (benchmark)
+				benchmark->BeginFrame();
+			Shader::ResetStatistics();
+			RenderState::ResetStatistics();
+
+			// shaders still compiling draw with the fallback program
+			m_ShaderCompiler->Poll();
+			if (!shadersReported && m_ShaderCompiler->GetStatistics().Pending == 0) {
+				std::cout << "Shaders: all built after " << frame.Index << " frames, " << m_ShaderCompiler->GetStatistics().Failed << " failed" << std::endl;
+				shadersReported = true;
+			}
 
+			// sprites without their image yet draw with the placeholder
+			if (m_TextureStreamer) {
+				m_TextureStreamer->Update();
+				if (!texturesReported && m_TextureStreamer->IsIdle()) {
+					const TextureStreamer::Statistics& streamed = m_TextureStreamer->GetStatistics();
+					std::cout << "TextureStreamer: " << streamed.Resident << " textures resident after " << frame.Index + 1 << " frames, "
+						<< streamed.Failed << " failed, " << streamed.DecodeTime << " ms decoding" << std::endl;
+					texturesReported = true;
+				}
+			}
 
-			//Screen shader unforms
-			m_ScreenShader->Bind();
-			m_ScreenShader->SetUniform1i("u_ColorAttachmentTexIndex", 0);
-			m_ScreenShader->Unbind();
+			if (frame.Width != m_RenderGraph->GetWidth() || frame.Height != m_RenderGraph->GetHeight())
+				m_RenderGraph->Resize(frame.Width, frame.Height);
+			if (!frame.FpsText.empty())
+				m_TextRenderer->SetText(fpsLabel, frame.FpsText);
 
-			// Text shader 
-			m_TextShader->Bind();
-			glUniformMatrix4fv(glGetUniformLocation(m_TextShader->GetRendererID(), "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			FrameUniforms frameUniforms;
+			frameUniforms.ScreenProjection = glm::ortho(0.0f, static_cast<float>(frame.Width), 0.0f, static_cast<float>(frame.Height));
+			frameUniforms.Time = glm::vec4(frame.Time, 0.0f, 0.0f, 0.0f);
+			m_FrameUniformBuffer->SetData(&frameUniforms, sizeof(frameUniforms));
+
+			// record
+			// ------
+			{
+				PROFILE_SCOPE("Record");
+				m_StreamBuffer->BeginFrame();
+				RenderQueue::CommandBuffer& commands = m_RenderQueue.Acquire();
+
+				DrawCommand quad;
+				quad.Program = m_UnlitShader.get();
+				quad.VertexArray = VAO; // the EBO is part of the VAO
+				quad.Textures[0] = { GL_TEXTURE_2D, m_FontTexture };
+				quad.Indexed = true;
+				quad.Count = 6;
+				commands.Draw(RenderQueue::MakeKey(RenderLayer::Opaque, quad, 0.5f), quad);
+				// the shader's cache skips the uniforms that didn't change since the last frame
+				commands.SetUniform4m("u_MVP", scale);
+				commands.SetUniform4f("u_Color", glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+				commands.SetUniform1i("u_fontTexture", 0);
+
+				m_TextRenderer->Begin();
+				m_TextRenderer->End(commands);
+			}
+			if (m_QuadRenderer) {
+				PROFILE_SCOPE("Quad Submit");
+				m_QuadRenderer->Begin(m_SpriteQueue.Acquire());
+				const glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+				if (m_TextureStreamer) {
+					// once per image rather than per sprite
+					m_SpriteImageTextures.resize(m_SpriteImages.size());
+					for (size_t i = 0; i < m_SpriteImages.size(); i++)
+						m_SpriteImageTextures[i] = m_TextureStreamer->GetTexture(m_SpriteImages[i]);
+					for (size_t i = 0; i < m_Sprites.size(); i++)
+						m_QuadRenderer->DrawQuad(frame.SpriteTransforms[i], m_SpriteImageTextures[m_Sprites[i].Image], 0.0f, uvRect, m_Sprites[i].Color);
+				}
+				else {
+					for (size_t i = 0; i < m_Sprites.size(); i++)
+						m_QuadRenderer->DrawQuad(frame.SpriteTransforms[i], m_SpriteTexture, m_Sprites[i].Layer, uvRect, m_Sprites[i].Color);
+				}
+				m_QuadRenderer->End();
+			}
+			m_StreamBuffer->EndFrame();
 
 			// render
 			// ------
 			{
-				glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-				
-				// Frame begin
-				{
-					auto timer = Timer();
-					// first render pass
-					//glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-					glClear(GL_COLOR_BUFFER_BIT || GL_STENCIL_BUFFER_BIT);
-
-					// First draw pass 
-					m_UnlitShader->Bind();
-					glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
-					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, m_FontTexture);
-
-					glFrontFace(GL_CW);
-					glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
-					glBindVertexArray(0);
-
-					// draw text 
-					glFrontFace(GL_CCW);
-					RenderText(Text_VAO, Text_VBO, *m_TextShader, "This is sample text", 25.0f, 25.0f, 1.0f, glm::vec3(0.5, 0.8f, 0.2f));
-					RenderText(Text_VAO, Text_VBO, *m_TextShader, "(B) LearnOpenGL.com", 540.0f, 570.0f, 0.5f, glm::vec3(0.3, 0.7f, 0.9f));
-					
-					// unbind the first render pass framebuffer: use default 
-					glBindFramebuffer(GL_FRAMEBUFFER, 0);
-					glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-					// second render pass
-					glClear(GL_COLOR_BUFFER_BIT || GL_STENCIL_BUFFER_BIT);
-
-					// bind attachColorBuffer 
-					m_ScreenShader->Bind();
-					glBindVertexArray(Screen_VAO);
-					glBindTexture(GL_TEXTURE_2D, textureColorAttachmentBufferID_1);
-					glFrontFace(GL_CW);
-					glDrawArrays(GL_TRIANGLES, 0, 6);
-					
-					// delay thread
-					//std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
-					// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+				PROFILE_SCOPE("Submit");
+				m_RenderGraph->Execute();
+				if (m_Specification.ValidateRenderState)
+					RenderState::Validate(std::cout);
+
+				PROFILE_SCOPE("Present");
+				if (m_Window)
 					glfwSwapBuffers(m_Window);
-					// -------------------------------------------------------------------------------
-					windowTitle = timer.GetWindowTitle();
+				else
+					glFlush();
+			}
+
+			const TextRenderer::Statistics& textStats = m_TextRenderer->GetStatistics();
+			frame.Results.Latency = (Profiler::Now() - frame.InputTime) / 1e6;
+			frame.Results.ShadersPending = m_ShaderCompiler->GetStatistics().Pending != 0;
+			frame.Results.TextDrawCalls = textStats.DrawCalls;
+			frame.Results.TextBytesUploaded = textStats.BytesUploaded;
+			frame.Results.UniformCalls = Shader::GetStatistics().UniformCalls;
+			frame.Results.SkippedUniformCalls = Shader::GetStatistics().SkippedUniformCalls;
+			frame.Results.StateCalls = RenderState::GetStatistics().Issued;
+			frame.Results.FilteredStateCalls = RenderState::GetStatistics().Filtered;
+
+			if (benchmark) {
+				FrameCounters counters;
+				counters.DrawCalls = 2 + textStats.DrawCalls;	// the quad, the screen quad and the text
+				counters.Glyphs = textStats.Glyphs + textStats.RetainedGlyphs;
+				counters.BytesUploaded = textStats.BytesUploaded;
+				if (m_QuadRenderer) {
+					counters.DrawCalls += m_QuadRenderer->GetStatistics().DrawCalls;
+					counters.BytesUploaded += m_QuadRenderer->GetStatistics().BytesUploaded;
+				}
+				if (m_TextureStreamer)
+					counters.BytesUploaded += m_TextureStreamer->GetStatistics().BytesUploaded;
+				counters.UniformCalls = Shader::GetStatistics().UniformCalls;
+				counters.StateCalls = RenderState::GetStatistics().Issued;
+				counters.BytesStreamed = m_StreamBuffer->GetStatistics().BytesStreamed;
+				counters.StreamStallTime = m_StreamBuffer->GetStatistics().StallTime;
+				counters.Latency = frame.Results.Latency;
+				benchmark->EndFrame(counters);
+			}
+		};
+
+		// FrameData indices: ready goes to the render thread, free comes back from it
+		static constexpr uint32_t StopRendering = ~0u;
+		SPSCQueue<uint32_t, 4> readyFrames, freeFrames;
+		// the render thread sleeps on this while the main thread is paced or waits for events
+		std::mutex readyMutex;
+		std::condition_variable readyCondition;
+		auto pushReady = [&](uint32_t index)
+		{
+			while (!readyFrames.TryPush(index))
+				std::this_thread::yield();
+			std::lock_guard<std::mutex> lock(readyMutex);
+			readyCondition.notify_one();
+		};
+		// and the main thread on this while the GPU holds the render thread up
+		std::mutex freeMutex;
+		std::condition_variable freeCondition;
+		std::thread renderThread;
+		if (m_Specification.RenderThread) {
+			freeFrames.TryPush(0);
+			freeFrames.TryPush(1);
+			MakeContextCurrent(false);
+			renderThread = std::thread([&]()
+			{
+				MakeContextCurrent(true);
+				uint32_t index;
+				while (true)
+				{
+					{
+						std::unique_lock<std::mutex> lock(readyMutex);
+						readyCondition.wait(lock, [&]() { return readyFrames.TryPop(index); });
+					}
+					if (index == StopRendering)
+						break;
+					renderFrame(frameData[index]);
+					freeFrames.TryPush(index);
+					std::lock_guard<std::mutex> lock(freeMutex);
+					freeCondition.notify_one();
 				}
+				MakeContextCurrent(false);
+			});
+		}
+
+		FramePacer pacer(m_Specification.FramePacing, m_Specification.TargetFPS);
+
+		// render loop
+		// -----------
+		while (m_Specification.Headless ? totalFrames < m_Specification.FrameCount : !glfwWindowShouldClose(m_Window))
+		{
+			// the previous frames' zones
+			Profiler::Collect();
+
+			// on demand, a frame nothing changed since the last one isn't drawn again; the sprites
+			// and the fallback programs of shaders still compiling keep animating, and textures
+			// only stream in while frames are drawn
+			if (m_TextRenderer->IsDirty() || (m_TextureStreamer && m_TextureStreamer->IsDirty()))
+				m_FrameInvalidated = true;
+			bool redraw = pacer.GetPolicy() != FramePolicy::OnDemand || m_FrameInvalidated
+				|| m_QuadRenderer || results.ShadersPending;
+			float time;
+			if (redraw) {
+				PROFILE_SCOPE("Frame");
+
+				// with a render thread, the data of the frame rendered two frames ago
+				uint32_t index = 0;
+				if (renderThread.joinable()) {
+					PROFILE_SCOPE("Wait For Render");
+					std::unique_lock<std::mutex> lock(freeMutex);
+					freeCondition.wait(lock, [&]() { return freeFrames.TryPop(index); });
+				}
+				FrameData& frame = frameData[index];
+				if (frame.Index != FrameData::NotRendered)
+					results = frame.Results;
+
+				produceFrame(frame);
+				if (renderThread.joinable())
+					pushReady(index);
+				else {
+					renderFrame(frame);
+					results = frame.Results;
+				}
+				time = frame.Time;
+			}
+			else {
+				// sleeps until there is input, or the fps label is due
+				if (m_Window)
+					glfwWaitEventsTimeout(std::max(0.0, timer + 1.0 - glfwGetTime()));
+				pacer.SkipFrame();
+				time = currentTime();
 			}
 
 			//fps counter 
-			if (timeValue - timer > 1.0f)
+			if (time - timer > 1.0f)
 			{
-				timer += 1.0;
-				glfwSetWindowTitle(m_Window, (windowTitle + " fps: " + std::to_string(frames)).c_str());
+				// whole seconds, an idle wait may have slept through several
+				timer += std::floor(time - timer);
+				// the label's block is edited by the frame that takes the text
+				fpsText = "fps: " + std::to_string(frames);
+				Invalidate();
+				Profiler::ZoneSummary frameZone;
+				std::string frameTime = Profiler::FindZone("Frame", frameZone)
+					? "frame: " + std::to_string(frameZone.Average) + " ms (p99 " + std::to_string(frameZone.P99) + ")" : "";
+				if (m_Window)
+					glfwSetWindowTitle(m_Window, (frameTime + " fps: " + std::to_string(frames)
+						+ " latency: " + std::to_string(results.Latency) + " ms"
+						+ " text draws: " + std::to_string(results.TextDrawCalls)
+						+ " text bytes: " + std::to_string(results.TextBytesUploaded)
+						+ " uniform calls: " + std::to_string(results.UniformCalls)
+						+ " skipped: " + std::to_string(results.SkippedUniformCalls)
+						+ " state calls: " + std::to_string(results.StateCalls)
+						+ " filtered: " + std::to_string(results.FilteredStateCalls)).c_str());
 				frames = 0;
 			}
-			frames++;
+			totalFrames++;
+
+			if (redraw) {
+				frames++;
+				PROFILE_SCOPE("Pace");
+				pacer.EndFrame();
+			}
 		}
 
-		// Delete OpenGL Objects
-		/*glDeleteVertexArrays(1, &VAO);
-		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &EBO);*/
-		//glDeleteFramebuffers(1, &FBO);
+		// the context comes back to this thread for the report and the cleanup
+		if (renderThread.joinable()) {
+			pushReady(StopRendering);
+			renderThread.join();
+			MakeContextCurrent(true);
+		}
+
+		Profiler::Collect();
+		Profiler::PrintSummary(std::cout);
+		pacer.PrintReport(std::cout);
+		if (m_Specification.ValidateRenderState)
+			std::cout << "RenderState: " << RenderState::GetStatistics().Mismatches << " mismatches with the GL state" << std::endl;
+		if (!m_Specification.TracePath.empty()) {
+			if (Profiler::WriteTrace(m_Specification.TracePath))
+				std::cout << "Profiler: trace written to " << m_Specification.TracePath << std::endl;
+			else
+				std::cout << "Profiler: could not write " << m_Specification.TracePath << std::endl;
+		}
+
+		// its passes reference this function's objects
+		m_RenderGraph.reset();
+		RenderState::DeleteVertexArray(Screen_VAO);
+		RenderState::DeleteBuffer(Screen_VBO);
+		RenderState::DeleteVertexArray(VAO);
+		RenderState::DeleteBuffer(VBO);
+		RenderState::DeleteBuffer(EBO);
+
+		if (benchmark)
+			return WriteBenchmarkReport(*benchmark);
+
+		// everything that holds GL objects goes while the window's context is still alive
+		ReleaseGLResources();
 
 		// glfw: terminate, clearing all previously allocated GLFW resources.
 		// ------------------------------------------------------------------
 		glfwTerminate();
+		return 0;
 	}
 	
-	void Application::RenderText(unsigned int VAO, unsigned int VBO, Shader& shader, std::string text, float x, float y, float scale, glm::vec3 color)
+	void Application::LoadFonts()
 	{
-		// activate corresponding render state	
-		shader.Bind();
-		glUniform3f(glGetUniformLocation(shader.GetRendererID(), "textColor"), color.x, color.y, color.z);
-		glActiveTexture(GL_TEXTURE0);
-		glBindVertexArray(VAO);
-
-		// iterate through all characters
-		std::string::const_iterator c;
-		for (c = text.begin(); c != text.end(); c++)
-		{
-			Character ch = Characters[*c];
-
-			float xpos = x + ch.Bearing.x * scale;
-			float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
-
-			float w = ch.Size.x * scale;
-			float h = ch.Size.y * scale;
-			// update VBO for each character
-			float vertices[6][4] = {
-				{ xpos,     ypos + h,   0.0f, 0.0f },
-				{ xpos,     ypos,       0.0f, 1.0f },
-				{ xpos + w, ypos,       1.0f, 1.0f },
-
-				{ xpos,     ypos + h,   0.0f, 0.0f },
-				{ xpos + w, ypos,       1.0f, 1.0f },
-				{ xpos + w, ypos + h,   1.0f, 0.0f }
-			};
-			// render glyph texture over quad
-			glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-			// update content of VBO memory
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // be sure to use glBufferSubData and not glBufferData
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
-			// render quad
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			// now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-			x += (ch.Advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
+		PROFILE_SCOPE("Load Fonts");
+		FontCacheParameters parameters;
+		parameters.MSDF.FontFilepath = "res/Fonts/OpenSans/OpenSans-Regular.ttf";
+		parameters.Bitmap.FontFilepath = "res/Fonts/Forte/ForteRegular.ttf";
+
+		// warm start: upload straight from the mapped cache without touching FreeType or msdfgen
+		uint64_t key = FontCache::ComputeKey(parameters);
+		FontCache cache("cache/Fonts.cache");
+		if (cache.Open(key)) {
+			CreateGlyphCache(parameters, cache.GetContents());
+			CreateMSDFTexture(cache.GetContents());
+			return;
 		}
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
 
-	void Application::CreateMSDFTexture()
-	{
-		std::filesystem::path filepath = "res/Fonts/OpenSans/OpenSans-Regular.ttf";
-		std::string outputpath = (filepath.parent_path().string() + "/" + filepath.stem().string() + std::string(".png"));
-
-		int max_dim = ((32 << 6));
-		int tex_width = 1;
-		while (tex_width < max_dim) tex_width <<= 1;
-		int tex_height = tex_width;
-		char* pixels = (char*)calloc(tex_width * tex_height * 3, 1);
-		int pen_x = 0, pen_y = 0;
-
-		msdfgen::FreetypeHandle* ft = msdfgen::initializeFreetype();
-		if (ft) {
-			msdfgen::FontHandle* font = msdfgen::loadFont(ft, filepath.string().c_str());
-			if (font) {
-				for (unsigned char ch = 33; ch < 126; ch++)
-				{
-					msdfgen::Shape shape;
-					if (msdfgen::loadGlyph(shape, font, ch)) {
-						bool result = shape.validate();
-						shape.normalize();
-						shape.inverseYAxis = true; // horizontal flip
-						//                      max. angle
-						msdfgen::edgeColoringSimple(shape, 3.0);
-						//           image width, height
-						//msdfgen::Bitmap<float, 1> msdf(32, 32);
-						msdfgen::Bitmap<float, 3> msdf(68, 68);
-
-						//output, shape, range, scale, translation
-						//msdfgen::generateSDF(msdf, shape, 4.0, 1.0, msdfgen::Vector2(4.0, 4.0));
-						msdfgen::generateMSDF(msdf, shape, 4.0, 2.0, msdfgen::Vector2(4.0, 4.0));
-
-						//msdfgen::savePng(msdf, ("res/" + std::string("glyph") + std::to_string(ch) + std::string(".png")).c_str());
-
-						int w, h;
-						char* imgBuffer = new char[msdf.width() * msdf.height() * 3];
-
- 						Utils::ConvertMSDFGBitmapTOBytesArray(msdf, imgBuffer, w, h);
-
-						if (pen_x + w >= tex_width) {
-							pen_x = 0;
-							pen_y += ((h) + 1); 
-						}
+		// ASCII is baked ahead of time, everything else is rasterized by the glyph cache on first use
+		BitmapFontAtlas bitmapFont(parameters.Bitmap);
+		if (!bitmapFont.Generate())
+			std::cout << "ERROR::FREETYPE: Failed to build atlas for " << parameters.Bitmap.FontFilepath << std::endl;
+		else {
+			std::cout << "Bitmap font atlas: ";
+			RectPacker::PrintReport(std::cout, bitmapFont.GetPackingReport());
+			std::cout << std::endl;
+		}
 
-						for (int row = 0; row < h; ++row) {
-							for (int col = 0; col < w; ++col) {
-								int x = pen_x + col;
-								int y = pen_y + row;
-								pixels[(y * tex_width + x) * 3 + 0] = imgBuffer[(row * w + col) * 3 + 0];
-								pixels[(y * tex_width + x) * 3 + 1] = imgBuffer[(row * w + col) * 3 + 1];
-								pixels[(y * tex_width + x) * 3 + 2] = imgBuffer[(row * w + col) * 3 + 2];
-							}
-						}
+		// glyphs are generated as jobs on every core, then merged into the atlas in codepoint order
+		MSDFAtlasGenerator generator(parameters.MSDF);
+		if (!generator.Generate())
+			std::cout << "ERROR::MSDFGEN: Failed to build atlas for " << parameters.MSDF.FontFilepath << std::endl;
+		else {
+			std::cout << "MSDF atlas: ";
+			RectPacker::PrintReport(std::cout, generator.GetPackingReport());
+			std::cout << std::endl;
+		}
 
-						CharacterSDF character;
+		std::vector<CachedCharacterSDF> sdfCharacters;
+		for (const auto& [ch, character] : generator.GetCharacters())
+		{
+			sdfCharacters.push_back({ ch,
+				character.x0, character.y0, character.x1, character.y1,
+				character.m_Size.x, character.m_Size.y,
+				character.m_Bearing.x, character.m_Bearing.y,
+				character.m_Advance });
+		}
 
-						character.x0 = pen_x;
-						character.y0 = pen_y;
-						character.x1 = pen_x + w;
-						character.y1 = pen_y + h;
-						character.m_Bearing.x = 0;
-						character.m_Bearing.y = 0;
-						character.m_Advance = w;
-						character.m_Size = glm::ivec2(w, h);
-						m_CharacterLibrary.Add(ch, character);
+		FontCacheContents contents;
+		contents.AtlasWidth = generator.GetWidth();
+		contents.AtlasHeight = generator.GetHeight();
+		contents.AtlasPixels = generator.GetPixels().data();
+		contents.SDFCharacters = sdfCharacters.data();
+		contents.SDFCharacterCount = (uint32_t)sdfCharacters.size();
+		contents.BitmapAtlasWidth = bitmapFont.GetWidth();
+		contents.BitmapAtlasHeight = bitmapFont.GetHeight();
+		contents.BitmapAtlasPixels = bitmapFont.GetPixels().data();
+		contents.BitmapGlyphs = bitmapFont.GetGlyphs().data();
+		contents.BitmapGlyphCount = (uint32_t)bitmapFont.GetGlyphs().size();
+
+		if (!FontCache::Write("cache/Fonts.cache", key, contents))
+			std::cout << "FontCache: could not write cache/Fonts.cache" << std::endl;
+
+		CreateGlyphCache(parameters, contents);
+		CreateMSDFTexture(contents);
+	}
 
-						delete[] imgBuffer;
-						pen_x += w + 1;
-					}
-				}
+	void Application::CreateGlyphCache(const FontCacheParameters& parameters, const FontCacheContents& contents)
+	{
+		GlyphCacheSpecification specification;
+		specification.FontFilepath = parameters.Bitmap.FontFilepath;
+		specification.PixelSizes = parameters.Bitmap.PixelSizes;
 
-				msdfgen::destroyFont(font);
-			}
-			msdfgen::deinitializeFreetype(ft);
+		m_GlyphCache = std::make_unique<GlyphCache>(specification);
+		m_GlyphCache->Preload(contents.BitmapGlyphs, contents.BitmapGlyphCount, contents.BitmapAtlasPixels,
+			contents.BitmapAtlasWidth, contents.BitmapAtlasHeight);
+	}
+
+	void Application::CreateMSDFTexture(const FontCacheContents& contents)
+	{
+		for (uint32_t i = 0; i < contents.SDFCharacterCount; i++)
+		{
+			const CachedCharacterSDF& cached = contents.SDFCharacters[i];
+
+			CharacterSDF character;
+			character.x0 = cached.X0;
+			character.y0 = cached.Y0;
+			character.x1 = cached.X1;
+			character.y1 = cached.Y1;
+			character.m_Size = glm::ivec2(cached.Width, cached.Height);
+			character.m_Bearing = glm::ivec2(cached.BearingX, cached.BearingY);
+			character.m_Advance = cached.Advance;
+			m_CharacterLibrary.Add((unsigned char)cached.Codepoint, character);
 		}
 
+		int tex_width = contents.AtlasWidth;
+		int tex_height = contents.AtlasHeight;
+		const unsigned char* pixels = contents.AtlasPixels;
+
 		////////// generate texture
 		unsigned int texture;
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		RenderState::BindTexture(0, GL_TEXTURE_2D, texture);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -636,7 +1003,7 @@ namespace OpenGLSandbox {
 			0,
 			GL_RGB,
 			GL_UNSIGNED_BYTE,
-			&pixels[0]
+			pixels
 		);
 		// set texture options
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -646,11 +1013,102 @@ namespace OpenGLSandbox {
 
 		m_FontTexture = texture;
 
-		glBindTexture(GL_TEXTURE_2D, 0);
-
 		//stbi_write_png(("res/" + std::string("FontTexture") + std::string(".png")).c_str(), tex_width, tex_height, 3, pixels, tex_width * 3);
+	}
 
-		free(pixels);
+	void Application::CreateSpriteScene()
+	{
+		m_QuadRenderer = std::make_unique<QuadRenderer>(*m_QuadShader, *m_StreamBuffer);
+
+		// four procedural 32x32 layers: a checker board, rings, stripes and a soft disc
+		const int size = 32, layers = 4;
+		std::vector<uint32_t> pixels(size * size * layers);
+		for (int layer = 0; layer < layers; layer++)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					glm::vec2 p = (glm::vec2(x, y) + 0.5f) / (float)size - 0.5f;
+					float distance = glm::length(p) * 2.0f;
+					float value = 1.0f, alpha = 1.0f;
+					if (layer == 0)
+						value = ((x / 8 + y / 8) & 1) ? 1.0f : 0.4f;
+					else if (layer == 1) {
+						value = ((int)(distance * 4.0f) & 1) ? 1.0f : 0.5f;
+						alpha = distance < 1.0f ? 1.0f : 0.0f;
+					}
+					else if (layer == 2)
+						value = (((x + y) / 4) & 1) ? 1.0f : 0.3f;
+					else
+						alpha = glm::clamp(1.0f - distance, 0.0f, 1.0f);
+					pixels[(layer * size + y) * size + x] = QuadRenderer::PackColor(glm::vec4(glm::vec3(value), alpha));
+				}
+			}
+		}
+
+		glGenTextures(1, &m_SpriteTexture);
+		RenderState::BindTexture(0, GL_TEXTURE_2D_ARRAY, m_SpriteTexture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// a fixed seed, so every headless run renders the same frames
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		m_Sprites.resize(m_Specification.QuadCount);
+		for (size_t i = 0; i < m_Sprites.size(); i++)
+		{
+			Sprite& sprite = m_Sprites[i];
+			sprite.Position = glm::vec2(unit(random) * m_Width, unit(random) * m_Height);
+			float angle = unit(random) * 6.2831853f;
+			sprite.Velocity = glm::vec2(std::cos(angle), std::sin(angle)) * (20.0f + unit(random) * 100.0f);
+			sprite.Rotation = unit(random) * 6.2831853f;
+			sprite.Spin = (unit(random) - 0.5f) * 4.0f;
+			sprite.Size = 4.0f + unit(random) * 12.0f;
+			sprite.Layer = (float)(int)(unit(random) * layers);
+			// neighbours share an image, so they still batch
+			sprite.Image = (uint32_t)(i * m_Specification.SpriteImageCount / m_Sprites.size());
+			sprite.Color = QuadRenderer::PackColor(glm::vec4(unit(random), unit(random), unit(random), 0.8f));
+		}
+
+		if (!m_Specification.SpriteImageCount)
+			return;
+		// the quad renderer batches by texture array, so the images are arrays of one layer
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		TextureStreamerSpecification streaming;
+		streaming.Target = GL_TEXTURE_2D_ARRAY;
+		streaming.UploadBudget = m_Specification.TextureUploadBudget;
+		streaming.PixelBufferMode = m_Specification.StreamBufferMode;
+		m_TextureStreamer = std::make_unique<TextureStreamer>(streaming);
+		for (const std::string& path : Utils::WriteSpriteImages(m_Specification.SpriteImageCount))
+			m_SpriteImages.push_back(m_TextureStreamer->Load(path));
+		std::chrono::duration<double, std::milli> requestTime = std::chrono::steady_clock::now() - start;
+		std::cout << "TextureStreamer: " << m_SpriteImages.size() << " sprite images requested in " << requestTime.count()
+			<< " ms, uploading " << streaming.UploadBudget << " bytes a frame" << std::endl;
 	}
 
+	void Application::UpdateSprites(float deltaTime, std::vector<QuadTransform>& transforms)
+	{
+		PROFILE_SCOPE("Sprite Update");
+		glm::vec2 bounds = glm::vec2(m_Width, m_Height);
+		// every sprite only touches itself
+		JobSystem::ParallelFor((uint32_t)m_Sprites.size(), [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				Sprite& sprite = m_Sprites[i];
+				sprite.Position += sprite.Velocity * deltaTime;
+				for (int axis = 0; axis < 2; axis++)
+				{
+					if ((sprite.Position[axis] < 0.0f && sprite.Velocity[axis] < 0.0f) || (sprite.Position[axis] > bounds[axis] && sprite.Velocity[axis] > 0.0f))
+						sprite.Velocity[axis] = -sprite.Velocity[axis];
+				}
+				sprite.Rotation += sprite.Spin * deltaTime;
+				transforms[i] = QuadRenderer::MakeTransform(sprite.Position, glm::vec2(sprite.Size), sprite.Rotation);
+			}
+		});
+	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include "Utilities/Shader.h"
+#include "Utilities/ShaderCompiler.h"
 
 
 #include <glad/glad.h>
@@ -14,37 +15,184 @@
 #include <map>
 #include <filesystem>
 #include "Utilities/CharacterLibrary.h"
+#include "Utilities/FontCache.h"
+#include "Renderer/GlyphCache.h"
+#include "Renderer/TextRenderer.h"
+#include "Renderer/FrameBenchmark.h"
+#include "Renderer/GPUProfiler.h"
+#include "Renderer/RenderGraph.h"
+#include "Renderer/RenderQueue.h"
+#include "Renderer/QuadRenderer.h"
+#include "Renderer/StreamBuffer.h"
+#include "Renderer/TextureStreamer.h"
+#include "Utilities/UniformBuffer.h"
+#include "Utilities/HeadlessContext.h"
+#include "Utilities/FramePacer.h"
 struct GLFWwindow;
 
 namespace OpenGLSandbox {
 
 	typedef char byte;
 
+	struct ApplicationSpecification
+	{
+		unsigned int Width = 800;
+		unsigned int Height = 600;
+
+		// Renders FrameCount frames offscreen, with no window or vsync and a fixed 60 Hz clock, then
+		// writes <ReportPath>.csv, .json and .png and compares the run with BaselinePath, if set.
+		bool Headless = false;
+		uint32_t FrameCount = 600;
+		std::string ReportPath = "benchmark";
+		std::string BaselinePath;
+		double Tolerance = 0.25;	// allowed slowdown of the median frame times
+
+		// Chrome trace of every profiler zone of the run, written on exit
+		std::string TracePath;
+
+		// sprites of the quad benchmark scene, drawn over the scene when non-zero
+		uint32_t QuadCount = 0;
+		// images the sprites are textured with instead of the procedural layers, streamed in while the
+		// scene runs; written to cache/Sprites on first use
+		uint32_t SpriteImageCount = 0;
+		size_t TextureUploadBudget = 4 << 20;	// bytes a frame
+
+		// Renders on a second thread that owns the context, a frame behind the main thread, which
+		// only polls input and produces the next frame's data.
+		bool RenderThread = false;
+
+		// When the loop redraws. Capped holds every frame until TargetFPS allows the next; on demand
+		// waits for events and redraws only for input, a resize, animation or a changed label. A
+		// headless run still advances its fixed clock FrameCount times, rendering the frames that
+		// were invalidated.
+		FramePolicy FramePacing = FramePolicy::Continuous;
+		double TargetFPS = 60.0;
+
+		// how dynamic geometry reaches the GPU; falls back when the driver lacks buffer storage
+		StreamMode StreamBufferMode = StreamMode::Persistent;
+
+		// checks RenderState's shadow against glGet* after every frame
+#ifdef _DEBUG
+		bool ValidateRenderState = true;
+#else
+		bool ValidateRenderState = false;
+#endif
+	};
+
 	class Application
 	{
 	public:
-		Application();
+		// written by --pack-assets, mounted at startup when present
+		static constexpr const char* AssetArchivePath = "cache/Assets.pack";
+
+	public:
+		Application(const ApplicationSpecification& specification = ApplicationSpecification());
 		~Application();
 
-		void Run();
+		// Returns the process exit code, non-zero when a headless run regressed against its baseline.
+		int Run();
+
+		// from the window's framebuffer size callback
+		void OnResize(int width, int height);
+		// from the window's input callbacks; the next frame is redrawn even on demand
+		inline void Invalidate() { m_FrameInvalidated = true; }
 
 	private:
 		void ProcessInputs();
 		void CreateWindows();
-		void RenderText(unsigned int VAO, unsigned int VBO, Shader& shader, std::string text, float x, float y, float scale, glm::vec3 color);
-		void CreateMSDFTexture();
+		void InitializeGLState();
+		void CreateBackBuffer();
+		int WriteBenchmarkReport(FrameBenchmark& benchmark);
+		void LoadFonts();
+		void CreateGlyphCache(const FontCacheParameters& parameters, const FontCacheContents& contents);
+		void CreateMSDFTexture(const FontCacheContents& contents);
+		void CreateSpriteScene();
+		void UpdateSprites(float deltaTime, std::vector<QuadTransform>& transforms);
+		void MakeContextCurrent(bool current);
+		// Destroys every member that owns GL objects, in reverse order of creation; the context has
+		// to be current. Called before the window goes, and again, doing nothing, on destruction.
+		void ReleaseGLResources();
 	private:
+		ApplicationSpecification m_Specification;
 		GLFWwindow* m_Window = nullptr;
+		HeadlessContext m_HeadlessContext;
 		unsigned int m_Width = 800;
 		unsigned int m_Height = 600;
+		bool m_FrameInvalidated = true;	// since the last frame was produced
+		// what the frame ends up in: the window's framebuffer, or an offscreen one when headless
+		unsigned int m_BackBuffer = 0;
+		unsigned int m_BackBufferColor = 0, m_BackBufferDepth = 0;
 
+		// declared before the shaders, which must not outlive them
+		std::unique_ptr<ShaderCache> m_ShaderCache;
+		std::unique_ptr<ShaderCompiler> m_ShaderCompiler;
 		std::unique_ptr<Shader> m_UnlitShader;
 		std::unique_ptr<Shader> m_ScreenShader;
 		std::unique_ptr<Shader> m_TextShader;
+		std::unique_ptr<Shader> m_QuadShader;
+		std::unique_ptr<GlyphCache> m_GlyphCache;
+		std::unique_ptr<StreamBuffer> m_StreamBuffer;
+		std::unique_ptr<TextRenderer> m_TextRenderer;
+		std::unique_ptr<GPUProfiler> m_GPUProfiler;
+		std::unique_ptr<RenderGraph> m_RenderGraph;
+		// the frame's draws, recorded before the graph runs and issued by its scene pass
+		RenderQueue m_RenderQueue;
+
+		// the quad benchmark scene, bouncing sprites with their own pass and queue
+		struct Sprite
+		{
+			glm::vec2 Position, Velocity;
+			float Rotation, Spin;
+			float Size;
+			float Layer;
+			uint32_t Image;		// into m_SpriteImages
+			uint32_t Color;
+		};
+		std::unique_ptr<QuadRenderer> m_QuadRenderer;
+		std::vector<Sprite> m_Sprites;
+		unsigned int m_SpriteTexture = 0;
+		std::unique_ptr<TextureStreamer> m_TextureStreamer;
+		std::vector<TextureHandle> m_SpriteImages;
+		std::vector<unsigned int> m_SpriteImageTextures;	// what each image draws with this frame
+		RenderQueue m_SpriteQueue;
+
+		// what the render thread reports back about a frame
+		struct FrameResults
+		{
+			double Latency = 0.0;	// ms from sampling the input to presenting
+			bool ShadersPending = false;	// the frame drew with fallback programs
+			uint32_t TextDrawCalls = 0;
+			uint64_t TextBytesUploaded = 0;
+			uint32_t UniformCalls = 0, SkippedUniformCalls = 0;
+			uint32_t StateCalls = 0, FilteredStateCalls = 0;
+		};
+
+		// everything a frame is rendered from, written by the main thread
+		struct FrameData
+		{
+			static constexpr uint32_t NotRendered = ~0u;
+
+			uint32_t Index = NotRendered;
+			float Time = 0.0f;
+			uint64_t InputTime = 0;		// Profiler::Now() when the input was polled
+			unsigned int Width = 0, Height = 0;
+			std::string FpsText;		// empty when the label doesn't change
+			std::vector<QuadTransform> SpriteTransforms;
+
+			FrameResults Results;
+		};
+
+		// std140 layout of the Frame uniform block, shared by every program that declares it
+		struct FrameUniforms
+		{
+			glm::mat4 ScreenProjection;
+			glm::vec4 Time;
+		};
+		static constexpr uint32_t FrameUniformBinding = 0;
+		std::unique_ptr<UniformBuffer> m_FrameUniformBuffer;
 
-		std::map<GLchar, Character> Characters;
 
-		unsigned int m_FontTexture;
+		unsigned int m_FontTexture = 0;
 
 		CharacterLibrary m_CharacterLibrary;
 	};
@@ -1,9 +1,142 @@
 #include "Application.h"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "Utilities/MSDFAtlasGenerator.h"
+#include "Utilities/RectPacker.h"
+#include "Utilities/GlyphLookupTable.h"
+#include "Utilities/PixelBlit.h"
+#include "Utilities/ShaderCache.h"
+#include "Utilities/ShaderCompiler.h"
+#include "Utilities/FileSystem.h"
+#include "Utilities/HeadlessContext.h"
+#include "Utilities/JobSystem.h"
+#include "Renderer/RenderQueue.h"
 
-
-int main()
+int main(int argc, char** argv)
 {
-	OpenGLSandbox::Application* app = new OpenGLSandbox::Application;
-	app->Run();
+	// every subsystem runs its parallel work as jobs, the benchmarks included
+	// --workers N: job threads besides the main thread, --pin-workers: one core each
+	OpenGLSandbox::JobSystem::Specification jobs;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			jobs.WorkerCount = (uint32_t)std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--pin-workers") == 0)
+			jobs.PinWorkers = true;
+	}
+	OpenGLSandbox::JobSystem::Initialize(jobs);
+
+	// benchmarks run without a visible window
+	OpenGLSandbox::ApplicationSpecification specification;
+	for (int i = 1; i < argc; i++)
+	{
+		int flag = i;
+		// --headless [--frames N] [--size WxH] [--report path] [--baseline path.json] [--tolerance 0.25]
+		if (strcmp(argv[i], "--headless") == 0)
+			specification.Headless = true;
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			specification.FrameCount = (uint32_t)std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+			sscanf(argv[++i], "%ux%u", &specification.Width, &specification.Height);
+		else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+			specification.ReportPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			specification.BaselinePath = argv[++i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			specification.Tolerance = atof(argv[++i]);
+		// --trace path.json: Chrome trace of the profiler zones
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			specification.TracePath = argv[++i];
+		else if (strcmp(argv[i], "--validate-state") == 0)
+			specification.ValidateRenderState = true;
+		// --quads N: the quad benchmark scene with N sprites
+		else if (strcmp(argv[i], "--quads") == 0 && i + 1 < argc)
+			specification.QuadCount = (uint32_t)std::max(0, atoi(argv[++i]));
+		// --sprite-images N [--texture-budget KB]: the sprites textured with N streamed images
+		else if (strcmp(argv[i], "--sprite-images") == 0 && i + 1 < argc)
+			specification.SpriteImageCount = (uint32_t)std::max(0, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+			specification.TextureUploadBudget = (size_t)std::max(1, atoi(argv[++i])) << 10;
+		else if (strcmp(argv[i], "--render-thread") == 0)
+			specification.RenderThread = true;
+		// --frame-policy continuous|capped|on-demand [--fps N]
+		else if (strcmp(argv[i], "--frame-policy") == 0 && i + 1 < argc) {
+			const char* policy = argv[++i];
+			if (strcmp(policy, "capped") == 0)
+				specification.FramePacing = OpenGLSandbox::FramePolicy::Capped;
+			else if (strcmp(policy, "on-demand") == 0)
+				specification.FramePacing = OpenGLSandbox::FramePolicy::OnDemand;
+			else
+				specification.FramePacing = OpenGLSandbox::FramePolicy::Continuous;
+		}
+		else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+			specification.TargetFPS = std::max(1.0, atof(argv[++i]));
+		// --stream-mode persistent|unsynchronized|orphan
+		else if (strcmp(argv[i], "--stream-mode") == 0 && i + 1 < argc) {
+			const char* mode = argv[++i];
+			if (strcmp(mode, "unsynchronized") == 0)
+				specification.StreamBufferMode = OpenGLSandbox::StreamMode::Unsynchronized;
+			else if (strcmp(mode, "orphan") == 0)
+				specification.StreamBufferMode = OpenGLSandbox::StreamMode::Orphan;
+			else
+				specification.StreamBufferMode = OpenGLSandbox::StreamMode::Persistent;
+		}
+		// the job system flags were read above, only their values are skipped here
+		else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+			i++;
+		// a flag that took a value is done; the value is never read as a flag itself
+		if (i != flag)
+			continue;
+
+		if (strcmp(argv[i], "--benchmark-msdf") == 0) {
+			OpenGLSandbox::MSDFAtlasGenerator::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-packing") == 0) {
+			OpenGLSandbox::RectPacker::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-glyphs") == 0) {
+			OpenGLSandbox::GlyphLookupTable::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-blit") == 0) {
+			OpenGLSandbox::PixelBlit::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-jobs") == 0) {
+			OpenGLSandbox::JobSystem::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-queue") == 0) {
+			OpenGLSandbox::RenderQueue::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--benchmark-shaders") == 0) {
+			OpenGLSandbox::HeadlessContext context;
+			if (!context.Create())
+				return 1;
+			OpenGLSandbox::ShaderCache::RunBenchmark(std::cout);
+			OpenGLSandbox::ShaderCompiler::RunBenchmark(std::cout);
+			return 0;
+		}
+		if (strcmp(argv[i], "--check-blit") == 0)
+			return OpenGLSandbox::PixelBlit::RunSelfCheck(std::cout) ? 0 : 1;
+		if (strcmp(argv[i], "--pack-assets") == 0) {
+			if (!OpenGLSandbox::FileSystem::WriteArchive("res", OpenGLSandbox::Application::AssetArchivePath)) {
+				std::cout << "Failed to write " << OpenGLSandbox::Application::AssetArchivePath << std::endl;
+				return 1;
+			}
+			std::cout << "Packed res/ into " << OpenGLSandbox::Application::AssetArchivePath << std::endl;
+			return 0;
+		}
+	}
+
+	OpenGLSandbox::Application* app = new OpenGLSandbox::Application(specification);
+	int result = app->Run();
 	delete app;
+	OpenGLSandbox::JobSystem::Shutdown();
+	return result;
 }
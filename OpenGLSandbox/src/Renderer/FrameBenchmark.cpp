@@ -0,0 +1,244 @@
+#include "FrameBenchmark.h"
+#include <glad/glad.h>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static double Percentile(std::vector<double> values, double percentile)
+		{
+			if (values.empty())
+				return 0.0;
+			std::sort(values.begin(), values.end());
+			size_t index = (size_t)(percentile * (values.size() - 1) + 0.5);
+			return values[std::min(index, values.size() - 1)];
+		}
+
+		// the summaries are flat objects written by WriteJSON, no general parser needed
+		static bool FindJSONValue(const std::string& json, const char* key, std::string& value)
+		{
+			std::string quoted = std::string("\"") + key + "\"";
+			size_t position = json.find(quoted);
+			if (position == std::string::npos)
+				return false;
+			position = json.find(':', position + quoted.size());
+			if (position == std::string::npos)
+				return false;
+			position = json.find_first_not_of(" \t", position + 1);
+			if (position == std::string::npos)
+				return false;
+			// strings may contain commas (renderer names do), numbers end at the next separator
+			bool isString = json[position] == '"';
+			if (isString)
+				position++;
+			size_t end = isString ? json.find('"', position) : json.find_first_of(",\n}", position);
+			if (end == std::string::npos)
+				return false;
+			value = json.substr(position, end - position);
+			return true;
+		}
+
+		static const char* GetGLString(GLenum name)
+		{
+			const char* string = (const char*)glGetString(name);
+			return string ? string : "";
+		}
+	}
+
+	FrameBenchmark::FrameBenchmark()
+	{
+		glGenQueries(QueryCount, m_Queries);
+		std::fill(std::begin(m_QueryFrames), std::end(m_QueryFrames), NoFrame);
+	}
+
+	FrameBenchmark::~FrameBenchmark()
+	{
+		glDeleteQueries(QueryCount, m_Queries);
+	}
+
+	void FrameBenchmark::BeginFrame()
+	{
+		// the slot was last used QueryCount frames ago, its result is there by now or almost
+		int slot = (int)(m_Records.size() % QueryCount);
+		ReadQuery(slot);
+
+		m_QueryFrames[slot] = (uint32_t)m_Records.size();
+		m_FrameStart = m_QueryStarts[slot] = std::chrono::steady_clock::now();
+		if (m_Records.empty())
+			m_RunStart = m_FrameStart;
+		glBeginQuery(GL_TIME_ELAPSED, m_Queries[slot]);
+	}
+
+	void FrameBenchmark::EndFrame(const FrameCounters& counters)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+
+		FrameRecord record;
+		m_RunEnd = std::chrono::steady_clock::now();
+		record.Frame = (uint32_t)m_Records.size();
+		record.CPUTime = std::chrono::duration<double, std::milli>(m_RunEnd - m_FrameStart).count();
+		record.Counters = counters;
+		m_Records.push_back(record);
+	}
+
+	void FrameBenchmark::Finish(uint64_t imageChecksum)
+	{
+		for (int slot = 0; slot < QueryCount; slot++)
+			ReadQuery(slot);
+		m_ImageChecksum = imageChecksum;
+	}
+
+	void FrameBenchmark::ReadQuery(int slot)
+	{
+		uint32_t frame = m_QueryFrames[slot];
+		if (frame == NoFrame)
+			return;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_Queries[slot], GL_QUERY_RESULT, &nanoseconds);
+		// the GPU can't have spent longer on the frame than has passed since it was submitted. Some
+		// drivers (llvmpipe) return garbage for a query begun before anything was rendered
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_QueryStarts[slot]).count();
+		double milliseconds = nanoseconds / 1e6;
+		m_Records[frame].GPUTime = milliseconds <= elapsed ? milliseconds : -1.0;
+		m_QueryFrames[slot] = NoFrame;
+	}
+
+	FrameBenchmark::Summary FrameBenchmark::GetSummary() const
+	{
+		Summary summary;
+		summary.Frames = (uint32_t)m_Records.size();
+		summary.ImageChecksum = m_ImageChecksum;
+
+		std::vector<double> cpu, gpu, latency;
+		for (const FrameRecord& record : m_Records)
+		{
+			cpu.push_back(record.CPUTime);
+			latency.push_back(record.Counters.Latency);
+			if (record.GPUTime >= 0.0)
+				gpu.push_back(record.GPUTime);
+			summary.DrawCalls += record.Counters.DrawCalls;
+			summary.Glyphs += record.Counters.Glyphs;
+			summary.BytesUploaded += record.Counters.BytesUploaded;
+			summary.UniformCalls += record.Counters.UniformCalls;
+			summary.StateCalls += record.Counters.StateCalls;
+			summary.BytesStreamed += record.Counters.BytesStreamed;
+			summary.StreamStallTime += record.Counters.StreamStallTime;
+		}
+		summary.CPUMedian = Utils::Percentile(cpu, 0.5);
+		summary.CPUP95 = Utils::Percentile(cpu, 0.95);
+		summary.GPUMedian = Utils::Percentile(gpu, 0.5);
+		summary.GPUP95 = Utils::Percentile(gpu, 0.95);
+		summary.LatencyMedian = Utils::Percentile(latency, 0.5);
+		summary.LatencyP95 = Utils::Percentile(latency, 0.95);
+		double seconds = std::chrono::duration<double>(m_RunEnd - m_RunStart).count();
+		summary.Throughput = seconds > 0.0 ? summary.Frames / seconds : 0.0;
+		return summary;
+	}
+
+	bool FrameBenchmark::WriteCSV(const std::string& filepath) const
+	{
+		std::ofstream stream(filepath, std::ios::trunc);
+		stream << "frame,cpu_ms,gpu_ms,draw_calls,glyphs,bytes_uploaded,uniform_calls,state_calls,bytes_streamed,stream_stall_ms,latency_ms\n";
+		stream << std::fixed << std::setprecision(4);
+		for (const FrameRecord& record : m_Records)
+		{
+			stream << record.Frame << ',' << record.CPUTime << ',' << record.GPUTime << ','
+				<< record.Counters.DrawCalls << ',' << record.Counters.Glyphs << ','
+				<< record.Counters.BytesUploaded << ',' << record.Counters.UniformCalls << ',' << record.Counters.StateCalls << ','
+				<< record.Counters.BytesStreamed << ',' << record.Counters.StreamStallTime << ',' << record.Counters.Latency << '\n';
+		}
+		return (bool)stream;
+	}
+
+	bool FrameBenchmark::WriteJSON(const std::string& filepath) const
+	{
+		Summary summary = GetSummary();
+		std::ofstream stream(filepath, std::ios::trunc);
+		stream << std::fixed << std::setprecision(4);
+		stream << "{\n"
+			<< "  \"renderer\": \"" << Utils::GetGLString(GL_RENDERER) << "\",\n"
+			<< "  \"version\": \"" << Utils::GetGLString(GL_VERSION) << "\",\n"
+			<< "  \"frames\": " << summary.Frames << ",\n"
+			<< "  \"cpu_median_ms\": " << summary.CPUMedian << ",\n"
+			<< "  \"cpu_p95_ms\": " << summary.CPUP95 << ",\n"
+			<< "  \"gpu_median_ms\": " << summary.GPUMedian << ",\n"
+			<< "  \"gpu_p95_ms\": " << summary.GPUP95 << ",\n"
+			<< "  \"latency_median_ms\": " << summary.LatencyMedian << ",\n"
+			<< "  \"latency_p95_ms\": " << summary.LatencyP95 << ",\n"
+			<< "  \"throughput_fps\": " << summary.Throughput << ",\n"
+			<< "  \"draw_calls\": " << summary.DrawCalls << ",\n"
+			<< "  \"glyphs\": " << summary.Glyphs << ",\n"
+			<< "  \"bytes_uploaded\": " << summary.BytesUploaded << ",\n"
+			<< "  \"uniform_calls\": " << summary.UniformCalls << ",\n"
+			<< "  \"state_calls\": " << summary.StateCalls << ",\n"
+			<< "  \"bytes_streamed\": " << summary.BytesStreamed << ",\n"
+			<< "  \"stream_stall_ms\": " << summary.StreamStallTime << ",\n"
+			<< "  \"image_checksum\": \"" << std::hex << std::setw(16) << std::setfill('0') << summary.ImageChecksum << "\"\n"
+			<< "}\n";
+		return (bool)stream;
+	}
+
+	bool FrameBenchmark::CompareToBaseline(const Summary& summary, const std::string& baselinePath, double tolerance, std::ostream& out)
+	{
+		std::ifstream stream(baselinePath);
+		if (!stream) {
+			out << "baseline " << baselinePath << " not found" << std::endl;
+			return false;
+		}
+		std::stringstream contents;
+		contents << stream.rdbuf();
+		std::string json = contents.str();
+
+		bool passed = true;
+		std::string value;
+		if (Utils::FindJSONValue(json, "renderer", value) && value != Utils::GetGLString(GL_RENDERER))
+			out << "  note: baseline was recorded on " << value << ", timings are not comparable" << std::endl;
+
+		auto compareCount = [&](const char* key, uint64_t current)
+		{
+			if (!Utils::FindJSONValue(json, key, value)) {
+				out << "  " << key << ": missing in baseline" << std::endl;
+				passed = false;
+				return;
+			}
+			uint64_t baseline = std::strtoull(value.c_str(), nullptr, 10);
+			if (baseline != current) {
+				out << "  " << key << ": " << current << ", baseline " << baseline << "  REGRESSION" << std::endl;
+				passed = false;
+			}
+		};
+		compareCount("frames", summary.Frames);
+		compareCount("draw_calls", summary.DrawCalls);
+		compareCount("glyphs", summary.Glyphs);
+		compareCount("bytes_uploaded", summary.BytesUploaded);
+		compareCount("uniform_calls", summary.UniformCalls);
+		compareCount("state_calls", summary.StateCalls);
+		compareCount("bytes_streamed", summary.BytesStreamed);
+
+		if (Utils::FindJSONValue(json, "image_checksum", value) && std::strtoull(value.c_str(), nullptr, 16) != summary.ImageChecksum) {
+			out << "  image_checksum: the last frame differs from the baseline  REGRESSION" << std::endl;
+			passed = false;
+		}
+
+		// a small absolute slack keeps sub millisecond frames from failing on noise
+		auto compareTime = [&](const char* key, double current)
+		{
+			if (!Utils::FindJSONValue(json, key, value))
+				return;
+			double baseline = std::strtod(value.c_str(), nullptr);
+			bool slower = current > baseline * (1.0 + tolerance) + 0.05;
+			out << "  " << key << ": " << current << ", baseline " << baseline << (slower ? "  REGRESSION" : "") << std::endl;
+			passed &= !slower;
+		};
+		compareTime("cpu_median_ms", summary.CPUMedian);
+		compareTime("gpu_median_ms", summary.GPUMedian);
+		compareTime("latency_median_ms", summary.LatencyMedian);
+		return passed;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	struct FrameCounters
+	{
+		uint32_t DrawCalls = 0;
+		uint32_t Glyphs = 0;
+		uint64_t BytesUploaded = 0;
+		uint32_t UniformCalls = 0;
+		uint32_t StateCalls = 0;	// GL state changes RenderState let through
+		uint64_t BytesStreamed = 0;	// allocated from the stream buffer
+		double StreamStallTime = 0.0;	// ms waited for a stream buffer region
+		double Latency = 0.0;			// ms from sampling the frame's input to presenting it
+	};
+
+	// Records CPU time, GPU time (GL_TIME_ELAPSED) and the renderer's counters of every frame of a
+	// fixed length run. Writes one CSV row per frame and a JSON summary, and compares a summary with
+	// a stored baseline. GPU timings are read back a few frames late, so measuring doesn't stall.
+	class FrameBenchmark
+	{
+	public:
+		struct FrameRecord
+		{
+			uint32_t Frame = 0;
+			double CPUTime = 0.0;	// ms, from BeginFrame to EndFrame
+			double GPUTime = 0.0;	// ms, negative when the driver returned no usable result
+			FrameCounters Counters;
+		};
+
+		struct Summary
+		{
+			uint32_t Frames = 0;
+			double CPUMedian = 0.0, CPUP95 = 0.0;	// ms
+			double GPUMedian = 0.0, GPUP95 = 0.0;
+			double LatencyMedian = 0.0, LatencyP95 = 0.0;
+			double Throughput = 0.0;			// frames per second, from the first BeginFrame to the last EndFrame
+			uint64_t DrawCalls = 0, Glyphs = 0, BytesUploaded = 0, UniformCalls = 0, StateCalls = 0;	// over the whole run
+			uint64_t BytesStreamed = 0;
+			double StreamStallTime = 0.0;	// ms, over the whole run
+			uint64_t ImageChecksum = 0;			// of the last frame
+		};
+
+	public:
+		// Needs a current GL context.
+		FrameBenchmark();
+		~FrameBenchmark();
+
+		void BeginFrame();
+		void EndFrame(const FrameCounters& counters);
+		// Waits for the outstanding GPU timings.
+		void Finish(uint64_t imageChecksum);
+
+		inline const std::vector<FrameRecord>& GetRecords() const { return m_Records; }
+		Summary GetSummary() const;
+
+		bool WriteCSV(const std::string& filepath) const;
+		bool WriteJSON(const std::string& filepath) const;
+
+		// Counters and the image have to match exactly, the median times may be up to tolerance slower
+		// (0.25 = 25%). Prints every difference; false on a regression or an unreadable baseline.
+		static bool CompareToBaseline(const Summary& summary, const std::string& baselinePath, double tolerance, std::ostream& out);
+
+	private:
+		// blocks until the query in the slot has its result
+		void ReadQuery(int slot);
+
+	private:
+		static constexpr int QueryCount = 4;
+		static constexpr uint32_t NoFrame = ~0u;
+
+		unsigned int m_Queries[QueryCount] = {};
+		uint32_t m_QueryFrames[QueryCount];
+		std::chrono::steady_clock::time_point m_QueryStarts[QueryCount];
+		std::vector<FrameRecord> m_Records;
+		std::chrono::steady_clock::time_point m_FrameStart;
+		std::chrono::steady_clock::time_point m_RunStart, m_RunEnd;
+		uint64_t m_ImageChecksum = 0;
+	};
+}
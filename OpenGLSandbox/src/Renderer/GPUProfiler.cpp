@@ -0,0 +1,131 @@
+#include "GPUProfiler.h"
+#include <glad/glad.h>
+
+namespace OpenGLSandbox {
+
+	// the GL and CPU clocks drift apart slowly, the offset is refreshed every few seconds
+	static constexpr uint32_t CalibrationInterval = 256;
+
+	GPUProfiler::GPUProfiler()
+	{
+		// timer queries are core in 3.3, but a driver may still report a zero bit counter
+		GLint bits = 0;
+		if (GLAD_GL_VERSION_3_3 && glQueryCounter && glGetQueryObjectui64v)
+			glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		m_Supported = bits > 0;
+		if (m_Supported)
+			Calibrate();
+	}
+
+	GPUProfiler::~GPUProfiler()
+	{
+		for (Frame& frame : m_Frames)
+		{
+			if (!frame.Queries.empty())
+				glDeleteQueries((GLsizei)frame.Queries.size(), frame.Queries.data());
+		}
+	}
+
+	void GPUProfiler::BeginFrame()
+	{
+		if (!m_Supported)
+			return;
+
+		// a pass left open would never get its end timestamp
+		while (!m_OpenPasses.empty())
+			End();
+
+		// oldest first, so the zones reach the profiler in frame order
+		for (uint32_t i = 1; i <= FramesInFlight; i++)
+		{
+			Frame& frame = m_Frames[(m_FrameIndex + i) % FramesInFlight];
+			if (frame.Passes.empty())
+				continue;
+			if (!IsAvailable(frame))
+				break;
+			Publish(frame);
+		}
+
+		m_FrameIndex = (m_FrameIndex + 1) % FramesInFlight;
+		Frame& frame = m_Frames[m_FrameIndex];
+		if (!frame.Passes.empty()) {
+			// still running FramesInFlight frames later; waiting for it would stall the pipeline
+			frame.Passes.clear();
+			frame.UsedQueries = 0;
+			m_Statistics.FramesDropped++;
+		}
+
+		if (++m_FramesSinceCalibration >= CalibrationInterval)
+			Calibrate();
+	}
+
+	void GPUProfiler::Begin(Profiler::ZoneID zone)
+	{
+		if (!m_Supported)
+			return;
+
+		Frame& frame = m_Frames[m_FrameIndex];
+		Pass pass;
+		pass.Zone = zone;
+		pass.Depth = (uint16_t)m_OpenPasses.size();
+		pass.BeginQuery = IssueTimestamp(frame);
+		m_OpenPasses.push_back((uint32_t)frame.Passes.size());
+		frame.Passes.push_back(pass);
+	}
+
+	void GPUProfiler::End()
+	{
+		if (!m_Supported || m_OpenPasses.empty())
+			return;
+
+		Frame& frame = m_Frames[m_FrameIndex];
+		frame.Passes[m_OpenPasses.back()].EndQuery = IssueTimestamp(frame);
+		m_OpenPasses.pop_back();
+	}
+
+	uint32_t GPUProfiler::IssueTimestamp(Frame& frame)
+	{
+		if (frame.UsedQueries == frame.Queries.size()) {
+			GLuint query;
+			glGenQueries(1, &query);
+			frame.Queries.push_back(query);
+		}
+		glQueryCounter(frame.Queries[frame.UsedQueries], GL_TIMESTAMP);
+		return frame.UsedQueries++;
+	}
+
+	bool GPUProfiler::IsAvailable(const Frame& frame) const
+	{
+		for (uint32_t i = 0; i < frame.UsedQueries; i++)
+		{
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(frame.Queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return false;
+		}
+		return true;
+	}
+
+	void GPUProfiler::Publish(Frame& frame)
+	{
+		for (const Pass& pass : frame.Passes)
+		{
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(frame.Queries[pass.BeginQuery], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.Queries[pass.EndQuery], GL_QUERY_RESULT, &end);
+			if (end >= begin)
+				Profiler::RecordGPUZone(pass.Zone, begin + m_ClockOffset, end + m_ClockOffset, pass.Depth);
+		}
+		frame.Passes.clear();
+		frame.UsedQueries = 0;
+		m_Statistics.FramesPublished++;
+	}
+
+	void GPUProfiler::Calibrate()
+	{
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		m_ClockOffset = (int64_t)Profiler::Now() - gpuTime;
+		m_FramesSinceCalibration = 0;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "Utilities/Profiler.h"
+
+namespace OpenGLSandbox {
+
+	// Times render passes on the GPU with GL_TIMESTAMP queries, which unlike GL_TIME_ELAPSED may nest.
+	// Queries of the last FramesInFlight frames are kept; a frame is read back only once every one of
+	// its queries reports GL_QUERY_RESULT_AVAILABLE, so timing never waits on the GPU. If a frame is
+	// still not done when its slot comes round again it is dropped. The durations go to the Profiler
+	// as GPU zones. Without timer queries every call does nothing.
+	class GPUProfiler
+	{
+	public:
+		static constexpr uint32_t FramesInFlight = 4;
+
+		struct Statistics
+		{
+			uint32_t FramesPublished = 0;
+			uint32_t FramesDropped = 0;
+		};
+
+		class Scope
+		{
+		public:
+			inline Scope(GPUProfiler& profiler, Profiler::ZoneID zone)
+				: m_Profiler(profiler)
+			{
+				m_Profiler.Begin(zone);
+			}
+			inline ~Scope() { m_Profiler.End(); }
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			GPUProfiler& m_Profiler;
+		};
+
+	public:
+		// Needs a current GL context.
+		GPUProfiler();
+		~GPUProfiler();
+
+		GPUProfiler(const GPUProfiler&) = delete;
+		GPUProfiler& operator=(const GPUProfiler&) = delete;
+
+		// Publishes the finished frames and starts recording the next one.
+		void BeginFrame();
+		void Begin(Profiler::ZoneID zone);
+		void End();
+
+		inline bool IsSupported() const { return m_Supported; }
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		struct Pass
+		{
+			Profiler::ZoneID Zone;
+			uint16_t Depth;
+			uint32_t BeginQuery, EndQuery = 0;	// into the frame's queries
+		};
+
+		struct Frame
+		{
+			std::vector<unsigned int> Queries;	// grows to the most any frame used, never shrinks
+			uint32_t UsedQueries = 0;
+			std::vector<Pass> Passes;
+		};
+
+		uint32_t IssueTimestamp(Frame& frame);
+		bool IsAvailable(const Frame& frame) const;
+		void Publish(Frame& frame);
+		void Calibrate();
+
+	private:
+		bool m_Supported = false;
+		Frame m_Frames[FramesInFlight];
+		uint32_t m_FrameIndex = 0;
+		std::vector<uint32_t> m_OpenPasses;	// indices into the current frame's passes
+		int64_t m_ClockOffset = 0;			// Profiler::Now() - GL_TIMESTAMP
+		uint32_t m_FramesSinceCalibration = 0;
+		Statistics m_Statistics;
+	};
+}
+
+#if OGS_PROFILE
+	#define PROFILE_GPU_SCOPE(profiler, name) \
+		static const ::OpenGLSandbox::Profiler::ZoneID OGS_PROFILE_CONCAT(s_GPUProfileZone, __LINE__) = ::OpenGLSandbox::Profiler::RegisterZone(name); \
+		::OpenGLSandbox::GPUProfiler::Scope OGS_PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, OGS_PROFILE_CONCAT(s_GPUProfileZone, __LINE__))
+#else
+	#define PROFILE_GPU_SCOPE(profiler, name)
+#endif
@@ -0,0 +1,426 @@
+#include "GlyphCache.h"
+#include <glad/glad.h>
+#include <iostream>
+#include <algorithm>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "Utilities/FontLibrary.h"
+#include "Utilities/Profiler.h"
+#include "RenderState.h"
+
+namespace OpenGLSandbox {
+
+	// evicting more than this many glyphs for one miss means the freed space is too fragmented
+	static constexpr int MaxEvictionsPerMiss = 32;
+	static constexpr uint32_t TexelsPerSlot = 3;
+
+	GlyphCache::GlyphCache(const GlyphCacheSpecification& specification)
+		: m_Specification(specification)
+	{
+		m_Specification.Packing.Heuristic = PackingHeuristic::MaxRects;
+		m_Specification.Packing.AllowRotation = false;
+
+		m_PixelSizes = m_Specification.PixelSizes;
+		std::sort(m_PixelSizes.begin(), m_PixelSizes.end());
+		m_PixelSizes.erase(std::unique(m_PixelSizes.begin(), m_PixelSizes.end()), m_PixelSizes.end());
+		m_Lookup.resize(m_PixelSizes.size());
+
+		glGenBuffers(1, &m_GlyphTableBuffer);
+		glGenTextures(1, &m_GlyphTableTexture);
+	}
+
+	GlyphCache::~GlyphCache()
+	{
+		RenderState::DeleteTexture(m_GlyphTableTexture);
+		RenderState::DeleteBuffer(m_GlyphTableBuffer);
+		RenderState::DeleteTexture(m_Texture);
+
+		if (m_Face)
+			FontLibrary::CloseFace(m_Face);
+	}
+
+	void GlyphCache::Preload(const BitmapGlyph* glyphs, uint32_t count, const unsigned char* pixels, int width, int height)
+	{
+		if (width <= 0 || height <= 0)
+			return;
+		if (width > m_Specification.PageSize || height > m_Specification.PageSize) {
+			std::cout << "GlyphCache: preloaded atlas " << width << "x" << height << " is larger than a page" << std::endl;
+			return;
+		}
+
+		PackedRect block;
+		block.Width = width;
+		block.Height = height;
+		int page;
+		if (!Allocate(block, page))
+			return;
+		UploadPixels(page, block.X, block.Y, width, height, pixels, width);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const BitmapGlyph& glyph = glyphs[i];
+			auto size = std::find(m_PixelSizes.begin(), m_PixelSizes.end(), glyph.PixelSize);
+			if (size == m_PixelSizes.end())
+				continue;
+			size_t sizeIndex = size - m_PixelSizes.begin();
+			if (m_Lookup[sizeIndex].Find(glyph.Codepoint) != InvalidSlot)
+				continue;
+
+			uint32_t slot = AllocateSlot();
+			m_Metrics.Advances[slot] = (float)(glyph.Advance >> 6); // advance is in 1/64 pixels
+			m_Metrics.Sizes[slot] = glm::ivec2(glyph.Width, glyph.Height);
+			m_Metrics.Bearings[slot] = glm::ivec2(glyph.BearingX, glyph.BearingY);
+
+			Entry& entry = m_Entries[slot];
+			entry.Codepoint = glyph.Codepoint;
+			entry.SizeIndex = (uint32_t)sizeIndex;
+			entry.Rect.Width = glyph.Width;
+			entry.Rect.Height = glyph.Height;
+			entry.Rect.X = block.X + glyph.X;
+			entry.Rect.Y = block.Y + glyph.Y;
+			// the block was packed as a whole, so its glyphs don't return space one by one;
+			// it is reclaimed when the page is cleared
+			entry.Rect.Packed = false;
+			if (glyph.Width > 0 && glyph.Height > 0) {
+				entry.Page = page;
+				m_LRU.push_back(slot);
+				entry.LRU = std::prev(m_LRU.end());
+			}
+			m_Lookup[sizeIndex].Set(glyph.Codepoint, slot);
+			WriteTableEntry(slot);
+		}
+	}
+
+	void GlyphCache::BeginFrame()
+	{
+		m_Frame++;
+	}
+
+	size_t GlyphCache::FindPixelSize(float pixelSize) const
+	{
+		for (size_t i = 0; i < m_PixelSizes.size(); i++)
+			if ((float)m_PixelSizes[i] >= pixelSize)
+				return i;
+		return m_PixelSizes.empty() ? 0 : m_PixelSizes.size() - 1;
+	}
+
+	uint32_t GlyphCache::Get(uint32_t codepoint, size_t sizeIndex)
+	{
+		if (sizeIndex >= m_PixelSizes.size())
+			return InvalidSlot;
+
+		uint32_t slot = m_Lookup[sizeIndex].Find(codepoint);
+		if (slot != InvalidSlot) {
+			m_Statistics.Hits++;
+			Touch(m_Entries[slot]);
+			return slot;
+		}
+
+		m_Statistics.Misses++;
+		return Rasterize(codepoint, sizeIndex);
+	}
+
+	void GlyphCache::Flush()
+	{
+		if (m_DirtyBegin >= m_DirtyEnd)
+			return;
+
+		RenderState::BindBuffer(GL_TEXTURE_BUFFER, m_GlyphTableBuffer);
+		if (m_Table.size() > m_TableCapacity) {
+			m_TableCapacity = std::max(m_Table.size(), m_TableCapacity * 2);
+			glBufferData(GL_TEXTURE_BUFFER, m_TableCapacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_DRAW);
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, m_Table.size() * sizeof(glm::vec4), m_Table.data());
+
+			RenderState::BindTexture(0, GL_TEXTURE_BUFFER, m_GlyphTableTexture);
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_GlyphTableBuffer);
+		}
+		else {
+			size_t first = (size_t)m_DirtyBegin * TexelsPerSlot;
+			size_t count = (size_t)(m_DirtyEnd - m_DirtyBegin) * TexelsPerSlot;
+			glBufferSubData(GL_TEXTURE_BUFFER, first * sizeof(glm::vec4), count * sizeof(glm::vec4), &m_Table[first]);
+		}
+
+		m_DirtyBegin = UINT32_MAX;
+		m_DirtyEnd = 0;
+	}
+
+	uint32_t GlyphCache::Rasterize(uint32_t codepoint, size_t sizeIndex)
+	{
+		PROFILE_SCOPE("Glyph Rasterize");
+		// opened by the first miss, so a run the preloaded glyphs cover never parses the font; it then
+		// stays open for the lifetime of the cache
+		if (!m_FaceOpened) {
+			m_Face = FontLibrary::OpenFace(m_Specification.FontFilepath);
+			m_FaceOpened = true;
+		}
+		if (!m_Face)
+			return InvalidSlot;
+
+		unsigned int pixelSize = m_PixelSizes[sizeIndex];
+		if (m_FacePixelSize != pixelSize) {
+			FT_Set_Pixel_Sizes(m_Face, 0, pixelSize);
+			m_FacePixelSize = pixelSize;
+		}
+
+		// codepoints the face doesn't cover load glyph 0, the font's .notdef box
+		if (FT_Load_Char(m_Face, codepoint, FT_LOAD_RENDER))
+		{
+			std::cout << "ERROR::FREETYTPE: Failed to load Glyph " << codepoint << std::endl;
+			return InvalidSlot;
+		}
+
+		const FT_Bitmap& bitmap = m_Face->glyph->bitmap;
+		PackedRect rect;
+		rect.Width = (int)bitmap.width;
+		rect.Height = (int)bitmap.rows;
+		int page = -1;
+		if (rect.Width > 0 && rect.Height > 0) {
+			if (!Allocate(rect, page))
+				return InvalidSlot;
+			UploadPixels(page, rect.X, rect.Y, rect.Width, rect.Height, bitmap.buffer, bitmap.pitch);
+		}
+
+		uint32_t slot = AllocateSlot();
+		m_Metrics.Advances[slot] = (float)(m_Face->glyph->advance.x >> 6); // advance is in 1/64 pixels
+		m_Metrics.Sizes[slot] = glm::ivec2(rect.Width, rect.Height);
+		m_Metrics.Bearings[slot] = glm::ivec2(m_Face->glyph->bitmap_left, m_Face->glyph->bitmap_top);
+
+		Entry& entry = m_Entries[slot];
+		entry.Codepoint = codepoint;
+		entry.SizeIndex = (uint32_t)sizeIndex;
+		entry.Page = page;
+		entry.Rect = rect;
+		entry.LastUsed = m_Frame;
+		if (page >= 0) {
+			m_Pages[page].LastUsed = m_Frame;
+			m_LRU.push_front(slot);
+			entry.LRU = m_LRU.begin();
+		}
+		m_Lookup[sizeIndex].Set(codepoint, slot);
+		WriteTableEntry(slot);
+		return slot;
+	}
+
+	bool GlyphCache::Allocate(PackedRect& rect, int& page)
+	{
+		if (rect.Width > m_Specification.PageSize || rect.Height > m_Specification.PageSize)
+			return false;
+
+		for (size_t i = 0; i < m_Pages.size(); i++)
+		{
+			if (m_Pages[i].Packer.Insert(rect)) {
+				page = (int)i;
+				return true;
+			}
+		}
+
+		if ((int)m_Pages.size() < m_Specification.MaxPages) {
+			page = AddPage();
+			return m_Pages[page].Packer.Insert(rect);
+		}
+
+		// all pages are in use: evict the least recently used glyphs until one of their pages has room
+		for (int evicted = 0; !m_LRU.empty() && evicted < MaxEvictionsPerMiss; evicted++)
+		{
+			uint32_t slot = m_LRU.back();
+			if (m_Entries[slot].LastUsed == m_Frame)
+				break;
+
+			int evictedPage = m_Entries[slot].Page;
+			Evict(slot);
+			if (m_Pages[evictedPage].Packer.Insert(rect)) {
+				page = evictedPage;
+				return true;
+			}
+		}
+
+		// freed rects aren't merged with their neighbours, so rebuild the free space from the survivors
+		for (int i = 0; i < (int)m_Pages.size(); i++)
+		{
+			RebuildFreeSpace(i);
+			if (m_Pages[i].Packer.Insert(rect)) {
+				page = i;
+				return true;
+			}
+		}
+
+		// still no room, start over on the least recently used page
+		int oldest = -1;
+		for (int i = 0; i < (int)m_Pages.size(); i++)
+			if (m_Pages[i].LastUsed != m_Frame && m_Pages[i].PinnedGlyphs == 0 && (oldest < 0 || m_Pages[i].LastUsed < m_Pages[oldest].LastUsed))
+				oldest = i;
+		if (oldest < 0)
+			return false;
+
+		ClearPage(oldest);
+		page = oldest;
+		return m_Pages[oldest].Packer.Insert(rect);
+	}
+
+	int GlyphCache::AddPage()
+	{
+		int page = (int)m_Pages.size();
+		int size = m_Specification.PageSize;
+
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		RenderState::BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, size, size, page + 1, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// GL 3.3 textures can't grow, so the existing layers are copied over through a read framebuffer
+		if (page > 0) {
+			unsigned int framebuffer;
+			glGenFramebuffers(1, &framebuffer);
+			RenderState::BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+			for (int layer = 0; layer < page; layer++)
+			{
+				glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_Texture, 0, layer);
+				glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 0, 0, size, size);
+			}
+			RenderState::DeleteFramebuffer(framebuffer);
+		}
+		RenderState::DeleteTexture(m_Texture);
+		m_Texture = texture;
+
+		m_Pages.push_back({ RectPacker(size, size, m_Specification.Packing), 0 });
+
+		// glyph padding relies on untouched texels being zero
+		m_Zeros.resize((size_t)size * size, 0);
+		UploadPixels(page, 0, 0, size, size, m_Zeros.data(), size);
+		return page;
+	}
+
+	void GlyphCache::Evict(uint32_t slot)
+	{
+		Entry& entry = m_Entries[slot];
+		// preloaded glyphs aren't packed one by one, so the packer has nothing to take back, but their
+		// space is freed by the next RebuildFreeSpace() all the same; either way clear the texels so
+		// they don't bleed into a later neighbour's padding
+		if (entry.Page >= 0) {
+			m_Pages[entry.Page].Packer.Remove(entry.Rect);
+			m_Zeros.resize(std::max(m_Zeros.size(), (size_t)entry.Rect.Width * entry.Rect.Height), 0);
+			UploadPixels(entry.Page, entry.Rect.X, entry.Rect.Y, entry.Rect.Width, entry.Rect.Height, m_Zeros.data(), entry.Rect.Width);
+		}
+
+		ReleaseSlot(slot);
+		m_Statistics.Evictions++;
+	}
+
+	void GlyphCache::ReleaseSlot(uint32_t slot)
+	{
+		Entry& entry = m_Entries[slot];
+		m_LRU.erase(entry.LRU);
+		m_Lookup[entry.SizeIndex].Remove(entry.Codepoint);
+		entry = Entry();
+		m_FreeSlots.push_back(slot);
+	}
+
+	void GlyphCache::ClearPage(int page)
+	{
+		for (auto it = m_LRU.begin(); it != m_LRU.end(); )
+		{
+			uint32_t slot = *it++;
+			if (m_Entries[slot].Page == page)
+				ReleaseSlot(slot);
+		}
+
+		int size = m_Specification.PageSize;
+		UploadPixels(page, 0, 0, size, size, m_Zeros.data(), size);
+		m_Pages[page].Packer.Clear();
+		m_Pages[page].LastUsed = 0;
+		m_Statistics.PageClears++;
+	}
+
+	void GlyphCache::RebuildFreeSpace(int page)
+	{
+		RectPacker& packer = m_Pages[page].Packer;
+		packer.Clear();
+		for (const std::list<uint32_t>* list : { &m_LRU, &m_Pinned })
+		{
+			for (uint32_t slot : *list)
+			{
+				Entry& entry = m_Entries[slot];
+				if (entry.Page != page)
+					continue;
+				// preloaded glyphs become individually packed here, the rest of their block is freed
+				entry.Rect.Packed = true;
+				packer.Occupy(entry.Rect);
+			}
+		}
+	}
+
+	void GlyphCache::Touch(Entry& entry)
+	{
+		if (entry.LastUsed == m_Frame)
+			return;
+
+		entry.LastUsed = m_Frame;
+		if (entry.Page >= 0) {
+			m_Pages[entry.Page].LastUsed = m_Frame;
+			if (entry.References == 0)
+				m_LRU.splice(m_LRU.begin(), m_LRU, entry.LRU);
+		}
+	}
+
+	void GlyphCache::Acquire(uint32_t slot)
+	{
+		Entry& entry = m_Entries[slot];
+		if (entry.References++ == 0 && entry.Page >= 0) {
+			m_Pinned.splice(m_Pinned.begin(), m_LRU, entry.LRU);
+			m_Pages[entry.Page].PinnedGlyphs++;
+		}
+	}
+
+	void GlyphCache::Release(uint32_t slot)
+	{
+		Entry& entry = m_Entries[slot];
+		if (--entry.References == 0 && entry.Page >= 0) {
+			m_LRU.splice(m_LRU.begin(), m_Pinned, entry.LRU);
+			m_Pages[entry.Page].PinnedGlyphs--;
+		}
+	}
+
+	uint32_t GlyphCache::AllocateSlot()
+	{
+		if (!m_FreeSlots.empty()) {
+			uint32_t slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+			return slot;
+		}
+
+		m_Entries.emplace_back();
+		m_Metrics.Resize(m_Entries.size());
+		m_Table.resize(m_Entries.size() * TexelsPerSlot, glm::vec4(0.0f));
+		return (uint32_t)m_Entries.size() - 1;
+	}
+
+	void GlyphCache::WriteTableEntry(uint32_t slot)
+	{
+		const Entry& entry = m_Entries[slot];
+		glm::vec2 texelSize = glm::vec2(1.0f / m_Specification.PageSize);
+		glm::vec2 uv0 = glm::vec2(entry.Rect.X, entry.Rect.Y) * texelSize;
+		glm::vec2 uv1 = glm::vec2(glm::ivec2(entry.Rect.X, entry.Rect.Y) + m_Metrics.Sizes[slot]) * texelSize;
+		m_Metrics.UVRects[slot] = glm::vec4(uv0, uv1);
+
+		m_Table[slot * TexelsPerSlot + 0] = glm::vec4(m_Metrics.Sizes[slot], m_Metrics.Bearings[slot]);
+		m_Table[slot * TexelsPerSlot + 1] = m_Metrics.UVRects[slot];
+		m_Table[slot * TexelsPerSlot + 2] = glm::vec4((float)std::max(entry.Page, 0), 0.0f, 0.0f, 0.0f);
+
+		m_DirtyBegin = std::min(m_DirtyBegin, slot);
+		m_DirtyEnd = std::max(m_DirtyEnd, slot + 1);
+	}
+
+	void GlyphCache::UploadPixels(int page, int x, int y, int width, int height, const unsigned char* pixels, int pitch)
+	{
+		RenderState::BindTexture(0, GL_TEXTURE_2D_ARRAY, m_Texture);
+		// disable byte-alignment restriction, FreeType may pad its rows
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, page, width, height, 1, GL_RED, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+}
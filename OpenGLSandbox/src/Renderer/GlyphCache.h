@@ -0,0 +1,131 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Utilities/RectPacker.h"
+#include "Utilities/GlyphLookupTable.h"
+#include "Utilities/BitmapFontAtlas.h"
+
+typedef struct FT_FaceRec_* FT_Face;
+
+namespace OpenGLSandbox {
+
+	struct GlyphCacheSpecification
+	{
+		std::string FontFilepath;
+		std::vector<unsigned int> PixelSizes = { 24, 48 };	// text snaps to one of these sizes
+		int PageSize = 1024;
+		int MaxPages = 4;
+		RectPackerSpecification Packing;	// always MaxRects, evicted glyphs hand their rect back
+	};
+
+	// Rasterizes glyphs with FreeType the first time a codepoint is drawn and keeps them in the
+	// layers of one R8 texture array, so glyphs on different pages still batch into one draw.
+	// Pages are added on demand up to MaxPages; after that the least recently used glyphs are
+	// evicted. If the freed space is too fragmented, free space is rebuilt around the surviving
+	// glyphs, and only if that fails too the least recently used page is cleared.
+	// Glyphs used since the last BeginFrame() and glyphs pinned with Acquire() are never evicted.
+	// The font is only opened by the first glyph that has to be rasterized.
+	class GlyphCache
+	{
+	public:
+		static constexpr uint32_t InvalidSlot = GlyphLookupTable::InvalidIndex;
+
+		struct Statistics
+		{
+			uint32_t Hits = 0;
+			uint32_t Misses = 0;
+			uint32_t Evictions = 0;
+			uint32_t PageClears = 0;
+		};
+
+	public:
+		GlyphCache(const GlyphCacheSpecification& specification);
+		~GlyphCache();
+
+		// Seeds the cache with glyphs that were rasterized ahead of time. Glyphs whose pixel size is
+		// not in the specification are ignored.
+		void Preload(const BitmapGlyph* glyphs, uint32_t count, const unsigned char* pixels, int width, int height);
+
+		void BeginFrame();
+		// Index of the smallest configured size at or above the requested one.
+		size_t FindPixelSize(float pixelSize) const;
+		// Slot of the glyph, which indexes the metrics and the glyph table texture. Returns InvalidSlot
+		// only if the glyph can't be placed without evicting glyphs of this frame.
+		uint32_t Get(uint32_t codepoint, size_t sizeIndex);
+		// Pins a slot so it stays valid across frames, for text whose instances are kept on the GPU.
+		void Acquire(uint32_t slot);
+		void Release(uint32_t slot);
+		// Uploads glyph table changes; call before drawing with the table.
+		void Flush();
+
+		inline const GlyphMetrics& GetMetrics() const { return m_Metrics; }
+		inline const std::vector<unsigned int>& GetPixelSizes() const { return m_PixelSizes; }
+		inline unsigned int GetTextureID() const { return m_Texture; }
+		inline unsigned int GetGlyphTableTextureID() const { return m_GlyphTableTexture; }
+		inline int GetPageCount() const { return (int)m_Pages.size(); }
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		struct Entry
+		{
+			uint32_t Codepoint = 0;
+			uint32_t SizeIndex = 0;
+			int Page = -1;			// -1 for glyphs without pixels, those are never evicted
+			PackedRect Rect;
+			uint64_t LastUsed = 0;
+			uint32_t References = 0;			// pinned entries live in m_Pinned instead of m_LRU
+			std::list<uint32_t>::iterator LRU;
+		};
+
+		struct Page
+		{
+			RectPacker Packer;
+			uint64_t LastUsed = 0;
+			uint32_t PinnedGlyphs = 0;
+		};
+
+		uint32_t Rasterize(uint32_t codepoint, size_t sizeIndex);
+		bool Allocate(PackedRect& rect, int& page);
+		int AddPage();
+		void Evict(uint32_t slot);
+		void ReleaseSlot(uint32_t slot);
+		void ClearPage(int page);
+		void RebuildFreeSpace(int page);
+		void Touch(Entry& entry);
+		uint32_t AllocateSlot();
+		void WriteTableEntry(uint32_t slot);
+		void UploadPixels(int page, int x, int y, int width, int height, const unsigned char* pixels, int pitch);
+
+	private:
+		GlyphCacheSpecification m_Specification;
+		std::vector<unsigned int> m_PixelSizes;	// ascending
+
+		FT_Face m_Face = nullptr;
+		bool m_FaceOpened = false;		// nullptr after that means the font failed to open
+		unsigned int m_FacePixelSize = 0;
+
+		unsigned int m_Texture = 0;
+		std::vector<Page> m_Pages;
+
+		std::vector<GlyphLookupTable> m_Lookup;	// one per pixel size
+		GlyphMetrics m_Metrics;					// indexed by slot
+		std::vector<Entry> m_Entries;			// indexed by slot
+		std::vector<uint32_t> m_FreeSlots;
+		std::list<uint32_t> m_LRU;		// front is the most recently used
+		std::list<uint32_t> m_Pinned;
+
+		// three texels per slot: (size, bearing), uv rect, (layer, 0, 0, 0)
+		std::vector<glm::vec4> m_Table;
+		size_t m_TableCapacity = 0;
+		uint32_t m_DirtyBegin = UINT32_MAX, m_DirtyEnd = 0;
+		unsigned int m_GlyphTableBuffer = 0;
+		unsigned int m_GlyphTableTexture = 0;
+
+		uint64_t m_Frame = 1;
+		std::vector<unsigned char> m_Zeros;
+		Statistics m_Statistics;
+	};
+}
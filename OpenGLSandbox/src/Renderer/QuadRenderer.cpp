@@ -0,0 +1,212 @@
+#include "QuadRenderer.h"
+#include "RenderState.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		// batches allocate in steps of this many quads, which keeps every array 16 byte aligned
+		static constexpr uint32_t CapacityGranularity = 1024;
+
+		static_assert(sizeof(QuadTransform) == 6 * sizeof(float), "the shader reads two tightly packed vec3");
+	}
+
+	static constexpr uint64_t TexturesUniform = Hash::FNV1a("u_Textures");
+
+	QuadRenderer::QuadRenderer(Shader& shader, StreamBuffer& streamBuffer)
+		: m_Shader(shader), m_StreamBuffer(streamBuffer)
+	{
+		// counter-clockwise in pixel space, where y points up
+		const float corners[] = { 0.0f, 0.0f,  1.0f, 0.0f,  1.0f, 1.0f,  0.0f, 1.0f };
+		const uint32_t indices[] = { 0, 1, 2,  0, 2, 3 };
+
+		glGenBuffers(1, &m_QuadBuffer);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, m_QuadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		// the element buffer is bound per vertex array, see AcquireVertexArray()
+		glGenBuffers(1, &m_IndexBuffer);
+		RenderState::BindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	}
+
+	QuadRenderer::~QuadRenderer()
+	{
+		for (unsigned int vertexArray : m_VertexArrays)
+			RenderState::DeleteVertexArray(vertexArray);
+		RenderState::DeleteBuffer(m_IndexBuffer);
+		RenderState::DeleteBuffer(m_QuadBuffer);
+	}
+
+	void QuadRenderer::Begin(RenderQueue::CommandBuffer& commands, RenderLayer layer)
+	{
+		m_Commands = &commands;
+		m_Layer = layer;
+		m_VertexArraysUsed = 0;
+		m_OutOfSpace = false;
+		m_Statistics = Statistics();
+	}
+
+	void QuadRenderer::DrawQuadSlow(const QuadTransform& transform, unsigned int textureArray, float layer, const glm::vec4& uvRect, uint32_t color)
+	{
+		Batch& batch = m_LastBatch && m_LastBatch->TextureArray == textureArray ? *m_LastBatch : GetBatch(textureArray);
+		if (!batch.Transforms && !Allocate(batch)) {
+			m_Statistics.DroppedQuads++;
+			return;
+		}
+
+		uint32_t index = batch.Count++;
+		batch.Transforms[index] = transform;
+		batch.UVRects[index] = uvRect;
+		batch.Colors[index] = color;
+		batch.Layers[index] = layer;
+		if (batch.Count == batch.Capacity)
+			Flush(batch);
+	}
+
+	void QuadRenderer::DrawQuad(const glm::vec2& position, const glm::vec2& size, float rotation, unsigned int textureArray, float layer, const glm::vec4& color)
+	{
+		DrawQuad(MakeTransform(position, size, rotation), textureArray, layer, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), PackColor(color));
+	}
+
+	void QuadRenderer::End()
+	{
+		for (Batch& batch : m_Batches)
+		{
+			Flush(batch);
+			batch.LastFrameQuads = batch.FrameQuads;
+			batch.FrameQuads = 0;
+		}
+		m_Commands = nullptr;
+	}
+
+	QuadTransform QuadRenderer::MakeTransform(const glm::vec2& position, const glm::vec2& size, float rotation)
+	{
+		float c = std::cos(rotation), s = std::sin(rotation);
+		glm::vec2 axisX = glm::vec2(c, s) * size.x;
+		glm::vec2 axisY = glm::vec2(-s, c) * size.y;
+		glm::vec2 origin = position - 0.5f * (axisX + axisY);
+
+		QuadTransform transform;
+		transform.X = glm::vec3(axisX.x, axisY.x, origin.x);
+		transform.Y = glm::vec3(axisX.y, axisY.y, origin.y);
+		return transform;
+	}
+
+	uint32_t QuadRenderer::PackColor(const glm::vec4& color)
+	{
+		glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+		return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+	}
+
+	QuadRenderer::Batch& QuadRenderer::GetBatch(unsigned int textureArray)
+	{
+		for (Batch& batch : m_Batches)
+		{
+			if (batch.TextureArray == textureArray) {
+				m_LastBatch = &batch;
+				return batch;
+			}
+		}
+
+		// moves the batches, which only ever happens here
+		Batch& batch = m_Batches.emplace_back();
+		batch.TextureArray = textureArray;
+		m_LastBatch = &batch;
+		return batch;
+	}
+
+	bool QuadRenderer::Allocate(Batch& batch)
+	{
+		if (!m_Commands || m_OutOfSpace)
+			return false;
+
+		// room for the quads the batch is expected to draw for the rest of the frame
+		uint32_t expected = batch.LastFrameQuads > batch.FrameQuads ? batch.LastFrameQuads - batch.FrameQuads : 0;
+		uint32_t capacity = (expected + Utils::CapacityGranularity - 1) / Utils::CapacityGranularity * Utils::CapacityGranularity;
+		capacity = std::clamp(capacity, Utils::CapacityGranularity, MaxQuadsPerBatch);
+
+		// the stream buffer grows for the next frame, until then the rest of the quads are dropped
+		StreamAllocation allocation = m_StreamBuffer.Allocate(capacity * InstanceSize);
+		if (!allocation.IsValid()) {
+			m_OutOfSpace = true;
+			return false;
+		}
+
+		size_t transforms = allocation.Offset;
+		size_t uvRects = transforms + capacity * sizeof(QuadTransform);
+		size_t colors = uvRects + capacity * sizeof(glm::vec4);
+		size_t layers = colors + capacity * sizeof(uint32_t);
+
+		batch.VertexArray = AcquireVertexArray();
+		RenderState::BindVertexArray(batch.VertexArray);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, allocation.Buffer);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(QuadTransform), (void*)(transforms + offsetof(QuadTransform, X)));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(QuadTransform), (void*)(transforms + offsetof(QuadTransform, Y)));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)uvRects);
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(uint32_t), (void*)colors);
+		glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)layers);
+
+		uint8_t* data = (uint8_t*)allocation.Data;
+		batch.Capacity = capacity;
+		batch.Transforms = (QuadTransform*)data;
+		batch.UVRects = (glm::vec4*)(data + (uvRects - transforms));
+		batch.Colors = (uint32_t*)(data + (colors - transforms));
+		batch.Layers = (float*)(data + (layers - transforms));
+		return true;
+	}
+
+	void QuadRenderer::Flush(Batch& batch)
+	{
+		if (!batch.Transforms)
+			return;
+		batch.Transforms = nullptr;
+		batch.UVRects = nullptr;
+		batch.Colors = nullptr;
+		batch.Layers = nullptr;
+		if (!batch.Count)
+			return;
+
+		DrawCommand command;
+		command.Program = &m_Shader;
+		command.VertexArray = batch.VertexArray;
+		command.Textures[0] = { GL_TEXTURE_2D_ARRAY, batch.TextureArray };
+		command.Indexed = true;
+		command.Count = 6;
+		command.InstanceCount = batch.Count;
+		m_Commands->Draw(RenderQueue::MakeKey(m_Layer, command), command);
+		m_Commands->SetUniform1i(TexturesUniform, 0);
+
+		m_Statistics.Quads += batch.Count;
+		m_Statistics.DrawCalls++;
+		m_Statistics.BytesUploaded += batch.Count * InstanceSize;
+		batch.FrameQuads += batch.Count;
+		batch.Count = 0;
+	}
+
+	unsigned int QuadRenderer::AcquireVertexArray()
+	{
+		if (m_VertexArraysUsed < m_VertexArrays.size())
+			return m_VertexArrays[m_VertexArraysUsed++];
+
+		// the instance attributes are pointed at each allocation, see Allocate()
+		unsigned int vertexArray;
+		glGenVertexArrays(1, &vertexArray);
+		RenderState::BindVertexArray(vertexArray);
+		RenderState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, m_QuadBuffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		for (unsigned int attribute = 1; attribute <= 5; attribute++)
+		{
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1);
+		}
+
+		m_VertexArrays.push_back(vertexArray);
+		m_VertexArraysUsed++;
+		return vertexArray;
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Utilities/Shader.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+namespace OpenGLSandbox {
+
+	// Maps the unit quad to pixels: x' = X.x * u + X.y * v + X.z, y' = Y.x * u + Y.y * v + Y.z
+	struct QuadTransform
+	{
+		glm::vec3 X = glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 Y = glm::vec3(0.0f, 1.0f, 0.0f);
+	};
+
+	// Draws textured, colored and transformed quads as instances of one static unit quad. Every
+	// texture array gets its own batch, which allocates its instances from the stream buffer laid out
+	// as one array per attribute; a quad only writes its attributes into the allocation, and a batch
+	// that fills up is recorded as a single instanced draw. End() flushes whatever is left, so batches
+	// of different texture arrays don't keep the order their quads were drawn in. A batch allocates
+	// room for as many quads as it drew the frame before, up to MaxQuadsPerBatch.
+	//
+	// Each flush within a frame reads its instances through its own vertex array, so the draws
+	// recorded earlier in the frame still read their data when the queue is submitted. GL thread only.
+	class QuadRenderer
+	{
+	public:
+		static constexpr uint32_t MaxQuadsPerBatch = 16384;
+		// stream buffer bytes per quad
+		static constexpr size_t InstanceSize = sizeof(QuadTransform) + sizeof(glm::vec4) + sizeof(uint32_t) + sizeof(float);
+
+		struct Statistics
+		{
+			uint32_t Quads = 0;
+			uint32_t DrawCalls = 0;
+			uint64_t BytesUploaded = 0;
+			uint32_t DroppedQuads = 0;	// the stream buffer was full
+		};
+
+	public:
+		// The shader reads its projection from the Frame uniform block. The stream buffer's frame
+		// has to be begun before Begin() and ended after End().
+		QuadRenderer(Shader& shader, StreamBuffer& streamBuffer);
+		~QuadRenderer();
+
+		QuadRenderer(const QuadRenderer&) = delete;
+		QuadRenderer& operator=(const QuadRenderer&) = delete;
+
+		void Begin(RenderQueue::CommandBuffer& commands, RenderLayer layer = RenderLayer::Overlay);
+		// uvRect is <u0, v0, u1, v1>, color is RGBA8 with red in the low byte
+		inline void DrawQuad(const QuadTransform& transform, unsigned int textureArray, float layer, const glm::vec4& uvRect, uint32_t color)
+		{
+			// consecutive quads nearly always share their texture and fit into its allocation
+			Batch* batch = m_LastBatch;
+			if (!batch || batch->TextureArray != textureArray || !batch->Transforms || batch->Count + 1 >= batch->Capacity) {
+				DrawQuadSlow(transform, textureArray, layer, uvRect, color);
+				return;
+			}
+
+			uint32_t index = batch->Count++;
+			batch->Transforms[index] = transform;
+			batch->UVRects[index] = uvRect;
+			batch->Colors[index] = color;
+			batch->Layers[index] = layer;
+		}
+		void DrawQuad(const glm::vec2& position, const glm::vec2& size, float rotation, unsigned int textureArray, float layer, const glm::vec4& color);
+		void End();
+
+		// rotation in radians around the quad's center
+		static QuadTransform MakeTransform(const glm::vec2& position, const glm::vec2& size, float rotation);
+		static uint32_t PackColor(const glm::vec4& color);
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		// the arrays point into the batch's stream buffer allocation
+		struct Batch
+		{
+			unsigned int TextureArray = 0;
+			uint32_t Count = 0;
+			uint32_t Capacity = 0;
+			unsigned int VertexArray = 0;
+			QuadTransform* Transforms = nullptr;
+			glm::vec4* UVRects = nullptr;
+			uint32_t* Colors = nullptr;
+			float* Layers = nullptr;
+
+			uint32_t FrameQuads = 0, LastFrameQuads = 0;
+		};
+
+		void DrawQuadSlow(const QuadTransform& transform, unsigned int textureArray, float layer, const glm::vec4& uvRect, uint32_t color);
+		Batch& GetBatch(unsigned int textureArray);
+		// allocates the instances and points the next free vertex array at them
+		bool Allocate(Batch& batch);
+		void Flush(Batch& batch);
+		unsigned int AcquireVertexArray();
+
+	private:
+		Shader& m_Shader;
+		StreamBuffer& m_StreamBuffer;
+		unsigned int m_QuadBuffer = 0;	// the unit quad's corners
+		unsigned int m_IndexBuffer = 0;
+
+		std::vector<Batch> m_Batches;	// one per texture array seen, kept across frames
+		Batch* m_LastBatch = nullptr;	// the last quad's, into m_Batches
+		std::vector<unsigned int> m_VertexArrays;
+		uint32_t m_VertexArraysUsed = 0;	// this frame
+
+		RenderQueue::CommandBuffer* m_Commands = nullptr;
+		RenderLayer m_Layer = RenderLayer::Overlay;
+		bool m_OutOfSpace = false;	// this frame
+		Statistics m_Statistics;
+	};
+}
@@ -0,0 +1,464 @@
+#include "RenderGraph.h"
+#include "GPUProfiler.h"
+#include "RenderState.h"
+#include <glad/glad.h>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static bool IsDepthFormat(GLenum format)
+		{
+			return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8
+				|| format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+		}
+
+		static bool HasStencil(GLenum format)
+		{
+			return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+		}
+
+		// the upload format of an empty texture, only needed because glTexImage2D insists on one
+		static void GetPixelFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+		{
+			switch (internalFormat)
+			{
+			case GL_DEPTH24_STENCIL8:    format = GL_DEPTH_STENCIL;   type = GL_UNSIGNED_INT_24_8; break;
+			case GL_DEPTH32F_STENCIL8:   format = GL_DEPTH_STENCIL;   type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; break;
+			case GL_DEPTH_COMPONENT24:   format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; break;
+			case GL_DEPTH_COMPONENT32F:  format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+			case GL_R8:                  format = GL_RED;             type = GL_UNSIGNED_BYTE; break;
+			case GL_RGBA16F:             format = GL_RGBA;            type = GL_HALF_FLOAT; break;
+			case GL_RGBA32F:             format = GL_RGBA;            type = GL_FLOAT; break;
+			default:                     format = GL_RGBA;            type = GL_UNSIGNED_BYTE; break;
+			}
+		}
+
+		static uint32_t GetBytesPerPixel(GLenum internalFormat)
+		{
+			switch (internalFormat)
+			{
+			case GL_R8:                return 1;
+			case GL_RGBA16F:           return 8;
+			case GL_DEPTH32F_STENCIL8: return 8;
+			case GL_RGBA32F:           return 16;
+			default:                   return 4;
+			}
+		}
+	}
+
+	//////////////////////////////////////////// PassBuilder ////////////////////////////////////////////
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(RenderResource resource)
+	{
+		m_Graph.m_Passes[m_Pass].Reads.push_back(resource);
+		m_Graph.m_Compiled = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(RenderResource resource, AttachmentLoad load, const glm::vec4& clearColor)
+	{
+		m_Graph.m_Passes[m_Pass].Writes.push_back({ resource, load, clearColor, 1.0f, 0 });
+		m_Graph.m_Compiled = false;
+		return *this;
+	}
+
+	RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(RenderResource resource, AttachmentLoad load, float clearDepth, int clearStencil)
+	{
+		m_Graph.m_Passes[m_Pass].Writes.push_back({ resource, load, glm::vec4(0.0f), clearDepth, clearStencil });
+		m_Graph.m_Compiled = false;
+		return *this;
+	}
+
+	//////////////////////////////////////////// RenderGraph ////////////////////////////////////////////
+
+	RenderGraph::RenderGraph(uint32_t width, uint32_t height)
+		: m_Width(std::max(1u, width)), m_Height(std::max(1u, height))
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		ReleaseFramebuffers();
+		for (PhysicalTexture& texture : m_Pool)
+		{
+			if (texture.Texture)
+				RenderState::DeleteTexture(texture.Texture);
+		}
+	}
+
+	RenderResource RenderGraph::CreateTexture(const std::string& name, const RenderTextureDescription& description)
+	{
+		Resource resource;
+		resource.Name = name;
+		resource.Description = description;
+		m_Resources.push_back(resource);
+		m_Compiled = false;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	RenderResource RenderGraph::ImportFramebuffer(const std::string& name, unsigned int framebuffer)
+	{
+		Resource resource;
+		resource.Name = name;
+		resource.Imported = true;
+		resource.Framebuffer = framebuffer;
+		m_Resources.push_back(resource);
+		m_Compiled = false;
+		return (RenderResource)m_Resources.size() - 1;
+	}
+
+	RenderGraph::PassBuilder RenderGraph::AddPass(const std::string& name, ExecuteFunction execute)
+	{
+		Pass pass;
+		pass.Name = name;
+		pass.Execute = std::move(execute);
+		pass.Zone = Profiler::RegisterZone(("GPU " + name).c_str());
+		m_Passes.push_back(std::move(pass));
+		m_Compiled = false;
+		return PassBuilder(*this, (uint32_t)m_Passes.size() - 1);
+	}
+
+	bool RenderGraph::Compile()
+	{
+		ReleaseFramebuffers();
+		m_Statistics = Statistics();
+		m_Statistics.Passes = (uint32_t)m_Passes.size();
+
+		// a resource is needed while something reads it; imported framebuffers are always needed
+		for (Resource& resource : m_Resources)
+		{
+			resource.RefCount = resource.Imported ? 1 : 0;
+			resource.FirstUse = UINT32_MAX;
+			resource.LastUse = 0;
+			resource.Physical = UINT32_MAX;
+		}
+		for (Pass& pass : m_Passes)
+		{
+			pass.Culled = false;
+			pass.RefCount = (uint32_t)pass.Writes.size();
+			for (RenderResource read : pass.Reads)
+				m_Resources[read].RefCount++;
+		}
+
+		// a pass is needed while one of its outputs is; culling one releases what it reads
+		std::vector<RenderResource> unused;
+		for (RenderResource i = 0; i < m_Resources.size(); i++)
+		{
+			if (m_Resources[i].RefCount == 0)
+				unused.push_back(i);
+		}
+		for (Pass& pass : m_Passes)
+			pass.Culled = pass.RefCount == 0;
+		while (!unused.empty())
+		{
+			RenderResource resource = unused.back();
+			unused.pop_back();
+			for (Pass& pass : m_Passes)
+			{
+				bool writes = std::any_of(pass.Writes.begin(), pass.Writes.end(), [&](const Attachment& attachment) { return attachment.Resource == resource; });
+				if (pass.Culled || !writes || --pass.RefCount > 0)
+					continue;
+				pass.Culled = true;
+				for (RenderResource read : pass.Reads)
+				{
+					if (--m_Resources[read].RefCount == 0)
+						unused.push_back(read);
+				}
+			}
+		}
+
+		// lifetimes over the remaining passes
+		auto use = [this](RenderResource resource, uint32_t index)
+		{
+			Resource& r = m_Resources[resource];
+			r.FirstUse = std::min(r.FirstUse, index);
+			r.LastUse = std::max(r.LastUse, index);
+		};
+		for (uint32_t i = 0; i < m_Passes.size(); i++)
+		{
+			const Pass& pass = m_Passes[i];
+			if (pass.Culled) {
+				m_Statistics.CulledPasses++;
+				continue;
+			}
+			for (RenderResource read : pass.Reads)
+				use(read, i);
+			for (const Attachment& write : pass.Writes)
+				use(write.Resource, i);
+		}
+
+		// a texture goes back to the pool after its last pass, and the next texture of the same format
+		// and size to start takes it over
+		std::vector<bool> inUse(m_Pool.size(), false);
+		for (uint32_t i = 0; i < m_Passes.size(); i++)
+		{
+			if (m_Passes[i].Culled)
+				continue;
+			for (Resource& resource : m_Resources)
+			{
+				if (!resource.Imported && resource.FirstUse == i) {
+					resource.Physical = AcquirePhysical(resource.Description, inUse);
+					m_Statistics.Textures++;
+				}
+			}
+			for (Resource& resource : m_Resources)
+			{
+				if (!resource.Imported && resource.LastUse == i && resource.Physical != UINT32_MAX)
+					inUse[resource.Physical] = false;
+			}
+		}
+
+		// textures no pass uses anymore are freed, their slots are reused by the next compile
+		std::vector<bool> assigned(m_Pool.size(), false);
+		for (const Resource& resource : m_Resources)
+		{
+			if (resource.Physical != UINT32_MAX)
+				assigned[resource.Physical] = true;
+		}
+		for (uint32_t i = 0; i < m_Pool.size(); i++)
+		{
+			PhysicalTexture& texture = m_Pool[i];
+			if (!assigned[i] && texture.Texture) {
+				RenderState::DeleteTexture(texture.Texture);
+				texture.Texture = 0;
+			}
+			if (assigned[i]) {
+				m_Statistics.PhysicalTextures++;
+				m_Statistics.Bytes += (uint64_t)texture.Width * texture.Height * Utils::GetBytesPerPixel(texture.Description.Format);
+			}
+		}
+
+		bool complete = true;
+		for (Pass& pass : m_Passes)
+		{
+			if (!pass.Culled)
+				complete &= CreateFramebuffer(pass);
+		}
+
+		m_Compiled = true;
+		return complete;
+	}
+
+	void RenderGraph::Execute()
+	{
+		if (!m_Compiled)
+			Compile();
+
+		for (const Pass& pass : m_Passes)
+		{
+			if (pass.Culled)
+				continue;
+#if OGS_PROFILE
+			if (m_GPUProfiler)
+				m_GPUProfiler->Begin(pass.Zone);
+#endif
+
+			RenderState::BindFramebuffer(GL_FRAMEBUFFER, pass.Framebuffer);
+			glm::uvec2 size = GetPassSize(pass);
+			RenderState::Viewport(0, 0, size.x, size.y);
+
+			// cleared per attachment, so one pass's clear values never leak into another's
+			GLint colorIndex = 0;
+			for (const Attachment& write : pass.Writes)
+			{
+				const Resource& resource = m_Resources[write.Resource];
+				bool depth = !resource.Imported && Utils::IsDepthFormat(resource.Description.Format);
+				if (write.Load == AttachmentLoad::Clear) {
+					if (resource.Imported) {
+						glClearBufferfv(GL_COLOR, 0, &write.ClearColor.x);
+						glClearBufferfi(GL_DEPTH_STENCIL, 0, write.ClearDepth, write.ClearStencil);
+					}
+					else if (depth && Utils::HasStencil(resource.Description.Format))
+						glClearBufferfi(GL_DEPTH_STENCIL, 0, write.ClearDepth, write.ClearStencil);
+					else if (depth)
+						glClearBufferfv(GL_DEPTH, 0, &write.ClearDepth);
+					else
+						glClearBufferfv(GL_COLOR, colorIndex, &write.ClearColor.x);
+				}
+				if (!depth)
+					colorIndex++;
+			}
+
+			pass.Execute(*this);
+
+#if OGS_PROFILE
+			if (m_GPUProfiler)
+				m_GPUProfiler->End();
+#endif
+		}
+	}
+
+	void RenderGraph::Resize(uint32_t width, uint32_t height)
+	{
+		// a minimized window reports 0x0, keep the last size until it comes back
+		if (width == 0 || height == 0 || (width == m_Width && height == m_Height))
+			return;
+
+		m_Width = width;
+		m_Height = height;
+		// the framebuffers keep their attachments, only the textures' storage changes
+		for (PhysicalTexture& texture : m_Pool)
+		{
+			bool followsGraph = texture.Description.Width == 0 || texture.Description.Height == 0;
+			if (texture.Texture && followsGraph)
+				AllocateStorage(texture);
+		}
+
+		m_Statistics.Bytes = 0;
+		for (const PhysicalTexture& texture : m_Pool)
+		{
+			if (texture.Texture)
+				m_Statistics.Bytes += (uint64_t)texture.Width * texture.Height * Utils::GetBytesPerPixel(texture.Description.Format);
+		}
+	}
+
+	unsigned int RenderGraph::GetTexture(RenderResource resource) const
+	{
+		const Resource& r = m_Resources[resource];
+		return r.Physical != UINT32_MAX ? m_Pool[r.Physical].Texture : 0;
+	}
+
+	void RenderGraph::PrintReport(std::ostream& out) const
+	{
+		std::streamsize precision = out.precision();
+		out << "Render graph: " << m_Statistics.Passes << " passes, " << m_Statistics.CulledPasses << " culled, "
+			<< m_Statistics.Textures << " textures in " << m_Statistics.PhysicalTextures << " allocations, "
+			<< std::fixed << std::setprecision(2) << m_Statistics.Bytes / (1024.0 * 1024.0) << std::defaultfloat << std::setprecision(precision) << " MB" << std::endl;
+		for (const Pass& pass : m_Passes)
+		{
+			out << "  " << pass.Name << (pass.Culled ? " (culled)" : "") << ":";
+			for (RenderResource read : pass.Reads)
+				out << " reads " << m_Resources[read].Name;
+			for (const Attachment& write : pass.Writes)
+			{
+				const Resource& resource = m_Resources[write.Resource];
+				out << " writes " << resource.Name;
+				if (resource.Physical != UINT32_MAX)
+					out << " [" << resource.Physical << "]";
+			}
+			out << std::endl;
+		}
+	}
+
+	glm::uvec2 RenderGraph::GetSize(const RenderTextureDescription& description) const
+	{
+		if (description.Width == 0 || description.Height == 0)
+			return glm::uvec2(m_Width, m_Height);
+		return glm::uvec2(description.Width, description.Height);
+	}
+
+	glm::uvec2 RenderGraph::GetPassSize(const Pass& pass) const
+	{
+		if (pass.Writes.empty() || m_Resources[pass.Writes[0].Resource].Imported)
+			return glm::uvec2(m_Width, m_Height);
+		return GetSize(m_Resources[pass.Writes[0].Resource].Description);
+	}
+
+	uint32_t RenderGraph::AcquirePhysical(const RenderTextureDescription& description, std::vector<bool>& inUse)
+	{
+		uint32_t freeSlot = UINT32_MAX;
+		for (uint32_t i = 0; i < m_Pool.size(); i++)
+		{
+			const PhysicalTexture& texture = m_Pool[i];
+			if (inUse[i])
+				continue;
+			if (texture.Texture && texture.Description.Format == description.Format
+				&& texture.Description.Width == description.Width && texture.Description.Height == description.Height) {
+				inUse[i] = true;
+				return i;
+			}
+			if (!texture.Texture && freeSlot == UINT32_MAX)
+				freeSlot = i;
+		}
+
+		if (freeSlot == UINT32_MAX) {
+			freeSlot = (uint32_t)m_Pool.size();
+			m_Pool.emplace_back();
+			inUse.push_back(false);
+		}
+		PhysicalTexture& texture = m_Pool[freeSlot];
+		texture.Description = description;
+		AllocateStorage(texture);
+		inUse[freeSlot] = true;
+		return freeSlot;
+	}
+
+	void RenderGraph::AllocateStorage(PhysicalTexture& texture)
+	{
+		if (!texture.Texture)
+			glGenTextures(1, &texture.Texture);
+
+		glm::uvec2 size = GetSize(texture.Description);
+		texture.Width = size.x;
+		texture.Height = size.y;
+
+		GLenum format, type;
+		Utils::GetPixelFormat(texture.Description.Format, format, type);
+		RenderState::BindTexture(0, GL_TEXTURE_2D, texture.Texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, texture.Description.Format, size.x, size.y, 0, format, type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	bool RenderGraph::CreateFramebuffer(Pass& pass)
+	{
+		for (const Attachment& write : pass.Writes)
+		{
+			const Resource& resource = m_Resources[write.Resource];
+			if (!resource.Imported)
+				continue;
+			if (pass.Writes.size() > 1)
+				std::cout << "RenderGraph: pass " << pass.Name << " writes " << resource.Name << " and other attachments, only " << resource.Name << " is bound" << std::endl;
+			pass.Framebuffer = resource.Framebuffer;
+			pass.OwnsFramebuffer = false;
+			return true;
+		}
+
+		glGenFramebuffers(1, &pass.Framebuffer);
+		RenderState::BindFramebuffer(GL_FRAMEBUFFER, pass.Framebuffer);
+		pass.OwnsFramebuffer = true;
+
+		std::vector<GLenum> drawBuffers;
+		for (const Attachment& write : pass.Writes)
+		{
+			const Resource& resource = m_Resources[write.Resource];
+			GLuint texture = m_Pool[resource.Physical].Texture;
+			if (Utils::IsDepthFormat(resource.Description.Format)) {
+				GLenum attachment = Utils::HasStencil(resource.Description.Format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+			}
+			else {
+				GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+				drawBuffers.push_back(attachment);
+			}
+		}
+		if (drawBuffers.empty())
+			glDrawBuffer(GL_NONE);
+		else
+			glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "RenderGraph: framebuffer of pass " << pass.Name << " is incomplete" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void RenderGraph::ReleaseFramebuffers()
+	{
+		for (Pass& pass : m_Passes)
+		{
+			if (pass.OwnsFramebuffer)
+				RenderState::DeleteFramebuffer(pass.Framebuffer);
+			pass.Framebuffer = 0;
+			pass.OwnsFramebuffer = false;
+		}
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Utilities/Profiler.h"
+
+namespace OpenGLSandbox {
+
+	class GPUProfiler;
+
+	using RenderResource = uint32_t;
+	static constexpr RenderResource InvalidRenderResource = UINT32_MAX;
+
+	enum class AttachmentLoad
+	{
+		Load,		// keep what the texture holds
+		Clear,
+		DontCare	// the pass overwrites every pixel
+	};
+
+	struct RenderTextureDescription
+	{
+		unsigned int Format = 0x8058;	// GL_RGBA8; GL_DEPTH24_STENCIL8 makes a depth-stencil attachment
+		// 0 follows the graph's size, so the texture is resized with the window
+		uint32_t Width = 0, Height = 0;
+	};
+
+	// Describes a frame as passes that read and write named textures, and runs them in declaration
+	// order. Compile() works out which passes matter, starting from the passes that write an imported
+	// framebuffer and following their reads back; every other pass is culled and never allocates
+	// anything. Transient textures live from their first to their last use, and textures of the same
+	// format and size whose lifetimes don't overlap share one GL texture from the pool. Every pass
+	// gets a framebuffer with its attachments, and its clears are issued per attachment.
+	//
+	// Resize() reallocates only the textures that follow the graph's size; the compiled passes,
+	// their framebuffers and fixed size textures stay as they are.
+	class RenderGraph
+	{
+	public:
+		using ExecuteFunction = std::function<void(const RenderGraph&)>;
+
+		class PassBuilder
+		{
+		public:
+			PassBuilder& Read(RenderResource resource);
+			PassBuilder& Write(RenderResource resource, AttachmentLoad load = AttachmentLoad::Load, const glm::vec4& clearColor = glm::vec4(0.0f));
+			// for depth-stencil textures
+			PassBuilder& Write(RenderResource resource, AttachmentLoad load, float clearDepth, int clearStencil = 0);
+
+		private:
+			PassBuilder(RenderGraph& graph, uint32_t pass) : m_Graph(graph), m_Pass(pass) {}
+
+			RenderGraph& m_Graph;
+			uint32_t m_Pass;
+
+			friend class RenderGraph;
+		};
+
+		struct Statistics
+		{
+			uint32_t Passes = 0, CulledPasses = 0;
+			uint32_t Textures = 0;			// transient textures the passes use
+			uint32_t PhysicalTextures = 0;	// GL textures backing them
+			uint64_t Bytes = 0;				// of the physical textures
+		};
+
+	public:
+		RenderGraph(uint32_t width, uint32_t height);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		RenderResource CreateTexture(const std::string& name, const RenderTextureDescription& description);
+		// An existing framebuffer (0 is the window's) of the graph's size. Writing it keeps a pass
+		// alive; a pass writing it can't have other attachments.
+		RenderResource ImportFramebuffer(const std::string& name, unsigned int framebuffer);
+		PassBuilder AddPass(const std::string& name, ExecuteFunction execute);
+
+		// Culls, assigns the pool's textures and creates the framebuffers. Called by Execute() after
+		// the graph changed.
+		bool Compile();
+		void Execute();
+		void Resize(uint32_t width, uint32_t height);
+
+		// The GL texture of a resource, for the passes reading it.
+		unsigned int GetTexture(RenderResource resource) const;
+		inline uint32_t GetWidth() const { return m_Width; }
+		inline uint32_t GetHeight() const { return m_Height; }
+
+		// every pass is wrapped in a GPU zone named after it
+		inline void SetGPUProfiler(GPUProfiler* profiler) { m_GPUProfiler = profiler; }
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+		void PrintReport(std::ostream& out) const;
+
+	private:
+		struct Resource
+		{
+			std::string Name;
+			RenderTextureDescription Description;
+			bool Imported = false;
+			unsigned int Framebuffer = 0;	// imported only
+			uint32_t Physical = UINT32_MAX;	// into m_Pool
+			uint32_t FirstUse = UINT32_MAX, LastUse = 0;
+			uint32_t RefCount = 0;
+		};
+
+		struct Attachment
+		{
+			RenderResource Resource;
+			AttachmentLoad Load;
+			glm::vec4 ClearColor;
+			float ClearDepth;
+			int ClearStencil;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			ExecuteFunction Execute;
+			std::vector<RenderResource> Reads;
+			std::vector<Attachment> Writes;
+			bool Culled = false;
+			uint32_t RefCount = 0;
+			unsigned int Framebuffer = 0;	// owned unless it writes an imported framebuffer
+			bool OwnsFramebuffer = false;
+			Profiler::ZoneID Zone = 0;
+		};
+
+		struct PhysicalTexture
+		{
+			unsigned int Texture = 0;
+			RenderTextureDescription Description;
+			uint32_t Width = 0, Height = 0;
+		};
+
+		glm::uvec2 GetSize(const RenderTextureDescription& description) const;
+		glm::uvec2 GetPassSize(const Pass& pass) const;
+		uint32_t AcquirePhysical(const RenderTextureDescription& description, std::vector<bool>& inUse);
+		void AllocateStorage(PhysicalTexture& texture);
+		bool CreateFramebuffer(Pass& pass);
+		void ReleaseFramebuffers();
+
+	private:
+		uint32_t m_Width, m_Height;
+		std::vector<Resource> m_Resources;
+		std::vector<Pass> m_Passes;
+		std::vector<PhysicalTexture> m_Pool;
+		bool m_Compiled = false;
+		GPUProfiler* m_GPUProfiler = nullptr;
+		Statistics m_Statistics;
+	};
+}
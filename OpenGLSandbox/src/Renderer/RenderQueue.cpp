@@ -0,0 +1,360 @@
+#include "RenderQueue.h"
+#include "RenderState.h"
+#include "Utilities/Shader.h"
+#include "Utilities/JobSystem.h"
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstring>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		// key layout, most significant first:
+		//   opaque       layer 8 | program 12 | texture 20 | depth 24
+		//   translucent  layer 8 | far to near depth 24 | program 12 | texture 20
+		//   overlay      layer 8 | 0
+		// program and texture are GL names cut to their field, a collision only costs a state change
+		static constexpr uint32_t LayerShift = 56;
+		static constexpr uint64_t ProgramMask = (1ull << 12) - 1;
+		static constexpr uint64_t TextureMask = (1ull << 20) - 1;
+		static constexpr uint64_t DepthMask = (1ull << 24) - 1;
+
+		static uint64_t QuantizeDepth(float depth)
+		{
+			return (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * (float)DepthMask);
+		}
+
+		// LSD radix sort on bytes, stable; byte positions every key shares are skipped, so keys that only
+		// use a few bits take only a few passes
+		template<typename T>
+		static void RadixSort(std::vector<T>& entries, std::vector<T>& scratch)
+		{
+			size_t count = entries.size();
+			if (count < 2)
+				return;
+
+			uint32_t histograms[8][256] = {};
+			for (const T& entry : entries)
+				for (uint32_t byte = 0; byte < 8; byte++)
+					histograms[byte][(entry.Key >> (byte * 8)) & 0xFF]++;
+
+			scratch.resize(count);
+			T* source = entries.data();
+			T* destination = scratch.data();
+			for (uint32_t byte = 0; byte < 8; byte++)
+			{
+				uint32_t* histogram = histograms[byte];
+				if (histogram[(source[0].Key >> (byte * 8)) & 0xFF] == count)
+					continue;
+
+				uint32_t offset = 0;
+				for (uint32_t bucket = 0; bucket < 256; bucket++)
+				{
+					uint32_t bucketCount = histogram[bucket];
+					histogram[bucket] = offset;
+					offset += bucketCount;
+				}
+				for (size_t i = 0; i < count; i++)
+					destination[histogram[(source[i].Key >> (byte * 8)) & 0xFF]++] = source[i];
+				std::swap(source, destination);
+			}
+			if (source != entries.data())
+				entries.swap(scratch);
+		}
+	}
+
+	//////////////////////////////////////////// CommandBuffer ////////////////////////////////////////////
+
+	void RenderQueue::CommandBuffer::Draw(uint64_t key, const DrawCommand& command)
+	{
+		Packet& packet = m_Packets.emplace_back();
+		packet.Key = key;
+		packet.Command = command;
+		packet.FirstUniform = (uint32_t)m_Uniforms.size();
+	}
+
+	void RenderQueue::CommandBuffer::AddUniform(uint64_t nameHash, UniformType type, const void* value, uint32_t size)
+	{
+		if (m_Packets.empty())
+			return;
+
+		uint32_t offset = (uint32_t)m_UniformData.size();
+		m_UniformData.resize(offset + size);
+		memcpy(&m_UniformData[offset], value, size);
+		m_Uniforms.push_back({ nameHash, type, offset });
+		m_Packets.back().UniformCount++;
+	}
+
+	void RenderQueue::CommandBuffer::SetUniform1i(uint64_t nameHash, int value) { AddUniform(nameHash, UniformType::Int, &value, sizeof(value)); }
+	void RenderQueue::CommandBuffer::SetUniform1f(uint64_t nameHash, float value) { AddUniform(nameHash, UniformType::Float, &value, sizeof(value)); }
+	void RenderQueue::CommandBuffer::SetUniform2f(uint64_t nameHash, const glm::vec2& value) { AddUniform(nameHash, UniformType::Vec2, &value, sizeof(value)); }
+	void RenderQueue::CommandBuffer::SetUniform3f(uint64_t nameHash, const glm::vec3& value) { AddUniform(nameHash, UniformType::Vec3, &value, sizeof(value)); }
+	void RenderQueue::CommandBuffer::SetUniform4f(uint64_t nameHash, const glm::vec4& value) { AddUniform(nameHash, UniformType::Vec4, &value, sizeof(value)); }
+	void RenderQueue::CommandBuffer::SetUniform4m(uint64_t nameHash, const glm::mat4& matrix) { AddUniform(nameHash, UniformType::Mat4, &matrix, sizeof(matrix)); }
+
+	void RenderQueue::CommandBuffer::Clear()
+	{
+		m_Packets.clear();
+		m_Uniforms.clear();
+		m_UniformData.clear();
+		m_Acquired = false;
+	}
+
+	//////////////////////////////////////////// RenderQueue ////////////////////////////////////////////
+
+	RenderQueue::CommandBuffer& RenderQueue::Acquire()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		CommandBuffer* buffer = nullptr;
+		for (auto& candidate : m_Buffers)
+		{
+			if (!candidate->m_Acquired) {
+				buffer = candidate.get();
+				break;
+			}
+		}
+		if (!buffer) {
+			m_Buffers.push_back(std::make_unique<CommandBuffer>());
+			buffer = m_Buffers.back().get();
+		}
+		buffer->m_Acquired = true;
+		m_Acquired.push_back(buffer);
+		return *buffer;
+	}
+
+	uint64_t RenderQueue::MakeKey(RenderLayer layer, unsigned int program, unsigned int texture, float depth)
+	{
+		uint64_t key = (uint64_t)layer << Utils::LayerShift;
+		switch (layer)
+		{
+		case RenderLayer::Opaque:
+			return key | (program & Utils::ProgramMask) << 44 | (texture & Utils::TextureMask) << 24 | Utils::QuantizeDepth(depth);
+		case RenderLayer::Translucent:
+			return key | (Utils::DepthMask - Utils::QuantizeDepth(depth)) << 32 | (program & Utils::ProgramMask) << 20 | (texture & Utils::TextureMask);
+		case RenderLayer::Overlay:
+			break;
+		}
+		return key;
+	}
+
+	uint64_t RenderQueue::MakeKey(RenderLayer layer, const DrawCommand& command, float depth)
+	{
+		return MakeKey(layer, command.Program ? command.Program->GetRendererID() : 0, command.Textures[0].Texture, depth);
+	}
+
+	void RenderQueue::Sort()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		size_t count = 0;
+		for (const CommandBuffer* buffer : m_Acquired)
+			count += buffer->m_Packets.size();
+		m_Merged.clear();
+		m_Entries.clear();
+		m_Merged.reserve(count);
+		m_Entries.reserve(count);
+		for (const CommandBuffer* buffer : m_Acquired)
+		{
+			for (const CommandBuffer::Packet& packet : buffer->m_Packets)
+			{
+				m_Entries.push_back({ packet.Key, (uint32_t)m_Merged.size() });
+				m_Merged.push_back({ buffer, &packet });
+			}
+		}
+		Utils::RadixSort(m_Entries, m_SortScratch);
+	}
+
+	void RenderQueue::Submit(RenderLayer last)
+	{
+		if (!m_Sorted) {
+			Sort();
+			m_Sorted = true;
+			m_Issued = 0;
+			m_Previous = nullptr;
+			m_Statistics = Statistics();
+			m_Statistics.Commands = (uint32_t)m_Entries.size();
+			m_Statistics.CommandBuffers = (uint32_t)m_Acquired.size();
+		}
+
+		// the layer is the top of the key, so the packets are sorted by layer first
+		uint64_t end = ((uint64_t)last + 1) << Utils::LayerShift;
+		for (; m_Issued < m_Entries.size() && m_Entries[m_Issued].Key < end; m_Issued++)
+		{
+			const MergedPacket& merged = m_Merged[m_Entries[m_Issued].Packet];
+			const DrawCommand& command = merged.Packet->Command;
+			if (!m_Previous || m_Previous->Program != command.Program)
+				m_Statistics.ProgramChanges++;
+			if (!m_Previous || m_Previous->Textures[0].Texture != command.Textures[0].Texture)
+				m_Statistics.TextureChanges++;
+			m_Previous = &command;
+
+			Issue(*merged.Buffer, *merged.Packet);
+		}
+
+		if (last != RenderLayer::Overlay)
+			return;
+		for (CommandBuffer* buffer : m_Acquired)
+			buffer->Clear();
+		m_Acquired.clear();
+		m_Sorted = false;
+	}
+
+	void RenderQueue::Issue(const CommandBuffer& buffer, const CommandBuffer::Packet& packet)
+	{
+		const DrawCommand& command = packet.Command;
+		if (!command.Program || !command.Count || !command.InstanceCount)
+			return;
+
+		Shader& program = *command.Program;
+		program.Bind();
+		for (uint32_t i = packet.FirstUniform; i < packet.FirstUniform + packet.UniformCount; i++)
+		{
+			const CommandBuffer::Uniform& uniform = buffer.m_Uniforms[i];
+			const uint8_t* data = &buffer.m_UniformData[uniform.Offset];
+			switch (uniform.Type)
+			{
+			case CommandBuffer::UniformType::Int:
+			{
+				int value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform1i(uniform.NameHash, value);
+				break;
+			}
+			case CommandBuffer::UniformType::Float:
+			{
+				float value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform1f(uniform.NameHash, value);
+				break;
+			}
+			case CommandBuffer::UniformType::Vec2:
+			{
+				glm::vec2 value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform2f(uniform.NameHash, value);
+				break;
+			}
+			case CommandBuffer::UniformType::Vec3:
+			{
+				glm::vec3 value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform3f(uniform.NameHash, value);
+				break;
+			}
+			case CommandBuffer::UniformType::Vec4:
+			{
+				glm::vec4 value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform4f(uniform.NameHash, value);
+				break;
+			}
+			case CommandBuffer::UniformType::Mat4:
+			{
+				glm::mat4 value;
+				memcpy(&value, data, sizeof(value));
+				program.SetUniform4m(uniform.NameHash, value);
+				break;
+			}
+			}
+		}
+
+		RenderState::BindVertexArray(command.VertexArray);
+		for (uint32_t unit = 0; unit < DrawCommand::MaxTextures; unit++)
+		{
+			const DrawCommand::TextureBinding& binding = command.Textures[unit];
+			if (binding.Target)
+				RenderState::BindTexture(unit, binding.Target, binding.Texture);
+		}
+
+		if (command.Indexed)
+			glDrawElementsInstanced(command.Mode, (GLsizei)command.Count, GL_UNSIGNED_INT, (void*)((size_t)command.First * sizeof(uint32_t)), (GLsizei)command.InstanceCount);
+		else if (command.InstanceCount > 1)
+			glDrawArraysInstanced(command.Mode, (GLint)command.First, (GLsizei)command.Count, (GLsizei)command.InstanceCount);
+		else
+			glDrawArrays(command.Mode, (GLint)command.First, (GLsizei)command.Count);
+	}
+
+	void RenderQueue::RunBenchmark(std::ostream& out)
+	{
+		constexpr uint32_t BufferCount = 4;
+		constexpr uint32_t PacketsPerBuffer = 50000;
+		constexpr uint32_t Programs = 24;
+		constexpr uint32_t Textures = 256;
+		constexpr int Runs = 10;
+
+		// program and texture changes of the opaque layer, in the given order
+		auto countChanges = [](const std::vector<SortEntry>& entries, uint32_t& programChanges, uint32_t& textureChanges)
+		{
+			programChanges = textureChanges = 0;
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				uint64_t key = entries[i].Key;
+				uint64_t previous = i ? entries[i - 1].Key : ~key;
+				programChanges += ((key ^ previous) >> 44 & Utils::ProgramMask) != 0;
+				textureChanges += ((key ^ previous) >> 24 & Utils::TextureMask) != 0;
+			}
+		};
+
+		RenderQueue queue;
+		double recordTime = 0.0, radixTime = 0.0, stdTime = 0.0;
+		uint32_t recordedPrograms = 0, recordedTextures = 0, sortedPrograms = 0, sortedTextures = 0;
+		bool identical = true;
+		for (int run = 0; run < Runs; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			// one job per command buffer, recorded on as many threads as the job system has
+			JobSystem::ParallelFor(BufferCount, [&queue, run](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t t = begin; t < end; t++)
+				{
+					std::mt19937 random(1337 + t * 31 + run);
+					std::uniform_int_distribution<uint32_t> program(1, Programs), texture(1, Textures);
+					std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+					CommandBuffer& commands = queue.Acquire();
+					for (uint32_t i = 0; i < PacketsPerBuffer; i++)
+					{
+						DrawCommand command;
+						command.Count = 6;
+						commands.Draw(MakeKey(RenderLayer::Opaque, program(random), texture(random), depth(random)), command);
+						commands.SetUniform4f(Hash::FNV1a("u_Color"), glm::vec4((float)i));
+					}
+				}
+			}, 1);
+			recordTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			// the recorded order, before sorting
+			std::vector<SortEntry> recorded;
+			for (const CommandBuffer* buffer : queue.m_Acquired)
+				for (const CommandBuffer::Packet& packet : buffer->m_Packets)
+					recorded.push_back({ packet.Key, (uint32_t)recorded.size() });
+
+			start = std::chrono::steady_clock::now();
+			queue.Sort();
+			radixTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			std::vector<SortEntry> reference = recorded;
+			std::stable_sort(reference.begin(), reference.end(), [](const SortEntry& a, const SortEntry& b) { return a.Key < b.Key; });
+			stdTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			for (size_t i = 0; i < reference.size(); i++)
+				identical &= reference[i].Key == queue.m_Entries[i].Key && reference[i].Packet == queue.m_Entries[i].Packet;
+			countChanges(recorded, recordedPrograms, recordedTextures);
+			countChanges(queue.m_Entries, sortedPrograms, sortedTextures);
+
+			for (CommandBuffer* buffer : queue.m_Acquired)
+				buffer->Clear();
+			queue.m_Acquired.clear();
+		}
+
+		out << BufferCount << " buffers x " << PacketsPerBuffer << " packets on " << JobSystem::GetThreadCount() << " threads, " << Programs << " programs, " << Textures << " textures, average of " << Runs << " runs" << std::endl;
+		out << "  record                " << recordTime / Runs << " ms" << std::endl;
+		out << "  merge + radix sort    " << radixTime / Runs << " ms" << std::endl;
+		out << "  std::stable_sort      " << stdTime / Runs << " ms" << (identical ? "" : "  ORDER DIFFERS") << std::endl;
+		out << "  program changes       " << recordedPrograms << " recorded, " << sortedPrograms << " sorted" << std::endl;
+		out << "  texture changes       " << recordedTextures << " recorded, " << sortedTextures << " sorted" << std::endl;
+	}
+}
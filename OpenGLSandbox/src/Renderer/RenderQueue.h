@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Utilities/Hash.h"
+
+namespace OpenGLSandbox {
+
+	class Shader;
+
+	// Layers are submitted in this order; within a layer the sort key decides.
+	enum class RenderLayer : uint8_t
+	{
+		Opaque,			// by program and texture, then front to back
+		Translucent,	// back to front, then by program and texture
+		Overlay			// in the order recorded, for text and UI
+	};
+
+	struct DrawCommand
+	{
+		static constexpr uint32_t MaxTextures = 4;
+
+		struct TextureBinding
+		{
+			unsigned int Target = 0;	// 0 leaves the unit alone
+			unsigned int Texture = 0;
+		};
+
+		Shader* Program = nullptr;
+		unsigned int VertexArray = 0;
+		TextureBinding Textures[MaxTextures];	// by unit
+		unsigned int Mode = 0x0004;	// GL_TRIANGLES
+		bool Indexed = false;		// GL_UNSIGNED_INT indices from the vertex array's element buffer
+		uint32_t First = 0;			// first vertex, or first index when indexed
+		uint32_t Count = 0;
+		uint32_t InstanceCount = 1;
+	};
+
+	// Draws recorded as packets with a 64-bit sort key, from any number of threads, and issued on the
+	// GL thread. Every recording thread takes its own command buffer with Acquire(), so recording
+	// never locks and never touches GL. Submit() merges the buffers in the order they were acquired,
+	// radix sorts the packets by key, which is stable, and issues them through RenderState and the
+	// shaders' uniform caches, so the binds and uniforms that sorting made redundant are skipped.
+	//
+	// Recording and Submit() must not overlap. Packets of different buffers with equal keys are
+	// issued in acquisition order, which varies between threads; give order dependent packets
+	// distinct keys or record them into one buffer.
+	class RenderQueue
+	{
+	public:
+		class CommandBuffer
+		{
+		public:
+			void Draw(uint64_t key, const DrawCommand& command);
+
+			// add a uniform to the last draw, set right before it is issued
+			void SetUniform1i(uint64_t nameHash, int value);
+			void SetUniform1f(uint64_t nameHash, float value);
+			void SetUniform2f(uint64_t nameHash, const glm::vec2& value);
+			void SetUniform3f(uint64_t nameHash, const glm::vec3& value);
+			void SetUniform4f(uint64_t nameHash, const glm::vec4& value);
+			void SetUniform4m(uint64_t nameHash, const glm::mat4& matrix);
+
+			inline void SetUniform1i(std::string_view uniformName, int value) { SetUniform1i(Hash::FNV1a(uniformName), value); }
+			inline void SetUniform1f(std::string_view uniformName, float value) { SetUniform1f(Hash::FNV1a(uniformName), value); }
+			inline void SetUniform2f(std::string_view uniformName, const glm::vec2& value) { SetUniform2f(Hash::FNV1a(uniformName), value); }
+			inline void SetUniform3f(std::string_view uniformName, const glm::vec3& value) { SetUniform3f(Hash::FNV1a(uniformName), value); }
+			inline void SetUniform4f(std::string_view uniformName, const glm::vec4& value) { SetUniform4f(Hash::FNV1a(uniformName), value); }
+			inline void SetUniform4m(std::string_view uniformName, const glm::mat4& matrix) { SetUniform4m(Hash::FNV1a(uniformName), matrix); }
+
+			inline uint32_t GetCount() const { return (uint32_t)m_Packets.size(); }
+
+		private:
+			enum class UniformType : uint8_t { Int, Float, Vec2, Vec3, Vec4, Mat4 };
+
+			struct Uniform
+			{
+				uint64_t NameHash;
+				UniformType Type;
+				uint32_t Offset;	// into m_UniformData
+			};
+
+			struct Packet
+			{
+				uint64_t Key;
+				DrawCommand Command;
+				uint32_t FirstUniform = 0, UniformCount = 0;
+			};
+
+			void AddUniform(uint64_t nameHash, UniformType type, const void* value, uint32_t size);
+			void Clear();
+
+		private:
+			std::vector<Packet> m_Packets;
+			std::vector<Uniform> m_Uniforms;
+			std::vector<uint8_t> m_UniformData;
+			bool m_Acquired = false;
+
+			friend class RenderQueue;
+		};
+
+		struct Statistics
+		{
+			uint32_t Commands = 0;
+			uint32_t CommandBuffers = 0;
+			uint32_t ProgramChanges = 0;	// between consecutive packets, after sorting
+			uint32_t TextureChanges = 0;
+		};
+
+	public:
+		RenderQueue() = default;
+
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		// Thread safe. The buffer is the calling thread's until the next Submit().
+		CommandBuffer& Acquire();
+		// Issues the recorded packets of the layers up to last that weren't issued yet, so a frame can
+		// be submitted in parts, e.g. with its own GPU zone around the overlay. The first call of a
+		// frame merges and sorts, the one that reaches the overlay empties the buffers; nothing may
+		// be recorded in between. GL thread only.
+		void Submit(RenderLayer last = RenderLayer::Overlay);
+
+		// depth runs from 0 (near) to 1 (far). Overlay keys hold only the layer, so overlay packets
+		// keep the order they were recorded in.
+		static uint64_t MakeKey(RenderLayer layer, unsigned int program, unsigned int texture, float depth = 0.0f);
+		static uint64_t MakeKey(RenderLayer layer, const DrawCommand& command, float depth = 0.0f);
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+		// Records random packets on several threads, then compares the radix sort with std::stable_sort
+		// and the state changes of the sorted order with the recorded one. Needs no GL context.
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		struct SortEntry
+		{
+			uint64_t Key;
+			uint32_t Packet;	// into m_Merged
+		};
+
+		struct MergedPacket
+		{
+			const CommandBuffer* Buffer;
+			const CommandBuffer::Packet* Packet;
+		};
+
+		// Merges and sorts, no GL.
+		void Sort();
+		void Issue(const CommandBuffer& buffer, const CommandBuffer::Packet& packet);
+
+	private:
+		std::mutex m_Mutex;
+		std::vector<std::unique_ptr<CommandBuffer>> m_Buffers;
+		std::vector<CommandBuffer*> m_Acquired;	// in acquisition order
+		std::vector<MergedPacket> m_Merged;
+		std::vector<SortEntry> m_Entries, m_SortScratch;
+		// of a frame submitted in parts
+		bool m_Sorted = false;
+		size_t m_Issued = 0;					// into m_Entries
+		const DrawCommand* m_Previous = nullptr;
+		Statistics m_Statistics;
+	};
+}
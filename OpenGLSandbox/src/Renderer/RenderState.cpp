@@ -0,0 +1,357 @@
+#include "RenderState.h"
+#include <glad/glad.h>
+#include <unordered_map>
+#include <string>
+#include <cstdio>
+
+namespace OpenGLSandbox {
+
+	namespace RenderState {
+
+		namespace Utils {
+
+			// a shadow value GL may or may not have, the next call always goes through
+			static constexpr unsigned int Unknown = ~0u;
+
+			// units and targets past these are never filtered
+			static constexpr uint32_t TextureUnitCount = 16;
+			static constexpr GLenum TextureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER, GL_TEXTURE_CUBE_MAP };
+			static constexpr GLenum TextureBindings[] = { GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_CUBE_MAP };
+			static constexpr uint32_t TextureTargetCount = sizeof(TextureTargets) / sizeof(TextureTargets[0]);
+
+			static constexpr GLenum BufferTargets[] = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER,
+				GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER };
+			static constexpr GLenum BufferBindings[] = { GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_TEXTURE_BUFFER,
+				GL_PIXEL_PACK_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER };
+			static constexpr uint32_t BufferTargetCount = sizeof(BufferTargets) / sizeof(BufferTargets[0]);
+
+			static constexpr GLenum Capabilities[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST };
+			static constexpr uint32_t CapabilityCount = sizeof(Capabilities) / sizeof(Capabilities[0]);
+
+			struct ShadowState
+			{
+				unsigned int Program = Unknown;
+				unsigned int VertexArray = Unknown;
+				unsigned int Buffers[BufferTargetCount];
+				std::unordered_map<unsigned int, unsigned int> ElementBuffers;	// vertex array, element buffer
+				unsigned int ActiveUnit = Unknown;
+				unsigned int Textures[TextureUnitCount][TextureTargetCount];
+				unsigned int DrawFramebuffer = Unknown, ReadFramebuffer = Unknown;
+				int Viewport[4] = { 0, 0, 0, 0 };
+				bool ViewportKnown = false;
+				unsigned int Enabled[CapabilityCount];	// 0, 1 or Unknown
+				unsigned int BlendSource = Unknown, BlendDestination = Unknown;
+				unsigned int FrontFace = Unknown;
+
+				ShadowState()
+				{
+					for (unsigned int& buffer : Buffers)
+						buffer = Unknown;
+					for (auto& unit : Textures)
+						for (unsigned int& texture : unit)
+							texture = Unknown;
+					for (unsigned int& enabled : Enabled)
+						enabled = Unknown;
+				}
+			};
+
+			static ShadowState s_State;
+			static Statistics s_Statistics;
+
+			template<typename T, size_t N>
+			static int FindIndex(const T(&values)[N], GLenum value)
+			{
+				for (size_t i = 0; i < N; i++)
+					if (values[i] == value)
+						return (int)i;
+				return -1;
+			}
+
+			// counts the call, true if it has to be made
+			static bool Changes(unsigned int& shadow, unsigned int value)
+			{
+				if (shadow == value) {
+					s_Statistics.Filtered++;
+					return false;
+				}
+				shadow = value;
+				s_Statistics.Issued++;
+				return true;
+			}
+
+			static void ActiveTexture(uint32_t unit)
+			{
+				if (Changes(s_State.ActiveUnit, unit))
+					glActiveTexture(GL_TEXTURE0 + unit);
+			}
+
+			static std::string Hex(GLenum value)
+			{
+				char text[16];
+				snprintf(text, sizeof(text), "0x%04X", value);
+				return text;
+			}
+
+			static void Check(std::ostream& out, const std::string& name, unsigned int& shadow, GLint actual, bool& valid)
+			{
+				if (shadow == Unknown || shadow == (unsigned int)actual)
+					return;
+				out << "RenderState: " << name << " is " << actual << " but cached as " << shadow << std::endl;
+				shadow = (unsigned int)actual;
+				s_Statistics.Mismatches++;
+				valid = false;
+			}
+		}
+
+		void Invalidate()
+		{
+			Utils::s_State = Utils::ShadowState();
+		}
+
+		void UseProgram(unsigned int program)
+		{
+			if (Utils::Changes(Utils::s_State.Program, program))
+				glUseProgram(program);
+		}
+
+		void BindVertexArray(unsigned int vertexArray)
+		{
+			if (Utils::Changes(Utils::s_State.VertexArray, vertexArray))
+				glBindVertexArray(vertexArray);
+		}
+
+		void BindBuffer(unsigned int target, unsigned int buffer)
+		{
+			if (target == GL_ELEMENT_ARRAY_BUFFER && Utils::s_State.VertexArray != Utils::Unknown) {
+				auto [it, inserted] = Utils::s_State.ElementBuffers.try_emplace(Utils::s_State.VertexArray, Utils::Unknown);
+				if (Utils::Changes(it->second, buffer))
+					glBindBuffer(target, buffer);
+				return;
+			}
+
+			int index = Utils::FindIndex(Utils::BufferTargets, target);
+			if (index < 0) {
+				Utils::s_Statistics.Issued++;
+				glBindBuffer(target, buffer);
+				return;
+			}
+			if (Utils::Changes(Utils::s_State.Buffers[index], buffer))
+				glBindBuffer(target, buffer);
+		}
+
+		void BindBufferBase(unsigned int target, uint32_t index, unsigned int buffer)
+		{
+			// the indexed bindings aren't tracked, only the generic one this changes
+			Utils::s_Statistics.Issued++;
+			glBindBufferBase(target, index, buffer);
+			int targetIndex = Utils::FindIndex(Utils::BufferTargets, target);
+			if (targetIndex >= 0)
+				Utils::s_State.Buffers[targetIndex] = buffer;
+		}
+
+		void BindTexture(uint32_t unit, unsigned int target, unsigned int texture)
+		{
+			int index = Utils::FindIndex(Utils::TextureTargets, target);
+			if (unit >= Utils::TextureUnitCount || index < 0) {
+				Utils::ActiveTexture(unit);
+				Utils::s_Statistics.Issued++;
+				glBindTexture(target, texture);
+				return;
+			}
+
+			unsigned int& shadow = Utils::s_State.Textures[unit][index];
+			if (shadow == texture) {
+				Utils::s_Statistics.Filtered++;
+				return;
+			}
+			Utils::ActiveTexture(unit);
+			Utils::Changes(shadow, texture);
+			glBindTexture(target, texture);
+		}
+
+		void BindFramebuffer(unsigned int target, unsigned int framebuffer)
+		{
+			Utils::ShadowState& state = Utils::s_State;
+			if (target == GL_FRAMEBUFFER) {
+				if (state.DrawFramebuffer == framebuffer && state.ReadFramebuffer == framebuffer) {
+					Utils::s_Statistics.Filtered++;
+					return;
+				}
+				state.DrawFramebuffer = state.ReadFramebuffer = framebuffer;
+				Utils::s_Statistics.Issued++;
+				glBindFramebuffer(target, framebuffer);
+				return;
+			}
+			if (Utils::Changes(target == GL_READ_FRAMEBUFFER ? state.ReadFramebuffer : state.DrawFramebuffer, framebuffer))
+				glBindFramebuffer(target, framebuffer);
+		}
+
+		void Viewport(int x, int y, int width, int height)
+		{
+			Utils::ShadowState& state = Utils::s_State;
+			if (state.ViewportKnown && state.Viewport[0] == x && state.Viewport[1] == y && state.Viewport[2] == width && state.Viewport[3] == height) {
+				Utils::s_Statistics.Filtered++;
+				return;
+			}
+			state.Viewport[0] = x;
+			state.Viewport[1] = y;
+			state.Viewport[2] = width;
+			state.Viewport[3] = height;
+			state.ViewportKnown = true;
+			Utils::s_Statistics.Issued++;
+			glViewport(x, y, width, height);
+		}
+
+		void SetEnabled(unsigned int capability, bool enabled)
+		{
+			int index = Utils::FindIndex(Utils::Capabilities, capability);
+			if (index >= 0 && !Utils::Changes(Utils::s_State.Enabled[index], enabled ? 1 : 0))
+				return;
+			if (index < 0)
+				Utils::s_Statistics.Issued++;
+
+			if (enabled)
+				glEnable(capability);
+			else
+				glDisable(capability);
+		}
+
+		void BlendFunc(unsigned int source, unsigned int destination)
+		{
+			Utils::ShadowState& state = Utils::s_State;
+			if (state.BlendSource == source && state.BlendDestination == destination) {
+				Utils::s_Statistics.Filtered++;
+				return;
+			}
+			state.BlendSource = source;
+			state.BlendDestination = destination;
+			Utils::s_Statistics.Issued++;
+			glBlendFunc(source, destination);
+		}
+
+		void FrontFace(unsigned int mode)
+		{
+			if (Utils::Changes(Utils::s_State.FrontFace, mode))
+				glFrontFace(mode);
+		}
+
+		// deleting an object unbinds it from the context, the shadow follows
+		void DeleteVertexArray(unsigned int vertexArray)
+		{
+			glDeleteVertexArrays(1, &vertexArray);
+			Utils::s_State.ElementBuffers.erase(vertexArray);
+			if (Utils::s_State.VertexArray == vertexArray)
+				Utils::s_State.VertexArray = 0;
+		}
+
+		void DeleteBuffer(unsigned int buffer)
+		{
+			glDeleteBuffers(1, &buffer);
+			Utils::ShadowState& state = Utils::s_State;
+			for (unsigned int& binding : state.Buffers)
+				if (binding == buffer)
+					binding = 0;
+			// other vertex arrays keep referring to the deleted buffer, their binding is no longer known
+			for (auto& [vertexArray, elementBuffer] : state.ElementBuffers)
+				if (elementBuffer == buffer)
+					elementBuffer = vertexArray == state.VertexArray ? 0 : Utils::Unknown;
+		}
+
+		void DeleteTexture(unsigned int texture)
+		{
+			glDeleteTextures(1, &texture);
+			for (auto& unit : Utils::s_State.Textures)
+				for (unsigned int& binding : unit)
+					if (binding == texture)
+						binding = 0;
+		}
+
+		void DeleteFramebuffer(unsigned int framebuffer)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			Utils::ShadowState& state = Utils::s_State;
+			if (state.DrawFramebuffer == framebuffer)
+				state.DrawFramebuffer = 0;
+			if (state.ReadFramebuffer == framebuffer)
+				state.ReadFramebuffer = 0;
+		}
+
+		bool Validate(std::ostream& out)
+		{
+			Utils::ShadowState& state = Utils::s_State;
+			bool valid = true;
+			GLint value = 0;
+
+			glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+			Utils::Check(out, "program", state.Program, value, valid);
+			glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+			Utils::Check(out, "vertex array", state.VertexArray, value, valid);
+			if (state.VertexArray != Utils::Unknown) {
+				auto it = state.ElementBuffers.find(state.VertexArray);
+				if (it != state.ElementBuffers.end()) {
+					glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &value);
+					Utils::Check(out, "element buffer of vertex array " + std::to_string(state.VertexArray), it->second, value, valid);
+				}
+			}
+			for (uint32_t i = 0; i < Utils::BufferTargetCount; i++)
+			{
+				glGetIntegerv(Utils::BufferBindings[i], &value);
+				Utils::Check(out, "buffer binding " + Utils::Hex(Utils::BufferTargets[i]), state.Buffers[i], value, valid);
+			}
+
+			GLint activeTexture = GL_TEXTURE0;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+			Utils::Check(out, "active texture unit", state.ActiveUnit, activeTexture - GL_TEXTURE0, valid);
+			for (uint32_t unit = 0; unit < Utils::TextureUnitCount; unit++)
+			{
+				glActiveTexture(GL_TEXTURE0 + unit);
+				for (uint32_t i = 0; i < Utils::TextureTargetCount; i++)
+				{
+					glGetIntegerv(Utils::TextureBindings[i], &value);
+					Utils::Check(out, "unit " + std::to_string(unit) + " texture " + Utils::Hex(Utils::TextureTargets[i]), state.Textures[unit][i], value, valid);
+				}
+			}
+			glActiveTexture(activeTexture);
+
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value);
+			Utils::Check(out, "draw framebuffer", state.DrawFramebuffer, value, valid);
+			glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &value);
+			Utils::Check(out, "read framebuffer", state.ReadFramebuffer, value, valid);
+
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			if (state.ViewportKnown && (viewport[0] != state.Viewport[0] || viewport[1] != state.Viewport[1]
+				|| viewport[2] != state.Viewport[2] || viewport[3] != state.Viewport[3])) {
+				out << "RenderState: viewport is " << viewport[2] << "x" << viewport[3] << " at " << viewport[0] << "," << viewport[1]
+					<< " but cached as " << state.Viewport[2] << "x" << state.Viewport[3] << " at " << state.Viewport[0] << "," << state.Viewport[1] << std::endl;
+				for (int i = 0; i < 4; i++)
+					state.Viewport[i] = viewport[i];
+				Utils::s_Statistics.Mismatches++;
+				valid = false;
+			}
+
+			for (uint32_t i = 0; i < Utils::CapabilityCount; i++)
+				Utils::Check(out, "capability " + Utils::Hex(Utils::Capabilities[i]), state.Enabled[i], glIsEnabled(Utils::Capabilities[i]) ? 1 : 0, valid);
+			glGetIntegerv(GL_BLEND_SRC_RGB, &value);
+			Utils::Check(out, "blend source", state.BlendSource, value, valid);
+			glGetIntegerv(GL_BLEND_DST_RGB, &value);
+			Utils::Check(out, "blend destination", state.BlendDestination, value, valid);
+			glGetIntegerv(GL_FRONT_FACE, &value);
+			Utils::Check(out, "front face", state.FrontFace, value, valid);
+			return valid;
+		}
+
+		const Statistics& GetStatistics()
+		{
+			return Utils::s_Statistics;
+		}
+
+		void ResetStatistics()
+		{
+			// mismatches are kept, a debug run reports them at the end
+			uint32_t mismatches = Utils::s_Statistics.Mismatches;
+			Utils::s_Statistics = Statistics();
+			Utils::s_Statistics.Mismatches = mismatches;
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <ostream>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// Shadow copy of the GL state the renderer touches, for the one context on the render thread.
+	// Every function compares with the shadow and only calls GL when the value changes, so code can
+	// bind what it needs before drawing without caring what was bound before, and nothing has to be
+	// unbound afterwards.
+	//
+	// State changed by raw GL calls is not seen; call Invalidate() after such code and the next call
+	// of every kind goes to GL again. Vertex arrays, buffers, textures and framebuffers are deleted
+	// through the Delete functions: GL reuses their names, and a stale shadow binding would filter the
+	// bind of a new object that got the same name.
+	namespace RenderState {
+
+		struct Statistics
+		{
+			uint32_t Issued = 0;		// GL calls made
+			uint32_t Filtered = 0;		// calls dropped because the state already matched
+			uint32_t Mismatches = 0;	// found by Validate()
+		};
+
+		// Forgets the shadow, e.g. after the context was created or raw GL code ran.
+		void Invalidate();
+
+		void UseProgram(unsigned int program);
+		void BindVertexArray(unsigned int vertexArray);
+		// GL_ELEMENT_ARRAY_BUFFER is tracked per vertex array, it is part of the vertex array's state.
+		void BindBuffer(unsigned int target, unsigned int buffer);
+		// also binds the target's generic binding point, like GL does
+		void BindBufferBase(unsigned int target, uint32_t index, unsigned int buffer);
+		// Makes unit the active texture unit if the binding changes.
+		void BindTexture(uint32_t unit, unsigned int target, unsigned int texture);
+		// GL_FRAMEBUFFER binds both the draw and the read framebuffer.
+		void BindFramebuffer(unsigned int target, unsigned int framebuffer);
+		void Viewport(int x, int y, int width, int height);
+
+		void SetEnabled(unsigned int capability, bool enabled);
+		void BlendFunc(unsigned int source, unsigned int destination);
+		void FrontFace(unsigned int mode);
+
+		void DeleteVertexArray(unsigned int vertexArray);
+		void DeleteBuffer(unsigned int buffer);
+		void DeleteTexture(unsigned int texture);
+		void DeleteFramebuffer(unsigned int framebuffer);
+
+		// Compares every known shadow value with glGet*, prints the differences and adopts GL's
+		// values. Slow, meant for debugging.
+		bool Validate(std::ostream& out);
+
+		const Statistics& GetStatistics();
+		void ResetStatistics();
+	}
+}
@@ -0,0 +1,193 @@
+#include "StreamBuffer.h"
+#include "RenderState.h"
+#include <glad/glad.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static bool HasExtension(const char* name)
+		{
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++)
+			{
+				const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+				if (extension && strcmp(extension, name) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		static size_t AlignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	StreamBuffer::StreamBuffer(size_t regionSize, StreamMode mode)
+		: m_Mode(mode), m_RegionSize(Utils::AlignUp(regionSize, 256))
+	{
+		// glad only loads glBufferStorage for GL 4.4 contexts
+		if (m_Mode == StreamMode::Persistent && !(glBufferStorage && (GLAD_GL_VERSION_4_4 || Utils::HasExtension("GL_ARB_buffer_storage"))))
+			m_Mode = StreamMode::Unsynchronized;
+		Create();
+	}
+
+	StreamBuffer::~StreamBuffer()
+	{
+		Destroy();
+	}
+
+	void StreamBuffer::BeginFrame()
+	{
+		if (m_InFrame)
+			EndFrame();
+		m_Statistics = Statistics();
+
+		// every draw that read the previous region has been issued by now
+		if (m_Mode != StreamMode::Orphan) {
+			if (m_Fences[m_Region])
+				glDeleteSync((GLsync)m_Fences[m_Region]);
+			m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+
+		// the last frame dropped allocations, wait until the GPU is done with every region and grow
+		if (m_Requested > m_RegionSize) {
+			for (uint32_t region = 0; region < RegionCount; region++)
+				Wait(region);
+			size_t size = m_RegionSize;
+			while (size < m_Requested)
+				size *= 2;
+			std::cout << "StreamBuffer: growing the regions from " << m_RegionSize << " to " << size << " bytes" << std::endl;
+			Destroy();
+			m_RegionSize = size;
+			Create();
+		}
+
+		m_Region = m_Mode == StreamMode::Orphan ? 0 : (m_Region + 1) % RegionCount;
+		Wait(m_Region);
+
+		if (m_Mode == StreamMode::Unsynchronized) {
+			RenderState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+			m_Mapping = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, m_Region * m_RegionSize, m_RegionSize,
+				GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+		}
+		else if (m_Mode == StreamMode::Orphan) {
+			RenderState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+			m_Mapping = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_RegionSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		}
+
+		m_Used = 0;
+		m_Requested = 0;
+		m_InFrame = true;
+	}
+
+	StreamAllocation StreamBuffer::Allocate(size_t size, size_t alignment)
+	{
+		size_t offset = Utils::AlignUp(m_Used, alignment);
+		m_Requested = Utils::AlignUp(m_Requested, alignment) + size;
+		if (!m_InFrame || !m_Mapping || offset + size > m_RegionSize) {
+			m_Statistics.Overflows++;
+			return StreamAllocation();
+		}
+		m_Used = offset + size;
+
+		// a persistent mapping covers every region, the others only the current one
+		size_t regionOffset = m_Region * m_RegionSize;
+		StreamAllocation allocation;
+		allocation.Data = m_Mapping + (m_Mode == StreamMode::Persistent ? regionOffset : 0) + offset;
+		allocation.Buffer = m_Buffer;
+		allocation.Offset = regionOffset + offset;
+
+		m_Statistics.BytesStreamed += size;
+		m_Statistics.Allocations++;
+		return allocation;
+	}
+
+	void StreamBuffer::EndFrame()
+	{
+		if (!m_InFrame)
+			return;
+		m_InFrame = false;
+
+		// a coherent mapping needs nothing, the others are unmapped so the frame can draw from them
+		if (m_Mode == StreamMode::Persistent || !m_Mapping)
+			return;
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		if (m_Mode == StreamMode::Unsynchronized && m_Used)
+			glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, m_Used);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		m_Mapping = nullptr;
+	}
+
+	const char* StreamBuffer::GetModeName(StreamMode mode)
+	{
+		switch (mode)
+		{
+		case StreamMode::Persistent: return "persistent";
+		case StreamMode::Unsynchronized: return "unsynchronized";
+		case StreamMode::Orphan: return "orphan";
+		}
+		return "";
+	}
+
+	void StreamBuffer::Create()
+	{
+		// orphaning never has more than one region in use
+		size_t size = m_Mode == StreamMode::Orphan ? m_RegionSize : m_RegionSize * RegionCount;
+		glGenBuffers(1, &m_Buffer);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		if (m_Mode == StreamMode::Persistent) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+			m_Mapping = (uint8_t*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+			if (m_Mapping)
+				return;
+
+			RenderState::DeleteBuffer(m_Buffer);
+			m_Mode = StreamMode::Unsynchronized;
+			Create();
+			return;
+		}
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+
+	void StreamBuffer::Destroy()
+	{
+		if (m_Mapping) {
+			RenderState::BindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			m_Mapping = nullptr;
+		}
+		for (void*& fence : m_Fences)
+		{
+			if (fence)
+				glDeleteSync((GLsync)fence);
+			fence = nullptr;
+		}
+		RenderState::DeleteBuffer(m_Buffer);
+		m_Buffer = 0;
+		m_Region = RegionCount - 1;
+		m_InFrame = false;
+	}
+
+	void StreamBuffer::Wait(uint32_t region)
+	{
+		GLsync fence = (GLsync)m_Fences[region];
+		if (!fence)
+			return;
+
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			auto start = std::chrono::steady_clock::now();
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+			m_Statistics.StallTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			m_Statistics.Stalls++;
+		}
+		glDeleteSync(fence);
+		m_Fences[region] = nullptr;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace OpenGLSandbox {
+
+	enum class StreamMode
+	{
+		Persistent,		// ARB_buffer_storage: mapped once, persistent and coherent
+		Unsynchronized,	// GL 3.3: the frame's region mapped unsynchronized, fences keep it safe
+		Orphan			// GL 3.3: the whole buffer mapped invalidated every frame, the driver syncs
+	};
+
+	struct StreamAllocation
+	{
+		void* Data = nullptr;	// nullptr when the region was full
+		unsigned int Buffer = 0;
+		size_t Offset = 0;		// of Data in Buffer
+
+		inline bool IsValid() const { return Data != nullptr; }
+	};
+
+	// Ring of RegionCount equally sized regions of one GL buffer, one region per frame in flight,
+	// that producers of dynamic geometry write their vertices and instances into. Allocations are
+	// bump allocated from the frame's region. BeginFrame() puts a fence behind the previous frame's
+	// draws and waits for the fence of the region it moves on to, which the GPU finished RegionCount
+	// frames ago, so the wait is usually free and the writes never race the GPU's reads.
+	//
+	// The buffer changes when it grows, so producers point their vertex arrays at Buffer and Offset
+	// of every allocation. A frame whose allocations didn't fit drops them and the next BeginFrame()
+	// waits for the GPU and grows the regions to fit. GL thread only.
+	class StreamBuffer
+	{
+	public:
+		static constexpr uint32_t RegionCount = 3;
+
+		struct Statistics
+		{
+			uint64_t BytesStreamed = 0;
+			uint32_t Allocations = 0;
+			uint32_t Overflows = 0;		// allocations that didn't fit
+			uint32_t Stalls = 0;		// waits on a fence that wasn't signaled yet
+			double StallTime = 0.0;		// ms
+		};
+
+	public:
+		// Falls back to Unsynchronized when buffer storage isn't available.
+		StreamBuffer(size_t regionSize, StreamMode mode = StreamMode::Persistent);
+		~StreamBuffer();
+
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+		// Starts the next region and resets the statistics.
+		void BeginFrame();
+		// alignment must be a power of two
+		StreamAllocation Allocate(size_t size, size_t alignment = 16);
+		// Makes the writes visible to GL; before the frame's draws are issued.
+		void EndFrame();
+
+		inline StreamMode GetMode() const { return m_Mode; }
+		inline size_t GetRegionSize() const { return m_RegionSize; }
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+		static const char* GetModeName(StreamMode mode);
+
+	private:
+		void Create();
+		void Destroy();
+		void Wait(uint32_t region);
+
+	private:
+		StreamMode m_Mode;
+		unsigned int m_Buffer = 0;
+		size_t m_RegionSize = 0;
+		uint8_t* m_Mapping = nullptr;		// the whole buffer when persistent, else the current region
+		void* m_Fences[RegionCount] = {};	// GLsync
+		uint32_t m_Region = RegionCount - 1;
+		size_t m_Used = 0;					// in the current region
+		size_t m_Requested = 0;				// including what didn't fit
+		bool m_InFrame = false;
+
+		Statistics m_Statistics;
+	};
+}
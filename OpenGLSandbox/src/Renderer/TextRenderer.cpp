@@ -0,0 +1,392 @@
+#include "TextRenderer.h"
+#include <glad/glad.h>
+#include "Utilities/UTF8.h"
+#include "Utilities/Profiler.h"
+#include "RenderState.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		inline uint32_t PackColor(const glm::vec4& color)
+		{
+			glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+			return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+		}
+	}
+
+	// retained ranges grow in powers of two so a label that changes length doesn't move every frame
+	static constexpr uint32_t MinTextBlockCapacity = 16;
+
+	TextRenderer::TextRenderer(Shader& shader, StreamBuffer& streamBuffer)
+		: m_Shader(shader), m_StreamBuffer(streamBuffer)
+	{
+		glGenVertexArrays(1, &m_VertexArray);
+		glGenVertexArrays(1, &m_RetainedVertexArray);
+		glGenBuffers(1, &m_RetainedBuffer);
+
+		// each buffer gets its own vertex array, so drawing either one is a plain draw packet;
+		// reallocating a buffer's storage keeps its name, the attribute pointers stay valid. The
+		// immediate one is pointed at its stream buffer allocation every frame.
+		SetupVertexArray(m_RetainedVertexArray, m_RetainedBuffer);
+	}
+
+	TextRenderer::~TextRenderer()
+	{
+		for (TextBlock& block : m_TextBlocks)
+			if (block.Alive)
+				ReleaseGlyphs(block);
+
+		RenderState::DeleteBuffer(m_RetainedBuffer);
+		RenderState::DeleteVertexArray(m_VertexArray);
+		RenderState::DeleteVertexArray(m_RetainedVertexArray);
+	}
+
+	void TextRenderer::SetGlyphCache(GlyphCache& glyphCache)
+	{
+		m_GlyphCache = &glyphCache;
+	}
+
+	static constexpr uint64_t TextUniform = Hash::FNV1a("text");
+	static constexpr uint64_t GlyphsUniform = Hash::FNV1a("u_Glyphs");
+
+	void TextRenderer::Begin()
+	{
+		m_Instances.clear();
+		m_Statistics = Statistics();
+		if (m_GlyphCache)
+			m_GlyphCache->BeginFrame();
+	}
+
+	void TextRenderer::DrawText(std::string_view text, float x, float y, float scale, const glm::vec3& color)
+	{
+		PROFILE_SCOPE("Text Layout");
+		float glyphScale = ResolveGlyphs(text, scale, m_Slots);
+		AppendInstances(m_Slots, glm::vec2(x, y), glyphScale, Utils::PackColor(glm::vec4(color, 1.0f)), m_Instances);
+	}
+
+	float TextRenderer::ResolveGlyphs(std::string_view text, float scale, std::vector<uint32_t>& slots)
+	{
+		slots.clear();
+		if (!m_GlyphCache || m_GlyphCache->GetPixelSizes().empty())
+			return 0.0f;
+
+		// scale 1 is the largest rasterized size; pick the closest size at or above the requested one
+		// so small text is sampled from a small bitmap instead of minified from the large one
+		const std::vector<unsigned int>& pixelSizes = m_GlyphCache->GetPixelSizes();
+		float pixelSize = pixelSizes.back() * scale;
+		size_t sizeIndex = m_GlyphCache->FindPixelSize(pixelSize);
+
+		// resolve every glyph first, rasterizing misses, so the layout loop only reads the
+		// metric arrays and never calls back into the cache
+		const char* it = text.data();
+		const char* end = it + text.size();
+		while (it < end)
+		{
+			uint32_t slot = m_GlyphCache->Get(UTF8::Next(it, end), sizeIndex);
+			if (slot != GlyphCache::InvalidSlot)
+				slots.push_back(slot);
+		}
+		return pixelSize / pixelSizes[sizeIndex];
+	}
+
+	void TextRenderer::AppendInstances(const std::vector<uint32_t>& slots, const glm::vec2& origin, float glyphScale, uint32_t color, std::vector<GlyphInstance>& instances) const
+	{
+		if (slots.empty())
+			return;
+
+		const GlyphMetrics& metrics = m_GlyphCache->GetMetrics();
+		glm::vec2 pen = origin;
+		for (uint32_t slot : slots)
+		{
+			if (metrics.Sizes[slot].x > 0 && metrics.Sizes[slot].y > 0)
+				instances.push_back({ pen, glyphScale, slot, color });
+			pen.x += metrics.Advances[slot] * glyphScale;
+		}
+	}
+
+	void TextRenderer::End(RenderQueue::CommandBuffer& commands)
+	{
+		PROFILE_SCOPE("Text Submit");
+		m_Changed.store(false, std::memory_order_relaxed);
+		if (!m_GlyphCache)
+			return;
+
+		UpdateTextBlocks();
+		uint32_t retainedCount = (uint32_t)m_RetainedInstances.size();
+		if (m_Instances.empty() && retainedCount == 0)
+			return;
+
+		// glyphs rasterized this frame are in the texture already, their metrics are uploaded here
+		m_GlyphCache->Flush();
+
+		// corners come from gl_VertexID, every glyph is an instance
+		DrawCommand command;
+		command.Program = &m_Shader;
+		command.Mode = GL_TRIANGLE_STRIP;
+		command.Count = 4;
+		command.Textures[0] = { GL_TEXTURE_2D_ARRAY, m_GlyphCache->GetTextureID() };
+		command.Textures[1] = { GL_TEXTURE_BUFFER, m_GlyphCache->GetGlyphTableTextureID() };
+
+		if (retainedCount) {
+			command.VertexArray = m_RetainedVertexArray;
+			command.InstanceCount = retainedCount;
+			RecordDraw(commands, command);
+			m_Statistics.RetainedGlyphs = retainedCount - m_RetainedUnused;
+		}
+
+		if (!m_Instances.empty()) {
+			// one allocation per frame, from a region the GPU is done with
+			size_t size = m_Instances.size() * sizeof(GlyphInstance);
+			StreamAllocation allocation = m_StreamBuffer.Allocate(size);
+			if (!allocation.IsValid())
+				return;
+			memcpy(allocation.Data, m_Instances.data(), size);
+			SetupVertexArray(m_VertexArray, allocation.Buffer, allocation.Offset);
+			m_Statistics.BytesUploaded += size;
+			m_Statistics.Glyphs += (uint32_t)m_Instances.size();
+
+			command.VertexArray = m_VertexArray;
+			command.InstanceCount = (uint32_t)m_Instances.size();
+			RecordDraw(commands, command);
+		}
+	}
+
+	void TextRenderer::SetupVertexArray(unsigned int vertexArray, unsigned int buffer, size_t offset)
+	{
+		RenderState::BindVertexArray(vertexArray);
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribDivisor(0, 1);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)(offset + offsetof(GlyphInstance, Position)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribDivisor(1, 1);
+		glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(GlyphInstance), (void*)(offset + offsetof(GlyphInstance, GlyphIndex)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribDivisor(2, 1);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void*)(offset + offsetof(GlyphInstance, Color)));
+	}
+
+	void TextRenderer::RecordDraw(RenderQueue::CommandBuffer& commands, const DrawCommand& command)
+	{
+		// the projection comes from the Frame uniform block
+		commands.Draw(RenderQueue::MakeKey(RenderLayer::Overlay, command), command);
+		commands.SetUniform1i(TextUniform, 0);
+		commands.SetUniform1i(GlyphsUniform, 1);
+		m_Statistics.DrawCalls++;
+	}
+
+	//////////////////////////////////////////// Retained ////////////////////////////////////////////
+
+	TextBlockHandle TextRenderer::CreateTextBlock(std::string_view text, const glm::vec2& position, float scale, const glm::vec3& color)
+	{
+		uint32_t index;
+		if (!m_FreeTextBlocks.empty()) {
+			index = m_FreeTextBlocks.back();
+			m_FreeTextBlocks.pop_back();
+		}
+		else {
+			index = (uint32_t)m_TextBlocks.size();
+			m_TextBlocks.emplace_back();
+		}
+
+		TextBlock& block = m_TextBlocks[index];
+		uint32_t generation = block.Generation;
+		block = TextBlock();
+		block.Generation = generation;
+		block.Text = text;
+		block.Position = position;
+		block.Scale = scale;
+		block.Color = color;
+		block.Alive = true;
+		block.GlyphsDirty = true;
+		MarkDirty(block, index);
+		return { index, generation };
+	}
+
+	void TextRenderer::DestroyTextBlock(TextBlockHandle& handle)
+	{
+		TextBlock* block = GetTextBlock(handle);
+		if (!block)
+			return;
+
+		ReleaseGlyphs(*block);
+		FreeRange(*block);
+		block->Alive = false;
+		block->Generation++;
+		m_Changed.store(true, std::memory_order_relaxed);
+		m_FreeTextBlocks.push_back(handle.Index);
+		handle = TextBlockHandle();
+	}
+
+	void TextRenderer::SetText(TextBlockHandle handle, std::string_view text)
+	{
+		TextBlock* block = GetTextBlock(handle);
+		if (!block || block->Text == text)
+			return;
+
+		block->Text = text;
+		block->GlyphsDirty = true;
+		MarkDirty(*block, handle.Index);
+	}
+
+	void TextRenderer::SetPosition(TextBlockHandle handle, const glm::vec2& position)
+	{
+		TextBlock* block = GetTextBlock(handle);
+		if (!block || block->Position == position)
+			return;
+
+		block->Position = position;
+		MarkDirty(*block, handle.Index);
+	}
+
+	void TextRenderer::SetScale(TextBlockHandle handle, float scale)
+	{
+		TextBlock* block = GetTextBlock(handle);
+		if (!block || block->Scale == scale)
+			return;
+
+		// a new scale may pick another rasterized size
+		block->Scale = scale;
+		block->GlyphsDirty = true;
+		MarkDirty(*block, handle.Index);
+	}
+
+	void TextRenderer::SetColor(TextBlockHandle handle, const glm::vec3& color)
+	{
+		TextBlock* block = GetTextBlock(handle);
+		if (!block || block->Color == color)
+			return;
+
+		block->Color = color;
+		MarkDirty(*block, handle.Index);
+	}
+
+	TextRenderer::TextBlock* TextRenderer::GetTextBlock(TextBlockHandle handle)
+	{
+		if (handle.Index >= m_TextBlocks.size())
+			return nullptr;
+		TextBlock& block = m_TextBlocks[handle.Index];
+		return block.Alive && block.Generation == handle.Generation ? &block : nullptr;
+	}
+
+	void TextRenderer::MarkDirty(TextBlock& block, uint32_t index)
+	{
+		m_Changed.store(true, std::memory_order_relaxed);
+		if (block.Dirty)
+			return;
+		block.Dirty = true;
+		m_DirtyTextBlocks.push_back(index);
+	}
+
+	void TextRenderer::ReleaseGlyphs(TextBlock& block)
+	{
+		if (m_GlyphCache)
+			for (uint32_t slot : block.Slots)
+				m_GlyphCache->Release(slot);
+		block.Slots.clear();
+	}
+
+	void TextRenderer::FreeRange(TextBlock& block)
+	{
+		// the range stays in the buffer as zero scale instances until the next compaction
+		std::fill(m_RetainedInstances.begin() + block.Offset, m_RetainedInstances.begin() + block.Offset + block.Count, GlyphInstance());
+		m_RetainedDirtyBegin = std::min(m_RetainedDirtyBegin, block.Offset);
+		m_RetainedDirtyEnd = std::max(m_RetainedDirtyEnd, block.Offset + block.Count);
+		m_RetainedUnused += block.Count;
+		block.Offset = block.Capacity = block.Count = 0;
+	}
+
+	void TextRenderer::UpdateTextBlocks()
+	{
+		PROFILE_SCOPE("Text Layout");
+		for (uint32_t index : m_DirtyTextBlocks)
+		{
+			TextBlock& block = m_TextBlocks[index];
+			if (!block.Alive || !block.Dirty)
+				continue;
+			block.Dirty = false;
+
+			if (block.GlyphsDirty) {
+				// pin the new glyphs before unpinning the old ones, most of them are usually shared
+				std::vector<uint32_t> slots;
+				block.GlyphScale = ResolveGlyphs(block.Text, block.Scale, slots);
+				for (uint32_t slot : slots)
+					m_GlyphCache->Acquire(slot);
+				ReleaseGlyphs(block);
+				block.Slots = std::move(slots);
+				block.GlyphsDirty = false;
+				m_Statistics.Relayouts++;
+			}
+
+			m_Scratch.clear();
+			AppendInstances(block.Slots, block.Position, block.GlyphScale, Utils::PackColor(glm::vec4(block.Color, 1.0f)), m_Scratch);
+			uint32_t count = (uint32_t)m_Scratch.size();
+
+			if (count > block.Capacity) {
+				FreeRange(block);
+				block.Capacity = MinTextBlockCapacity;
+				while (block.Capacity < count)
+					block.Capacity *= 2;
+				block.Offset = (uint32_t)m_RetainedInstances.size();
+				m_RetainedInstances.resize(m_RetainedInstances.size() + block.Capacity);
+				m_RetainedUnused += block.Capacity;
+			}
+
+			// rewrite the block's range, clearing instances left over from a longer string
+			uint32_t end = block.Offset + std::max(count, block.Count);
+			std::copy(m_Scratch.begin(), m_Scratch.end(), m_RetainedInstances.begin() + block.Offset);
+			std::fill(m_RetainedInstances.begin() + block.Offset + count, m_RetainedInstances.begin() + end, GlyphInstance());
+			m_RetainedDirtyBegin = std::min(m_RetainedDirtyBegin, block.Offset);
+			m_RetainedDirtyEnd = std::max(m_RetainedDirtyEnd, end);
+			m_RetainedUnused = m_RetainedUnused + block.Count - count;
+			block.Count = count;
+		}
+		m_DirtyTextBlocks.clear();
+
+		if (m_RetainedUnused > 1024 && m_RetainedUnused * 2 > m_RetainedInstances.size())
+			CompactRetainedBuffer();
+
+		if (m_RetainedInstances.empty() || (!m_RetainedBufferStale && m_RetainedDirtyBegin >= m_RetainedDirtyEnd))
+			return;
+
+		RenderState::BindBuffer(GL_ARRAY_BUFFER, m_RetainedBuffer);
+		if (m_RetainedInstances.size() > m_RetainedBufferCapacity) {
+			m_RetainedBufferCapacity = std::max(m_RetainedInstances.size(), m_RetainedBufferCapacity * 2);
+			glBufferData(GL_ARRAY_BUFFER, m_RetainedBufferCapacity * sizeof(GlyphInstance), nullptr, GL_DYNAMIC_DRAW);
+			m_RetainedBufferStale = true;
+		}
+
+		// only the ranges of blocks that changed are uploaded
+		size_t first = m_RetainedBufferStale ? 0 : m_RetainedDirtyBegin;
+		size_t last = m_RetainedBufferStale ? m_RetainedInstances.size() : m_RetainedDirtyEnd;
+		glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(GlyphInstance), (last - first) * sizeof(GlyphInstance), &m_RetainedInstances[first]);
+		m_Statistics.BytesUploaded += (last - first) * sizeof(GlyphInstance);
+
+		m_RetainedBufferStale = false;
+		m_RetainedDirtyBegin = UINT32_MAX;
+		m_RetainedDirtyEnd = 0;
+	}
+
+	void TextRenderer::CompactRetainedBuffer()
+	{
+		std::vector<GlyphInstance> compacted;
+		compacted.reserve(m_RetainedInstances.size() - m_RetainedUnused);
+		for (TextBlock& block : m_TextBlocks)
+		{
+			if (!block.Alive)
+				continue;
+			uint32_t offset = (uint32_t)compacted.size();
+			compacted.insert(compacted.end(), m_RetainedInstances.begin() + block.Offset, m_RetainedInstances.begin() + block.Offset + block.Count);
+			block.Offset = offset;
+			block.Capacity = block.Count;
+		}
+
+		m_RetainedInstances.swap(compacted);
+		m_RetainedUnused = 0;
+		m_RetainedBufferStale = true;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Utilities/Shader.h"
+#include "GlyphCache.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+namespace OpenGLSandbox {
+
+	struct TextBlockHandle
+	{
+		uint32_t Index = UINT32_MAX;
+		uint32_t Generation = 0;
+
+		inline bool IsValid() const { return Index != UINT32_MAX; }
+	};
+
+	// Batches text into compact per-glyph instances that the vertex shader expands into quads.
+	// Every glyph lives in the glyph cache's texture array, so everything queued between Begin()
+	// and End() is uploaded once and drawn with a single instanced draw call. The draws go into a
+	// render queue's overlay layer.
+	//
+	// Text that rarely changes should be a retained text block instead: its layout and instances
+	// stay on the GPU and are only rebuilt when the block's string or style changes, so drawing
+	// any number of unchanged blocks costs one draw call and no upload.
+	class TextRenderer
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t DrawCalls = 0;
+			uint32_t Glyphs = 0;
+			uint32_t RetainedGlyphs = 0;
+			uint32_t Relayouts = 0;	// retained blocks laid out again this frame
+			uint64_t BytesUploaded = 0;
+		};
+
+	public:
+		// The immediate text's instances are allocated from the stream buffer, see End().
+		TextRenderer(Shader& shader, StreamBuffer& streamBuffer);
+		~TextRenderer();
+
+		// The cache must outlive the renderer.
+		void SetGlyphCache(GlyphCache& glyphCache);
+
+		// The shader reads its projection from the Frame uniform block.
+		void Begin();
+		// text is UTF-8
+		void DrawText(std::string_view text, float x, float y, float scale, const glm::vec3& color);
+		// Uploads the instances and records the draws of all retained text blocks and the text queued
+		// since Begin(). GL thread only, after the frame's last DrawText() and within the stream
+		// buffer's frame.
+		void End(RenderQueue::CommandBuffer& commands);
+
+		TextBlockHandle CreateTextBlock(std::string_view text, const glm::vec2& position, float scale, const glm::vec3& color);
+		void DestroyTextBlock(TextBlockHandle& handle);
+		// Setters are no-ops when the value doesn't change.
+		void SetText(TextBlockHandle handle, std::string_view text);
+		void SetPosition(TextBlockHandle handle, const glm::vec2& position);
+		void SetScale(TextBlockHandle handle, float scale);
+		void SetColor(TextBlockHandle handle, const glm::vec3& color);
+
+		// A text block changed since the last End(), so the next frame doesn't look like the last one.
+		// Any thread.
+		inline bool IsDirty() const { return m_Changed.load(std::memory_order_relaxed); }
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		struct GlyphInstance
+		{
+			glm::vec2 Position;	// pen position on the baseline
+			float Scale;
+			uint32_t GlyphIndex;
+			uint32_t Color;		// RGBA8
+		};
+
+		struct TextBlock
+		{
+			std::string Text;
+			glm::vec2 Position = glm::vec2(0.0f);
+			float Scale = 1.0f;
+			glm::vec3 Color = glm::vec3(1.0f);
+
+			std::vector<uint32_t> Slots;	// pinned in the glyph cache while the block lives
+			float GlyphScale = 1.0f;
+
+			// instance range in the retained buffer; unused instances have zero scale
+			uint32_t Offset = 0;
+			uint32_t Capacity = 0;
+			uint32_t Count = 0;
+
+			uint32_t Generation = 0;
+			bool Alive = false;
+			bool GlyphsDirty = false;		// string or size changed, glyphs need resolving again
+			bool Dirty = false;				// instances need rewriting
+		};
+
+		float ResolveGlyphs(std::string_view text, float scale, std::vector<uint32_t>& slots);
+		void AppendInstances(const std::vector<uint32_t>& slots, const glm::vec2& origin, float glyphScale, uint32_t color, std::vector<GlyphInstance>& instances) const;
+
+		TextBlock* GetTextBlock(TextBlockHandle handle);
+		void MarkDirty(TextBlock& block, uint32_t index);
+		void ReleaseGlyphs(TextBlock& block);
+		void FreeRange(TextBlock& block);
+		void UpdateTextBlocks();
+		void CompactRetainedBuffer();
+		void SetupVertexArray(unsigned int vertexArray, unsigned int buffer, size_t offset = 0);
+		void RecordDraw(RenderQueue::CommandBuffer& commands, const DrawCommand& command);
+
+	private:
+		Shader& m_Shader;
+		StreamBuffer& m_StreamBuffer;
+
+		unsigned int m_VertexArray = 0;			// reads the frame's stream buffer allocation
+		unsigned int m_RetainedVertexArray = 0;	// reads m_RetainedBuffer
+
+		GlyphCache* m_GlyphCache = nullptr;
+		std::vector<GlyphInstance> m_Instances;
+		std::vector<uint32_t> m_Slots;
+
+		// retained text: one GPU buffer with a CPU copy, each block owns a range of it
+		std::vector<TextBlock> m_TextBlocks;
+		std::vector<uint32_t> m_FreeTextBlocks;
+		std::vector<uint32_t> m_DirtyTextBlocks;
+		std::vector<GlyphInstance> m_RetainedInstances;
+		std::vector<GlyphInstance> m_Scratch;
+		uint32_t m_RetainedUnused = 0;	// instances in the buffer that no block's glyph occupies
+		unsigned int m_RetainedBuffer = 0;
+		size_t m_RetainedBufferCapacity = 0;	// in instances
+		bool m_RetainedBufferStale = false;		// buffer has to be uploaded as a whole
+		uint32_t m_RetainedDirtyBegin = UINT32_MAX, m_RetainedDirtyEnd = 0;
+		std::atomic<bool> m_Changed{ false };	// read by the thread that paces the frames
+
+		Statistics m_Statistics;
+	};
+}
@@ -0,0 +1,279 @@
+#include "TextureStreamer.h"
+#include "RenderState.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include "stb_image.h"
+#include "Utilities/FileSystem.h"
+#include "Utilities/Profiler.h"
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static double Milliseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+
+		static void SetTextureImage(GLenum target, int width, int height, const void* pixels)
+		{
+			if (target == GL_TEXTURE_2D_ARRAY)
+				glTexImage3D(target, 0, GL_RGBA8, width, height, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+			else
+				glTexImage2D(target, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+	}
+
+	TextureStreamer::TextureStreamer(const TextureStreamerSpecification& specification)
+		: m_Specification(specification)
+	{
+		// a grey checker board, so what is still loading stands out without flashing
+		const int size = 8;
+		uint32_t pixels[size * size];
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+				pixels[y * size + x] = ((x / 4 + y / 4) & 1) ? 0xFF9A9A9Au : 0xFF6E6E6Eu;
+		}
+
+		GLenum target = m_Specification.Target;
+		glGenTextures(1, &m_Placeholder);
+		RenderState::BindTexture(0, target, m_Placeholder);
+		Utils::SetTextureImage(target, size, size, pixels);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		// drivers may build what generating mips takes on first use, which would otherwise stall the
+		// frame the first texture completes in
+		if (m_Specification.GenerateMips)
+			glGenerateMipmap(target);
+
+		m_PixelBuffer = std::make_unique<StreamBuffer>(std::max<size_t>(m_Specification.UploadBudget, 1 << 16), m_Specification.PixelBufferMode);
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		for (Request* request : m_Pending)
+		{
+			// a decode still running writes into the request
+			if (request->Status.load(std::memory_order_acquire) == State::Decoding)
+				JobSystem::Wait(request->DecodeJob);
+			stbi_image_free(request->Pixels);
+		}
+		for (const std::unique_ptr<Request>& request : m_Requests)
+		{
+			if (request->Texture)
+				RenderState::DeleteTexture(request->Texture);
+		}
+		RenderState::DeleteTexture(m_Placeholder);
+	}
+
+	TextureHandle TextureStreamer::Load(const std::string& filepath)
+	{
+		TextureHandle handle;
+		handle.Index = (uint32_t)m_Requests.size();
+		Request& request = *m_Requests.emplace_back(std::make_unique<Request>());
+		request.Filepath = filepath;
+		m_Pending.push_back(&request);
+		m_Streaming.store(true, std::memory_order_relaxed);
+		m_Statistics.Requested++;
+		return handle;
+	}
+
+	void TextureStreamer::Update()
+	{
+		m_Statistics.BytesUploaded = 0;
+		m_Statistics.Completed = 0;
+		if (m_Pending.empty())
+			return;
+		PROFILE_SCOPE("Texture Streaming");
+
+		// decode
+		// ------
+		// in the order the textures were requested, a few at a time
+		bool jobs = JobSystem::GetThreadCount() > 1;
+		uint32_t maxDecodes = m_Specification.MaxDecodes ? m_Specification.MaxDecodes : JobSystem::GetThreadCount() - 1;
+		uint32_t decoding = 0;
+		for (Request* request : m_Pending)
+		{
+			if (request->Status.load(std::memory_order_relaxed) == State::Decoding)
+				decoding++;
+		}
+		std::chrono::steady_clock::time_point decodeStart = std::chrono::steady_clock::now();
+		for (Request* request : m_Pending)
+		{
+			if (request->Status.load(std::memory_order_relaxed) != State::Queued)
+				continue;
+			if (jobs) {
+				if (decoding >= maxDecodes)
+					break;
+				request->Status.store(State::Decoding, std::memory_order_relaxed);
+				request->DecodeJob = JobSystem::Create([request]() { Decode(*request); });
+				JobSystem::Run(request->DecodeJob);
+				decoding++;
+			}
+			else {
+				// at least one a frame, however long it takes
+				if (Utils::Milliseconds(std::chrono::steady_clock::now() - decodeStart) >= m_Specification.InlineDecodeBudget)
+					break;
+				Decode(*request);
+			}
+		}
+
+		// stage
+		// -----
+		// images that finished decoding may overtake one that didn't; a row that is larger than the
+		// budget goes alone
+		size_t budget = m_Specification.UploadBudget;
+		m_Bands.clear();
+		for (Request* request : m_Pending)
+		{
+			if (!budget)
+				break;
+			if (request->Status.load(std::memory_order_acquire) != State::Decoded)
+				continue;
+			size_t rowSize = (size_t)request->Width * 4;
+			if (rowSize > budget && !m_Bands.empty())
+				break;
+
+			if (m_Bands.empty())
+				m_PixelBuffer->BeginFrame();
+			if (!request->Texture)
+				CreateTexture(*request);
+
+			int rows = std::min(request->Height - request->UploadedRows, (int)std::max<size_t>(budget / rowSize, 1));
+			StreamAllocation allocation = m_PixelBuffer->Allocate(rows * rowSize, 4);
+			// the next frame's BeginFrame() grows the regions to fit
+			if (!allocation.IsValid())
+				break;
+			// GL's rows go bottom up
+			for (int row = 0; row < rows; row++)
+			{
+				int sourceRow = request->Height - 1 - (request->UploadedRows + row);
+				memcpy((unsigned char*)allocation.Data + row * rowSize, request->Pixels + sourceRow * rowSize, rowSize);
+			}
+
+			m_Bands.push_back({ request, request->UploadedRows, rows, allocation.Buffer, allocation.Offset });
+			request->UploadedRows += rows;
+			budget -= std::min(budget, rows * rowSize);
+			m_Statistics.BytesUploaded += rows * rowSize;
+		}
+
+		// upload
+		// ------
+		if (!m_Bands.empty()) {
+			m_PixelBuffer->EndFrame();
+			GLenum target = m_Specification.Target;
+			for (const Band& band : m_Bands)
+			{
+				Request& request = *band.Source;
+				// with a pixel unpack buffer bound, the pointer is an offset into it
+				RenderState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, band.Buffer);
+				RenderState::BindTexture(0, target, request.Texture);
+				const void* offset = (const void*)band.Offset;
+				if (target == GL_TEXTURE_2D_ARRAY)
+					glTexSubImage3D(target, 0, 0, band.Row, 0, request.Width, band.Rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+				else
+					glTexSubImage2D(target, 0, 0, band.Row, request.Width, band.Rows, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+				if (request.UploadedRows == request.Height)
+					Finish(request, true);
+			}
+			// every other upload reads from client memory
+			RenderState::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+
+		for (Request* request : m_Pending)
+		{
+			if (request->Status.load(std::memory_order_acquire) == State::Failed)
+				Finish(*request, false);
+		}
+		m_Pending.erase(std::remove_if(m_Pending.begin(), m_Pending.end(), [](const Request* request)
+		{
+			State state = request->Status.load(std::memory_order_relaxed);
+			return state == State::Resident || state == State::Failed;
+		}), m_Pending.end());
+		m_Streaming.store(!m_Pending.empty(), std::memory_order_relaxed);
+	}
+
+	void TextureStreamer::DecodeAll()
+	{
+		PROFILE_SCOPE("Texture Decode All");
+		bool jobs = JobSystem::GetThreadCount() > 1;
+		for (Request* request : m_Pending)
+		{
+			if (request->Status.load(std::memory_order_relaxed) != State::Queued)
+				continue;
+			if (jobs) {
+				request->Status.store(State::Decoding, std::memory_order_relaxed);
+				request->DecodeJob = JobSystem::Create([request]() { Decode(*request); });
+				JobSystem::Run(request->DecodeJob);
+			}
+			else
+				Decode(*request);
+		}
+		for (Request* request : m_Pending)
+		{
+			if (request->Status.load(std::memory_order_acquire) == State::Decoding)
+				JobSystem::Wait(request->DecodeJob);
+		}
+	}
+
+	unsigned int TextureStreamer::GetTexture(TextureHandle handle) const
+	{
+		return IsResident(handle) ? m_Requests[handle.Index]->Texture : m_Placeholder;
+	}
+
+	bool TextureStreamer::IsResident(TextureHandle handle) const
+	{
+		return handle.Index < m_Requests.size() && m_Requests[handle.Index]->Status.load(std::memory_order_relaxed) == State::Resident;
+	}
+
+	void TextureStreamer::Decode(Request& request)
+	{
+		PROFILE_SCOPE("Texture Decode");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		FileView file = FileSystem::Read(request.Filepath);
+		int channels = 0;
+		if (file && file.Size <= INT_MAX)
+			request.Pixels = stbi_load_from_memory(file.Data, (int)file.Size, &request.Width, &request.Height, &channels, 4);
+		request.DecodeTime = Utils::Milliseconds(std::chrono::steady_clock::now() - start);
+		request.Status.store(request.Pixels ? State::Decoded : State::Failed, std::memory_order_release);
+	}
+
+	void TextureStreamer::CreateTexture(Request& request)
+	{
+		GLenum target = m_Specification.Target;
+		// storage for the top level only, the mips are generated once it is complete
+		glGenTextures(1, &request.Texture);
+		RenderState::BindTexture(0, target, request.Texture);
+		Utils::SetTextureImage(target, request.Width, request.Height, nullptr);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, m_Specification.GenerateMips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+
+	void TextureStreamer::Finish(Request& request, bool resident)
+	{
+		m_Statistics.DecodeTime += request.DecodeTime;
+		request.DecodeJob = nullptr;
+		stbi_image_free(request.Pixels);
+		request.Pixels = nullptr;
+		if (!resident) {
+			std::cout << "TextureStreamer: failed to load " << request.Filepath << std::endl;
+			m_Statistics.Failed++;
+			return;
+		}
+
+		if (m_Specification.GenerateMips)
+			glGenerateMipmap(m_Specification.Target);
+		request.Status.store(State::Resident, std::memory_order_relaxed);
+		m_Statistics.Resident++;
+		m_Statistics.Completed++;
+	}
+}
\ No newline at end of file
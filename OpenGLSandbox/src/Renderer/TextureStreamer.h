@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "StreamBuffer.h"
+#include "Utilities/JobSystem.h"
+
+namespace OpenGLSandbox {
+
+	struct TextureHandle
+	{
+		uint32_t Index = UINT32_MAX;
+
+		inline bool IsValid() const { return Index != UINT32_MAX; }
+	};
+
+	struct TextureStreamerSpecification
+	{
+		// GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for one layer textures the quad renderer can draw
+		unsigned int Target = 0x0DE1;	// GL_TEXTURE_2D
+		size_t UploadBudget = 4 << 20;	// bytes copied into the pixel buffers per Update()
+		bool GenerateMips = true;
+		// decode jobs at a time, 0 for one per worker; few enough that a thread waiting on its own
+		// jobs rarely picks one up
+		uint32_t MaxDecodes = 0;
+		// ms spent decoding per Update() when there are no worker threads to decode on
+		double InlineDecodeBudget = 2.0;
+		StreamMode PixelBufferMode = StreamMode::Persistent;
+	};
+
+	// Loads PNG and JPG textures without stalling the frame. Load() only queues the file; Update(),
+	// once per frame, starts decode jobs for the queue in order and copies the rows of decoded images
+	// into a ring of pixel unpack buffers, at most UploadBudget bytes a frame, which GL pulls the
+	// texels from. A large image is uploaded in bands over several frames and its mips are generated
+	// after the last band.
+	//
+	// Until all of it arrived, GetTexture() returns a placeholder, so a draw can always bind what it
+	// returns and picks the real texture up in the first frame it is complete.
+	//
+	// Without workers it decodes the queued images itself, for at most InlineDecodeBudget a frame.
+	// GL thread only, which may be a render thread outside the job system.
+	class TextureStreamer
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t Requested = 0;
+			uint32_t Resident = 0;
+			uint32_t Failed = 0;
+			// of the last Update()
+			uint64_t BytesUploaded = 0;
+			uint32_t Completed = 0;
+			double DecodeTime = 0.0;	// ms, summed over every decode so far
+		};
+
+	public:
+		TextureStreamer(const TextureStreamerSpecification& specification = TextureStreamerSpecification());
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		TextureHandle Load(const std::string& filepath);
+		// Before the frame's draws are recorded.
+		void Update();
+		// Decodes every queued image, blocking until they are done, so which frame a texture becomes
+		// resident in only depends on the upload budget and not on how long the decodes took.
+		void DecodeAll();
+
+		// the placeholder until the texture is resident, also when it failed to load
+		unsigned int GetTexture(TextureHandle handle) const;
+		bool IsResident(TextureHandle handle) const;
+		inline unsigned int GetPlaceholder() const { return m_Placeholder; }
+		inline bool IsIdle() const { return m_Pending.empty(); }
+		// Textures are still on their way, which only Update() moves on, and the frame one completes
+		// in looks different. Any thread.
+		inline bool IsDirty() const { return m_Streaming.load(std::memory_order_relaxed); }
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+	private:
+		enum class State : uint32_t
+		{
+			Queued, Decoding, Decoded, Resident, Failed
+		};
+
+		struct Request
+		{
+			std::string Filepath;
+			std::atomic<State> Status{ State::Queued };
+			// written by the decode, read after it published Decoded
+			unsigned char* Pixels = nullptr;	// RGBA, top row first
+			int Width = 0, Height = 0;
+			double DecodeTime = 0.0;
+			// next row to upload, counted from the bottom as GL does
+			int UploadedRows = 0;
+			unsigned int Texture = 0;
+			JobSystem::Job* DecodeJob = nullptr;
+		};
+
+		// rows of a request staged in the pixel buffer
+		struct Band
+		{
+			Request* Source;
+			int Row, Rows;
+			unsigned int Buffer;
+			size_t Offset;
+		};
+
+		static void Decode(Request& request);
+		void CreateTexture(Request& request);
+		void Finish(Request& request, bool resident);
+
+	private:
+		TextureStreamerSpecification m_Specification;
+		std::vector<std::unique_ptr<Request>> m_Requests;
+		// in the order they were requested, until resident or failed
+		std::vector<Request*> m_Pending;
+		unsigned int m_Placeholder = 0;
+		std::unique_ptr<StreamBuffer> m_PixelBuffer;
+		std::vector<Band> m_Bands;	// of the current Update()
+		std::atomic<bool> m_Streaming{ false };	// !m_Pending.empty(), for other threads
+
+		Statistics m_Statistics;
+	};
+}
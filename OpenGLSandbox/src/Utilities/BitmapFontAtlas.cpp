@@ -0,0 +1,135 @@
+#include "BitmapFontAtlas.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "FontLibrary.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+
+namespace OpenGLSandbox {
+
+	BitmapFontAtlas::BitmapFontAtlas(const BitmapFontSpecification& specification)
+		: m_Specification(specification)
+	{
+	}
+
+	BitmapFontAtlas::~BitmapFontAtlas()
+	{
+	}
+
+	bool BitmapFontAtlas::Generate()
+	{
+		PROFILE_SCOPE("Bitmap Atlas");
+		m_Glyphs.clear();
+		m_Pixels.clear();
+		m_Width = m_Height = 0;
+
+		// sizes are rasterized smallest first, so glyphs of one size are contiguous and ordered
+		std::vector<unsigned int> pixelSizes = m_Specification.PixelSizes;
+		std::sort(pixelSizes.begin(), pixelSizes.end());
+		pixelSizes.erase(std::unique(pixelSizes.begin(), pixelSizes.end()), pixelSizes.end());
+
+		// every size is a job with its own face, tightly packed on its own and merged in size order
+		struct SizeGlyphs
+		{
+			std::vector<BitmapGlyph> Glyphs;
+			std::vector<unsigned char> Bitmaps;
+			std::vector<size_t> BitmapOffsets;
+			bool Loaded = false;
+		};
+		std::vector<SizeGlyphs> sizes(pixelSizes.size());
+		JobSystem::ParallelFor((uint32_t)pixelSizes.size(), [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				sizes[i].Loaded = Rasterize(pixelSizes[i], sizes[i].Glyphs, sizes[i].Bitmaps, sizes[i].BitmapOffsets);
+		}, 1);
+
+		// then every size is placed in one go
+		std::vector<unsigned char> bitmaps;
+		std::vector<size_t> bitmapOffsets;
+		std::vector<PackedRect> rects;
+		for (SizeGlyphs& size : sizes)
+		{
+			if (!size.Loaded) {
+				m_Glyphs.clear();
+				return false;
+			}
+			for (size_t i = 0; i < size.Glyphs.size(); i++)
+			{
+				const BitmapGlyph& glyph = size.Glyphs[i];
+				m_Glyphs.push_back(glyph);
+				bitmapOffsets.push_back(bitmaps.size() + size.BitmapOffsets[i]);
+
+				PackedRect rect;
+				rect.Width = glyph.Width;
+				rect.Height = glyph.Height;
+				rects.push_back(rect);
+			}
+			bitmaps.insert(bitmaps.end(), size.Bitmaps.begin(), size.Bitmaps.end());
+		}
+
+		RectPackerSpecification packing = m_Specification.Packing;
+		packing.AllowRotation = false;
+		if (!RectPacker::Pack(rects, packing, m_PackingReport)) {
+			std::cout << "ERROR::FREETYPE: Glyphs do not fit into a " << packing.MaxSize << " atlas" << std::endl;
+			m_Glyphs.clear();
+			return false;
+		}
+
+		m_Width = m_PackingReport.AtlasWidth;
+		m_Height = m_PackingReport.AtlasHeight;
+		m_Pixels.assign((size_t)m_Width * m_Height, 0);
+		for (size_t i = 0; i < m_Glyphs.size(); i++)
+		{
+			BitmapGlyph& glyph = m_Glyphs[i];
+			glyph.X = rects[i].X;
+			glyph.Y = rects[i].Y;
+			for (int row = 0; row < glyph.Height; row++)
+				memcpy(&m_Pixels[(size_t)(glyph.Y + row) * m_Width + glyph.X], &bitmaps[bitmapOffsets[i] + (size_t)row * glyph.Width], glyph.Width);
+		}
+		return true;
+	}
+
+	bool BitmapFontAtlas::Rasterize(unsigned int pixelSize, std::vector<BitmapGlyph>& glyphs, std::vector<unsigned char>& bitmaps, std::vector<size_t>& bitmapOffsets) const
+	{
+		PROFILE_SCOPE("Bitmap Glyphs");
+		// load font as face
+		FT_Face face = FontLibrary::OpenFace(m_Specification.FontFilepath);
+		if (!face)
+			return false;
+
+		// set size to load glyphs as
+		FT_Set_Pixel_Sizes(face, 0, pixelSize);
+
+		for (unsigned int c = m_Specification.FirstCharacter; c < m_Specification.LastCharacter; c++)
+		{
+			// Load character glyph 
+			if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+			{
+				std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+				continue;
+			}
+
+			const FT_Bitmap& bitmap = face->glyph->bitmap;
+			BitmapGlyph glyph = {
+				c, pixelSize,
+				(int32_t)bitmap.width, (int32_t)bitmap.rows,
+				face->glyph->bitmap_left, face->glyph->bitmap_top,
+				static_cast<uint32_t>(face->glyph->advance.x),
+				0, 0
+			};
+			glyphs.push_back(glyph);
+
+			// FreeType may pad its pitch
+			bitmapOffsets.push_back(bitmaps.size());
+			for (unsigned int row = 0; row < bitmap.rows; row++)
+				bitmaps.insert(bitmaps.end(), bitmap.buffer + row * bitmap.pitch, bitmap.buffer + row * bitmap.pitch + bitmap.width);
+		}
+
+		// close the face once we're finished
+		FontLibrary::CloseFace(face);
+		return true;
+	}
+}
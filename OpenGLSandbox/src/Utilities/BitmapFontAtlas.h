@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "RectPacker.h"
+
+namespace OpenGLSandbox {
+
+	struct BitmapFontSpecification
+	{
+		std::string FontFilepath;
+		std::vector<unsigned int> PixelSizes = { 24, 48 };	// every size shares the one atlas
+		unsigned int FirstCharacter = 0;
+		unsigned int LastCharacter = 128;	// exclusive
+		RectPackerSpecification Packing;
+	};
+
+	// Atlas placement and metrics of one glyph at one pixel size. Also the on-disk cache record.
+	struct BitmapGlyph
+	{
+		uint32_t Codepoint;
+		uint32_t PixelSize;
+		int32_t Width, Height;
+		int32_t BearingX, BearingY;
+		uint32_t Advance;	// in 1/64 pixels
+		int32_t X, Y;		// top-left of the glyph in the atlas
+	};
+
+	// Rasterizes a face with FreeType at several pixel sizes, one job per size, and packs every glyph
+	// into one R8 atlas.
+	class BitmapFontAtlas
+	{
+	public:
+		BitmapFontAtlas(const BitmapFontSpecification& specification);
+		~BitmapFontAtlas();
+
+		bool Generate();
+
+		inline const std::vector<BitmapGlyph>& GetGlyphs() const { return m_Glyphs; }
+		inline const std::vector<unsigned char>& GetPixels() const { return m_Pixels; }
+		inline int GetWidth() const { return m_Width; }
+		inline int GetHeight() const { return m_Height; }
+		inline const PackingReport& GetPackingReport() const { return m_PackingReport; }
+
+	private:
+		// every glyph of one size with its own face, bitmaps tightly packed
+		bool Rasterize(unsigned int pixelSize, std::vector<BitmapGlyph>& glyphs, std::vector<unsigned char>& bitmaps, std::vector<size_t>& bitmapOffsets) const;
+
+	private:
+		BitmapFontSpecification m_Specification;
+
+		std::vector<BitmapGlyph> m_Glyphs;
+		std::vector<unsigned char> m_Pixels;
+		int m_Width = 0;
+		int m_Height = 0;
+		PackingReport m_PackingReport;
+	};
+}
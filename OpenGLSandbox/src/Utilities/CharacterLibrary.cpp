@@ -13,16 +13,25 @@ namespace OpenGLSandbox {
 
 	void CharacterLibrary::Add(const unsigned char& name, const CharacterSDF& character)
 	{
-		m_Characters[name] = character;
+		uint32_t index = m_Lookup.Find(name);
+		if (index != GlyphLookupTable::InvalidIndex) {
+			m_Characters[index] = character;
+			return;
+		}
+
+		m_Lookup.Set(name, (uint32_t)m_Characters.size());
+		m_Characters.push_back(character);
 	}
 
-	const CharacterSDF& CharacterLibrary::Get(const unsigned char& name)
+	const CharacterSDF& CharacterLibrary::Get(const unsigned char& name) const
 	{
-		return m_Characters[name];
+		static const CharacterSDF empty = {};
+		uint32_t index = m_Lookup.Find(name);
+		return index != GlyphLookupTable::InvalidIndex ? m_Characters[index] : empty;
 	}
 
 	bool CharacterLibrary::Exists(const unsigned char& name) const
 	{
-		return m_Characters.find(name) != m_Characters.end();
+		return m_Lookup.Find(name) != GlyphLookupTable::InvalidIndex;
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <unordered_map>
+#include <vector>
+#include "GlyphLookupTable.h"
 
 namespace OpenGLSandbox {
 
@@ -26,8 +27,9 @@ namespace OpenGLSandbox {
 		CharacterLibrary();
 		~CharacterLibrary();
 
-		const CharacterSDF& Get(const unsigned char& name);
-		const int GetCount() { return (int)m_Characters.size(); }
+		// Returns an all-zero character for names that were never added.
+		const CharacterSDF& Get(const unsigned char& name) const;
+		int GetCount() const { return (int)m_Characters.size(); }
 		void Add(const unsigned char& name, const CharacterSDF& character);
 
 		bool Exists(const unsigned char& name) const;
@@ -41,6 +43,7 @@ namespace OpenGLSandbox {
 		bool Exists(const char& name) const;*/
 
 	private:
-		std::unordered_map<unsigned char, CharacterSDF> m_Characters;
+		GlyphLookupTable m_Lookup;
+		std::vector<CharacterSDF> m_Characters;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "FileSystem.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include "Hash.h"
+#include "MappedFile.h"
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static constexpr char ArchiveMagic[8] = { 'O', 'G', 'S', 'P', 'A', 'C', 'K', '\0' };
+
+		// header, entry table, path strings, then the files, each 16 byte aligned
+		struct ArchiveHeader
+		{
+			char Magic[8];
+			uint32_t Version;
+			uint32_t HeaderSize;
+			uint32_t EntryCount;
+			uint32_t EntrySize;
+			uint64_t TableSize;			// entries and path strings
+			uint64_t TableChecksum;
+			uint64_t FileSize;
+		};
+
+		struct ArchiveEntry
+		{
+			uint64_t PathHash;
+			uint64_t Offset;
+			uint64_t Size;
+			uint64_t Checksum;			// checked the first time the file is read
+			uint32_t PathOffset;		// from the start of the path strings
+			uint32_t PathLength;
+		};
+
+		inline uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + 15) & ~uint64_t(15);
+		}
+
+		static std::string NormalizePath(const std::string& filepath)
+		{
+			return std::filesystem::path(filepath).lexically_normal().generic_string();
+		}
+
+		struct ArchiveFile
+		{
+			const ArchiveEntry* Entry = nullptr;
+			std::string_view Path;
+			bool Verified = false;
+			bool Corrupt = false;
+		};
+
+		struct FileSystemState
+		{
+			std::mutex Mutex;
+			std::unordered_map<std::string, std::unique_ptr<MappedFile>> Files;
+			MappedFile Archive;
+			std::string ArchivePath;
+			std::unordered_map<uint64_t, ArchiveFile> ArchiveFiles;
+			FileSystem::Statistics Statistics;
+		};
+
+		static FileSystemState& GetState()
+		{
+			static FileSystemState state;
+			return state;
+		}
+
+		// caller holds the lock
+		static FileView ReadFromArchive(FileSystemState& state, const std::string& path)
+		{
+			auto it = state.ArchiveFiles.find(Hash::FNV1a(path));
+			if (it == state.ArchiveFiles.end() || it->second.Path != path)
+				return FileView();
+
+			ArchiveFile& file = it->second;
+			const unsigned char* data = state.Archive.GetData() + file.Entry->Offset;
+			if (!file.Verified) {
+				file.Verified = true;
+				file.Corrupt = Hash::Checksum(data, file.Entry->Size) != file.Entry->Checksum;
+				if (file.Corrupt)
+					std::cout << "FileSystem: " << path << " is corrupt in " << state.ArchivePath << ", reading it from disk" << std::endl;
+			}
+			if (file.Corrupt || file.Entry->Size == 0)
+				return FileView();
+
+			state.Statistics.ArchiveReads++;
+			return FileView{ data, (size_t)file.Entry->Size };
+		}
+	}
+
+	namespace FileSystem {
+
+		FileView Read(const std::string& filepath)
+		{
+			std::string path = Utils::NormalizePath(filepath);
+			Utils::FileSystemState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			if (!state.ArchiveFiles.empty())
+				if (FileView view = Utils::ReadFromArchive(state, path))
+					return view;
+
+			auto it = state.Files.find(path);
+			if (it == state.Files.end()) {
+				auto file = std::make_unique<MappedFile>();
+				if (!file->Open(path))
+					return FileView();
+				state.Statistics.FilesMapped++;
+				state.Statistics.BytesMapped += file->GetSize();
+				it = state.Files.emplace(path, std::move(file)).first;
+			}
+			return FileView{ it->second->GetData(), it->second->GetSize() };
+		}
+
+		bool WriteArchive(const std::string& directory, const std::string& archivePath)
+		{
+			std::error_code error;
+			std::vector<std::string> paths;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+				if (entry.is_regular_file())
+					paths.push_back(Utils::NormalizePath(entry.path().string()));
+			if (error)
+				return false;
+			// sorted, so the same assets always give the same archive
+			std::sort(paths.begin(), paths.end());
+
+			std::vector<Utils::ArchiveEntry> entries(paths.size());
+			std::string pathStrings;
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				entries[i].PathHash = Hash::FNV1a(paths[i]);
+				entries[i].PathOffset = (uint32_t)pathStrings.size();
+				entries[i].PathLength = (uint32_t)paths[i].size();
+				pathStrings += paths[i];
+			}
+
+			Utils::ArchiveHeader header = {};
+			memcpy(header.Magic, Utils::ArchiveMagic, sizeof(header.Magic));
+			header.Version = ArchiveVersion;
+			header.HeaderSize = sizeof(header);
+			header.EntryCount = (uint32_t)entries.size();
+			header.EntrySize = sizeof(Utils::ArchiveEntry);
+			header.TableSize = entries.size() * sizeof(Utils::ArchiveEntry) + pathStrings.size();
+
+			std::vector<unsigned char> file(Utils::AlignOffset(sizeof(header) + header.TableSize), 0);
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				MappedFile source;
+				Utils::ArchiveEntry& entry = entries[i];
+				entry.Offset = file.size();
+				if (source.Open(paths[i])) {
+					entry.Size = source.GetSize();
+					file.insert(file.end(), source.GetData(), source.GetData() + source.GetSize());
+					file.resize(Utils::AlignOffset(file.size()), 0);
+				}
+				entry.Checksum = Hash::Checksum(file.data() + entry.Offset, entry.Size);
+			}
+
+			unsigned char* table = file.data() + sizeof(header);
+			if (!entries.empty())
+				memcpy(table, entries.data(), entries.size() * sizeof(Utils::ArchiveEntry));
+			memcpy(table + entries.size() * sizeof(Utils::ArchiveEntry), pathStrings.data(), pathStrings.size());
+			header.TableChecksum = Hash::Checksum(table, header.TableSize);
+			header.FileSize = file.size();
+			memcpy(file.data(), &header, sizeof(header));
+
+			// write next to the destination and rename, a mounted archive may still be mapped by another process
+			std::filesystem::path path(archivePath);
+			if (path.has_parent_path())
+				std::filesystem::create_directories(path.parent_path(), error);
+
+			std::string temporary = archivePath + ".tmp";
+			{
+				std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+				if (!stream.write((const char*)file.data(), file.size()))
+					return false;
+			}
+			std::filesystem::rename(temporary, path, error);
+			if (error) {
+				std::filesystem::remove(temporary, error);
+				return false;
+			}
+			return true;
+		}
+
+		bool MountArchive(const std::string& archivePath)
+		{
+			Utils::FileSystemState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			state.ArchiveFiles.clear();
+			if (!state.Archive.Open(archivePath))
+				return false;
+
+			const unsigned char* data = state.Archive.GetData();
+			uint64_t size = state.Archive.GetSize();
+
+			Utils::ArchiveHeader header = {};
+			bool valid = size >= sizeof(header);
+			if (valid) {
+				memcpy(&header, data, sizeof(header));
+				valid = memcmp(header.Magic, Utils::ArchiveMagic, sizeof(header.Magic)) == 0
+					&& header.Version == ArchiveVersion
+					&& header.HeaderSize == sizeof(header)
+					&& header.EntrySize == sizeof(Utils::ArchiveEntry)
+					&& header.FileSize == size
+					&& header.TableSize <= size - sizeof(header)
+					&& (uint64_t)header.EntryCount * sizeof(Utils::ArchiveEntry) <= header.TableSize
+					&& header.TableChecksum == Hash::Checksum(data + sizeof(header), header.TableSize);
+			}
+			if (!valid) {
+				std::cout << "FileSystem: " << archivePath << " is corrupt or from another version, reading loose files" << std::endl;
+				state.Archive.Close();
+				return false;
+			}
+
+			// the entries are 8 byte aligned right after the header and can be used in place
+			const Utils::ArchiveEntry* entries = (const Utils::ArchiveEntry*)(data + sizeof(header));
+			const char* pathStrings = (const char*)(entries + header.EntryCount);
+			uint64_t pathStringsSize = header.TableSize - (uint64_t)header.EntryCount * sizeof(Utils::ArchiveEntry);
+			for (uint32_t i = 0; i < header.EntryCount; i++)
+			{
+				const Utils::ArchiveEntry& entry = entries[i];
+				if ((uint64_t)entry.PathOffset + entry.PathLength > pathStringsSize
+					|| entry.Offset > size || entry.Size > size - entry.Offset)
+					continue;
+
+				Utils::ArchiveFile file;
+				file.Entry = &entry;
+				file.Path = std::string_view(pathStrings + entry.PathOffset, entry.PathLength);
+				state.ArchiveFiles.emplace(entry.PathHash, file);
+			}
+			state.ArchivePath = archivePath;
+			return true;
+		}
+
+		void UnmountAll()
+		{
+			Utils::FileSystemState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			state.ArchiveFiles.clear();
+			state.Archive.Close();
+			state.ArchivePath.clear();
+			state.Files.clear();
+		}
+
+		Statistics GetStatistics()
+		{
+			Utils::FileSystemState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Statistics;
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// Read-only bytes of an asset, valid until FileSystem::UnmountAll.
+	struct FileView
+	{
+		const unsigned char* Data = nullptr;
+		size_t Size = 0;
+
+		inline explicit operator bool() const { return Data != nullptr; }
+		inline std::string_view AsString() const { return std::string_view((const char*)Data, Size); }
+	};
+
+	// Assets are memory mapped once and shared by everyone who reads them, e.g. a font file by FreeType
+	// and by the font cache key. Files in a mounted archive are served from the archive's mapping,
+	// everything else is mapped from disk on first use. Paths are relative to the working directory.
+	// Thread safe.
+	namespace FileSystem {
+
+		static constexpr uint32_t ArchiveVersion = 1;
+
+		struct Statistics
+		{
+			uint32_t FilesMapped = 0;	// loose files
+			uint32_t ArchiveReads = 0;	// files served from the archive
+			uint64_t BytesMapped = 0;
+		};
+
+		// An empty view when the file doesn't exist or is empty.
+		FileView Read(const std::string& filepath);
+
+		// Packs every file below directory into one archive; the paths inside keep the directory prefix,
+		// so packing "res" serves "res/Shaders/TextV.shader".
+		bool WriteArchive(const std::string& directory, const std::string& archivePath);
+		// Files in the archive shadow loose files with the same path, rebuild it after changing assets.
+		bool MountArchive(const std::string& archivePath);
+		// Unmaps everything; views returned earlier become invalid.
+		void UnmountAll();
+
+		Statistics GetStatistics();
+	}
+}
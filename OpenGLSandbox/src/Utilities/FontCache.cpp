@@ -0,0 +1,224 @@
+#include "FontCache.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include "Hash.h"
+#include "FileSystem.h"
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static constexpr char CacheMagic[8] = { 'O', 'G', 'S', 'F', 'O', 'N', 'T', '\0' };
+
+		struct CacheHeader
+		{
+			char Magic[8];
+			uint32_t Version;
+			uint32_t HeaderSize;
+			uint64_t Key;
+			uint64_t PayloadChecksum;	// over every byte after the header
+			uint64_t FileSize;
+
+			uint32_t AtlasWidth, AtlasHeight;
+			uint32_t SDFCharacterCount;
+			uint32_t BitmapAtlasWidth, BitmapAtlasHeight;
+			uint32_t BitmapGlyphCount;
+
+			uint64_t AtlasOffset;
+			uint64_t SDFCharactersOffset;
+			uint64_t BitmapAtlasOffset;
+			uint64_t BitmapGlyphsOffset;
+		};
+
+		static_assert(sizeof(CachedCharacterSDF) == 40, "cache layout changed, bump FontCache::Version");
+		static_assert(sizeof(BitmapGlyph) == 36, "cache layout changed, bump FontCache::Version");
+
+		// sections start 16 byte aligned so the record tables can be used in place
+		inline uint64_t AlignOffset(uint64_t offset)
+		{
+			return (offset + 15) & ~uint64_t(15);
+		}
+
+		inline uint64_t CombinePacking(uint64_t key, const RectPackerSpecification& packing)
+		{
+			key = Hash::Combine(key, packing.Heuristic);
+			key = Hash::Combine(key, packing.Padding);
+			key = Hash::Combine(key, packing.PowerOfTwo);
+			key = Hash::Combine(key, packing.SizeAlignment);
+			return Hash::Combine(key, packing.MaxSize);
+		}
+
+		inline bool SectionInBounds(uint64_t offset, uint64_t size, uint64_t fileSize)
+		{
+			return offset <= fileSize && size <= fileSize - offset;
+		}
+	}
+
+	FontCache::FontCache(const std::string& filepath)
+		: m_Filepath(filepath)
+	{
+	}
+
+	FontCache::~FontCache()
+	{
+	}
+
+	bool FontCache::Open(uint64_t key)
+	{
+		Close();
+		if (!m_File.Open(m_Filepath))
+			return false;
+
+		const unsigned char* data = m_File.GetData();
+		uint64_t size = m_File.GetSize();
+
+		Utils::CacheHeader header = {};
+		bool valid = size >= sizeof(header);
+		if (valid) {
+			memcpy(&header, data, sizeof(header));
+			valid = memcmp(header.Magic, Utils::CacheMagic, sizeof(header.Magic)) == 0
+				&& header.Version == Version
+				&& header.HeaderSize == sizeof(header)
+				&& header.FileSize == size;
+		}
+		if (valid && header.Key != key) {
+			std::cout << "FontCache: " << m_Filepath << " is stale, regenerating" << std::endl;
+			Close();
+			return false;
+		}
+
+		uint64_t atlasSize = (uint64_t)header.AtlasWidth * header.AtlasHeight * 3;
+		uint64_t bitmapAtlasSize = (uint64_t)header.BitmapAtlasWidth * header.BitmapAtlasHeight;
+		valid = valid
+			&& Utils::SectionInBounds(header.AtlasOffset, atlasSize, size)
+			&& Utils::SectionInBounds(header.SDFCharactersOffset, (uint64_t)header.SDFCharacterCount * sizeof(CachedCharacterSDF), size)
+			&& Utils::SectionInBounds(header.BitmapAtlasOffset, bitmapAtlasSize, size)
+			&& Utils::SectionInBounds(header.BitmapGlyphsOffset, (uint64_t)header.BitmapGlyphCount * sizeof(BitmapGlyph), size)
+			&& header.PayloadChecksum == Hash::Checksum(data + sizeof(header), size - sizeof(header));
+
+		if (valid) {
+			const BitmapGlyph* glyphs = (const BitmapGlyph*)(data + header.BitmapGlyphsOffset);
+			for (uint32_t i = 0; i < header.BitmapGlyphCount && valid; i++)
+				valid = glyphs[i].X >= 0 && glyphs[i].Y >= 0 && glyphs[i].Width >= 0 && glyphs[i].Height >= 0
+					&& (uint64_t)glyphs[i].X + glyphs[i].Width <= header.BitmapAtlasWidth
+					&& (uint64_t)glyphs[i].Y + glyphs[i].Height <= header.BitmapAtlasHeight;
+		}
+
+		if (!valid) {
+			std::cout << "FontCache: " << m_Filepath << " is corrupt or from another version, regenerating" << std::endl;
+			Close();
+			return false;
+		}
+
+		m_Contents.AtlasWidth = (int)header.AtlasWidth;
+		m_Contents.AtlasHeight = (int)header.AtlasHeight;
+		m_Contents.AtlasPixels = data + header.AtlasOffset;
+		m_Contents.SDFCharacters = (const CachedCharacterSDF*)(data + header.SDFCharactersOffset);
+		m_Contents.SDFCharacterCount = header.SDFCharacterCount;
+		m_Contents.BitmapAtlasWidth = (int)header.BitmapAtlasWidth;
+		m_Contents.BitmapAtlasHeight = (int)header.BitmapAtlasHeight;
+		m_Contents.BitmapAtlasPixels = data + header.BitmapAtlasOffset;
+		m_Contents.BitmapGlyphs = (const BitmapGlyph*)(data + header.BitmapGlyphsOffset);
+		m_Contents.BitmapGlyphCount = header.BitmapGlyphCount;
+		return true;
+	}
+
+	void FontCache::Close()
+	{
+		m_Contents = FontCacheContents();
+		m_File.Close();
+	}
+
+	bool FontCache::Write(const std::string& filepath, uint64_t key, const FontCacheContents& contents)
+	{
+		Utils::CacheHeader header = {};
+		memcpy(header.Magic, Utils::CacheMagic, sizeof(header.Magic));
+		header.Version = Version;
+		header.HeaderSize = sizeof(header);
+		header.Key = key;
+		header.AtlasWidth = (uint32_t)contents.AtlasWidth;
+		header.AtlasHeight = (uint32_t)contents.AtlasHeight;
+		header.SDFCharacterCount = contents.SDFCharacterCount;
+		header.BitmapAtlasWidth = (uint32_t)contents.BitmapAtlasWidth;
+		header.BitmapAtlasHeight = (uint32_t)contents.BitmapAtlasHeight;
+		header.BitmapGlyphCount = contents.BitmapGlyphCount;
+
+		uint64_t atlasSize = (uint64_t)contents.AtlasWidth * contents.AtlasHeight * 3;
+		uint64_t sdfSize = (uint64_t)contents.SDFCharacterCount * sizeof(CachedCharacterSDF);
+		uint64_t bitmapAtlasSize = (uint64_t)contents.BitmapAtlasWidth * contents.BitmapAtlasHeight;
+		uint64_t bitmapGlyphsSize = (uint64_t)contents.BitmapGlyphCount * sizeof(BitmapGlyph);
+
+		header.AtlasOffset = Utils::AlignOffset(sizeof(header));
+		header.SDFCharactersOffset = Utils::AlignOffset(header.AtlasOffset + atlasSize);
+		header.BitmapAtlasOffset = Utils::AlignOffset(header.SDFCharactersOffset + sdfSize);
+		header.BitmapGlyphsOffset = Utils::AlignOffset(header.BitmapAtlasOffset + bitmapAtlasSize);
+		header.FileSize = header.BitmapGlyphsOffset + bitmapGlyphsSize;
+
+		std::vector<unsigned char> file(header.FileSize, 0);
+		if (atlasSize)
+			memcpy(&file[header.AtlasOffset], contents.AtlasPixels, atlasSize);
+		if (sdfSize)
+			memcpy(&file[header.SDFCharactersOffset], contents.SDFCharacters, sdfSize);
+		if (bitmapAtlasSize)
+			memcpy(&file[header.BitmapAtlasOffset], contents.BitmapAtlasPixels, bitmapAtlasSize);
+		if (bitmapGlyphsSize)
+			memcpy(&file[header.BitmapGlyphsOffset], contents.BitmapGlyphs, bitmapGlyphsSize);
+
+		header.PayloadChecksum = Hash::Checksum(file.data() + sizeof(header), file.size() - sizeof(header));
+		memcpy(file.data(), &header, sizeof(header));
+
+		// write next to the destination and rename, so a crash never leaves a half written cache behind
+		std::error_code error;
+		std::filesystem::path path(filepath);
+		if (path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path(), error);
+
+		std::string temporary = filepath + ".tmp";
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			if (!stream.write((const char*)file.data(), file.size()))
+				return false;
+		}
+		std::filesystem::rename(temporary, path, error);
+		if (error) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t FontCache::ComputeKey(const FontCacheParameters& parameters)
+	{
+		uint64_t key = Hash::Combine(Hash::FNVOffsetBasis, Version);
+
+		for (const std::string& filepath : { parameters.MSDF.FontFilepath, parameters.Bitmap.FontFilepath })
+		{
+			// the same mapping FreeType reads the font from later
+			FileView font = FileSystem::Read(filepath);
+			if (font)
+				key = Hash::Checksum(font.Data, font.Size, key);
+			key = Hash::Combine(key, (uint64_t)font.Size);
+		}
+
+		const MSDFAtlasSpecification& msdf = parameters.MSDF;
+		key = Hash::Combine(key, msdf.FirstCharacter);
+		key = Hash::Combine(key, msdf.LastCharacter);
+		key = Hash::Combine(key, msdf.GlyphWidth);
+		key = Hash::Combine(key, msdf.GlyphHeight);
+		key = Hash::Combine(key, msdf.Range);
+		key = Hash::Combine(key, msdf.Scale);
+		key = Hash::Combine(key, msdf.Translation.x);
+		key = Hash::Combine(key, msdf.Translation.y);
+		key = Hash::Combine(key, msdf.EdgeColoringAngle);
+		key = Utils::CombinePacking(key, msdf.Packing);
+
+		const BitmapFontSpecification& bitmap = parameters.Bitmap;
+		for (unsigned int pixelSize : bitmap.PixelSizes)
+			key = Hash::Combine(key, pixelSize);
+		key = Hash::Combine(key, bitmap.FirstCharacter);
+		key = Hash::Combine(key, bitmap.LastCharacter);
+		key = Utils::CombinePacking(key, bitmap.Packing);
+		return key;
+	}
+}
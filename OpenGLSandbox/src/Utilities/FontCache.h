@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "MappedFile.h"
+#include "MSDFAtlasGenerator.h"
+#include "BitmapFontAtlas.h"
+
+namespace OpenGLSandbox {
+
+	// Everything that changes the generated glyphs. Font file contents are hashed in addition to these.
+	struct FontCacheParameters
+	{
+		MSDFAtlasSpecification MSDF;
+		BitmapFontSpecification Bitmap;
+	};
+
+	struct CachedCharacterSDF
+	{
+		uint32_t Codepoint;
+		int32_t X0, Y0, X1, Y1;
+		int32_t Width, Height;
+		int32_t BearingX, BearingY;
+		int32_t Advance;
+	};
+
+	// Non-owning view of a font cache, either over the mapped file or over freshly generated data.
+	struct FontCacheContents
+	{
+		int AtlasWidth = 0;
+		int AtlasHeight = 0;
+		const unsigned char* AtlasPixels = nullptr;	// RGB8
+
+		const CachedCharacterSDF* SDFCharacters = nullptr;
+		uint32_t SDFCharacterCount = 0;
+
+		int BitmapAtlasWidth = 0;
+		int BitmapAtlasHeight = 0;
+		const unsigned char* BitmapAtlasPixels = nullptr;	// R8
+
+		const BitmapGlyph* BitmapGlyphs = nullptr;
+		uint32_t BitmapGlyphCount = 0;
+	};
+
+	// Versioned binary cache of the MSDF atlas and the bitmap glyph atlas. The file is memory mapped and
+	// the contents point straight into the mapped pages, so a warm start uploads without copying.
+	class FontCache
+	{
+	public:
+		static constexpr uint32_t Version = 3;
+
+		FontCache(const std::string& filepath);
+		~FontCache();
+
+		// Returns false if the file is missing, was built for another key, or fails validation.
+		bool Open(uint64_t key);
+		void Close();
+
+		inline const FontCacheContents& GetContents() const { return m_Contents; }
+
+		static bool Write(const std::string& filepath, uint64_t key, const FontCacheContents& contents);
+		static uint64_t ComputeKey(const FontCacheParameters& parameters);
+
+	private:
+		std::string m_Filepath;
+		MappedFile m_File;
+		FontCacheContents m_Contents;
+	};
+}
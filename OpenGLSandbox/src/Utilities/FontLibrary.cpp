@@ -0,0 +1,72 @@
+#include "FontLibrary.h"
+#include <iostream>
+#include <mutex>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "FileSystem.h"
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		struct FreeTypeLibrary
+		{
+			std::mutex Mutex;
+			FT_Library Handle = nullptr;
+			bool Initialized = false;
+
+			~FreeTypeLibrary()
+			{
+				if (Handle)
+					FT_Done_FreeType(Handle);
+			}
+		};
+
+		static FreeTypeLibrary& GetLibrary()
+		{
+			static FreeTypeLibrary library;
+			return library;
+		}
+	}
+
+	namespace FontLibrary {
+
+		FT_Face OpenFace(const std::string& filepath)
+		{
+			FileView font = FileSystem::Read(filepath);
+			if (!font) {
+				std::cout << "ERROR::FREETYPE: Could not read font " << filepath << std::endl;
+				return nullptr;
+			}
+
+			Utils::FreeTypeLibrary& library = Utils::GetLibrary();
+			std::lock_guard<std::mutex> lock(library.Mutex);
+			if (!library.Initialized) {
+				library.Initialized = true;
+				// All functions return a value different than 0 whenever an error occurred
+				if (FT_Init_FreeType(&library.Handle)) {
+					std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+					library.Handle = nullptr;
+				}
+			}
+			if (!library.Handle)
+				return nullptr;
+
+			FT_Face face = nullptr;
+			if (FT_New_Memory_Face(library.Handle, font.Data, (FT_Long)font.Size, 0, &face)) {
+				std::cout << "ERROR::FREETYPE: Failed to load font " << filepath << std::endl;
+				return nullptr;
+			}
+			return face;
+		}
+
+		void CloseFace(FT_Face face)
+		{
+			if (!face)
+				return;
+
+			std::lock_guard<std::mutex> lock(Utils::GetLibrary().Mutex);
+			FT_Done_Face(face);
+		}
+	}
+}
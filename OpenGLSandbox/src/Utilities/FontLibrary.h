@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+typedef struct FT_FaceRec_* FT_Face;
+
+namespace OpenGLSandbox {
+
+	// The program's single FreeType library. Faces are created over the font's FileSystem mapping, so
+	// the bitmap rasterizer, the MSDF generator and the glyph cache share one copy of each font file.
+	// Opening and closing faces is serialized; a face itself must only be used by one thread at a time.
+	namespace FontLibrary {
+
+		// nullptr when the font can't be read or parsed.
+		FT_Face OpenFace(const std::string& filepath);
+		void CloseFace(FT_Face face);
+	}
+}
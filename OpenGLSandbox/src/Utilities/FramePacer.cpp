@@ -0,0 +1,174 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <timeapi.h>
+	#pragma comment(lib, "winmm.lib")
+#else
+	#include <time.h>
+#endif
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static double Milliseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+	}
+
+	FramePacer::FramePacer(FramePolicy policy, double targetFPS)
+		: m_Policy(policy), m_TargetFPS(std::max(targetFPS, 1.0))
+	{
+		m_Period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_TargetFPS));
+		m_Start = m_LastFrame = Clock::now();
+		m_StartCPUTime = GetProcessCPUTime();
+#ifdef _WIN32
+		// the default timer resolution rounds every sleep up to 15.6 ms
+		if (m_Policy == FramePolicy::Capped)
+			timeBeginPeriod(1);
+#endif
+	}
+
+	FramePacer::~FramePacer()
+	{
+#ifdef _WIN32
+		if (m_Policy == FramePolicy::Capped)
+			timeEndPeriod(1);
+#endif
+	}
+
+	void FramePacer::EndFrame()
+	{
+		Clock::time_point now = Clock::now();
+		if (m_Policy == FramePolicy::Capped) {
+			// a frame more than a period late starts the schedule over instead of rushing to catch up
+			m_Deadline = m_Frames ? m_Deadline + m_Period : now;
+			if (now > m_Deadline + m_Period)
+				m_Deadline = now;
+			if (now < m_Deadline) {
+				WaitUntil(m_Deadline);
+				Clock::time_point released = Clock::now();
+				double error = Utils::Milliseconds(released - m_Deadline);
+				m_DeadlineError += error;
+				m_DeadlineErrorMax = std::max(m_DeadlineErrorMax, error);
+				m_WaitTime += Utils::Milliseconds(released - now);
+				m_Waits++;
+				now = released;
+			}
+		}
+
+		if (m_Frames) {
+			double interval = Utils::Milliseconds(now - m_LastFrame);
+			m_IntervalMin = m_Intervals ? std::min(m_IntervalMin, interval) : interval;
+			m_IntervalMax = m_Intervals ? std::max(m_IntervalMax, interval) : interval;
+			m_Intervals++;
+			double delta = interval - m_IntervalMean;
+			m_IntervalMean += delta / m_Intervals;
+			m_IntervalM2 += delta * (interval - m_IntervalMean);
+		}
+		m_LastFrame = now;
+		m_Frames++;
+	}
+
+	void FramePacer::SkipFrame()
+	{
+		m_IdleWakeups++;
+	}
+
+	FramePacer::Statistics FramePacer::GetStatistics() const
+	{
+		Statistics statistics;
+		statistics.Frames = m_Frames;
+		statistics.IdleWakeups = m_IdleWakeups;
+		statistics.WallTime = Utils::Milliseconds(Clock::now() - m_Start) / 1000.0;
+		statistics.CPUTime = GetProcessCPUTime() - m_StartCPUTime;
+		statistics.CPUUsage = statistics.WallTime > 0.0 ? 100.0 * statistics.CPUTime / statistics.WallTime : 0.0;
+		statistics.IntervalMean = m_IntervalMean;
+		statistics.IntervalStdDev = m_Intervals > 1 ? std::sqrt(m_IntervalM2 / (m_Intervals - 1)) : 0.0;
+		statistics.IntervalMin = m_IntervalMin;
+		statistics.IntervalMax = m_IntervalMax;
+		if (m_Waits) {
+			statistics.DeadlineError = m_DeadlineError / m_Waits;
+			statistics.DeadlineErrorMax = m_DeadlineErrorMax;
+			statistics.SpinFraction = m_WaitTime > 0.0 ? m_SpinTime / m_WaitTime : 0.0;
+		}
+		return statistics;
+	}
+
+	void FramePacer::PrintReport(std::ostream& out) const
+	{
+		Statistics statistics = GetStatistics();
+		out << "FramePacer: " << GetPolicyName(m_Policy);
+		if (m_Policy == FramePolicy::Capped)
+			out << " at " << m_TargetFPS << " fps";
+		out << ", " << statistics.Frames << " frames in " << statistics.WallTime << " s";
+		if (m_Policy == FramePolicy::OnDemand)
+			out << ", " << statistics.IdleWakeups << " idle wakeups";
+		out << ", CPU " << statistics.CPUUsage << "% of a core" << std::endl;
+		out << "  frame interval " << statistics.IntervalMean << " ms (min " << statistics.IntervalMin
+			<< ", max " << statistics.IntervalMax << "), jitter " << statistics.IntervalStdDev << " ms" << std::endl;
+		if (m_Policy == FramePolicy::Capped)
+			out << "  released " << statistics.DeadlineError << " ms after the deadline on average (max "
+				<< statistics.DeadlineErrorMax << "), " << 100.0 * statistics.SpinFraction << "% of the wait spun" << std::endl;
+	}
+
+	const char* FramePacer::GetPolicyName(FramePolicy policy)
+	{
+		switch (policy)
+		{
+		case FramePolicy::Continuous: return "continuous";
+		case FramePolicy::Capped: return "capped";
+		case FramePolicy::OnDemand: return "on-demand";
+		}
+		return "";
+	}
+
+	double FramePacer::GetProcessCPUTime()
+	{
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+			return 0.0;
+		// 100 ns ticks
+		auto seconds = [](const FILETIME& time) { return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) * 1e-7; };
+		return seconds(kernel) + seconds(user);
+#else
+		timespec time;
+		if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+			return 0.0;
+		return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+	}
+
+	void FramePacer::WaitUntil(Clock::time_point deadline)
+	{
+		// sleep while even a sleep that overshoots by two standard deviations ends before the deadline
+		while (true)
+		{
+			Clock::time_point now = Clock::now();
+			if (Utils::Milliseconds(deadline - now) <= m_SleepMean + 2.0 * std::sqrt(m_SleepVariance))
+				break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			// exponentially weighted, so the estimate follows the timer; a sleep the thread was
+			// preempted in only counts for a few times the mean, so one outlier doesn't turn
+			// every following wait into a spin
+			double slept = std::min(Utils::Milliseconds(Clock::now() - now), 4.0 * m_SleepMean);
+			double delta = slept - m_SleepMean;
+			m_SleepMean += 0.1 * delta;
+			m_SleepVariance = 0.9 * (m_SleepVariance + 0.1 * delta * delta);
+		}
+
+		Clock::time_point spinStart = Clock::now();
+		while (Clock::now() < deadline)
+			std::this_thread::yield();
+		m_SpinTime += Utils::Milliseconds(Clock::now() - spinStart);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	enum class FramePolicy
+	{
+		Continuous,	// redraws as fast as it can
+		Capped,		// redraws at the target rate
+		OnDemand	// redraws only when something invalidated the frame, otherwise waits for events
+	};
+
+	// Paces the render loop and measures what the pacing costs. EndFrame() is called once per
+	// presented frame; when capped it holds the frame until its deadline, one period after the
+	// previous one. The wait sleeps while the deadline is further away than a sleep may overshoot,
+	// which it learns from the sleeps it took, and spins the rest, so frames are released within a
+	// fraction of a millisecond of their deadline at the cost of a short spin.
+	//
+	// The loop decides what needs a redraw on demand; SkipFrame() counts the wakeups that didn't.
+	class FramePacer
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t Frames = 0;
+			uint32_t IdleWakeups = 0;		// on demand: waits that ended without a redraw
+			double WallTime = 0.0;			// s, since the pacer was created
+			double CPUTime = 0.0;			// s, every thread of the process
+			double CPUUsage = 0.0;			// % of one core
+			// between consecutive frames, ms; the standard deviation is the jitter
+			double IntervalMean = 0.0, IntervalStdDev = 0.0, IntervalMin = 0.0, IntervalMax = 0.0;
+			// capped: how late the limiter released the frames, ms, and how much of its wait it spun
+			double DeadlineError = 0.0, DeadlineErrorMax = 0.0;
+			double SpinFraction = 0.0;
+		};
+
+	public:
+		// targetFPS only applies when capped
+		FramePacer(FramePolicy policy, double targetFPS = 60.0);
+		~FramePacer();
+
+		FramePacer(const FramePacer&) = delete;
+		FramePacer& operator=(const FramePacer&) = delete;
+
+		void EndFrame();
+		void SkipFrame();
+
+		inline FramePolicy GetPolicy() const { return m_Policy; }
+		Statistics GetStatistics() const;
+		void PrintReport(std::ostream& out) const;
+
+		static const char* GetPolicyName(FramePolicy policy);
+		// s, of every thread of the process
+		static double GetProcessCPUTime();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void WaitUntil(Clock::time_point deadline);
+
+	private:
+		FramePolicy m_Policy;
+		double m_TargetFPS;
+		Clock::duration m_Period;
+		Clock::time_point m_Deadline;
+		Clock::time_point m_Start, m_LastFrame;
+		double m_StartCPUTime = 0.0;
+
+		// how long a 1 ms sleep takes, ms, as a running mean and variance
+		double m_SleepMean = 1.0, m_SleepVariance = 0.0;
+
+		uint32_t m_Frames = 0, m_IdleWakeups = 0;
+		// Welford's running mean and variance of the intervals
+		uint32_t m_Intervals = 0;
+		double m_IntervalMean = 0.0, m_IntervalM2 = 0.0, m_IntervalMin = 0.0, m_IntervalMax = 0.0;
+		uint32_t m_Waits = 0;
+		double m_DeadlineError = 0.0, m_DeadlineErrorMax = 0.0;
+		double m_WaitTime = 0.0, m_SpinTime = 0.0;
+	};
+}
@@ -0,0 +1,207 @@
+#include "GlyphLookupTable.h"
+#include "CharacterLibrary.h"
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+namespace OpenGLSandbox {
+
+	GlyphLookupTable::GlyphLookupTable()
+	{
+		Clear();
+	}
+
+	void GlyphLookupTable::Set(uint32_t codepoint, uint32_t index)
+	{
+		if (codepoint < PageSize) {
+			m_Latin[codepoint] = index;
+			return;
+		}
+		if (codepoint > MaxCodepoint)
+			return;
+
+		uint32_t& page = m_Directory[codepoint >> PageBits];
+		if (page == InvalidIndex) {
+			page = (uint32_t)(m_Pages.size() / PageSize);
+			m_Pages.resize(m_Pages.size() + PageSize, InvalidIndex);
+		}
+		m_Pages[page * PageSize + (codepoint & PageMask)] = index;
+	}
+
+	void GlyphLookupTable::Remove(uint32_t codepoint)
+	{
+		// never allocates a page just to clear an entry
+		if (Find(codepoint) != InvalidIndex)
+			Set(codepoint, InvalidIndex);
+	}
+
+	void GlyphLookupTable::Clear()
+	{
+		m_Latin.fill(InvalidIndex);
+		m_Directory.assign((MaxCodepoint >> PageBits) + 1, InvalidIndex);
+		m_Pages.clear();
+	}
+
+	size_t GlyphLookupTable::GetMemoryUsage() const
+	{
+		return sizeof(m_Latin) + m_Directory.size() * sizeof(uint32_t) + m_Pages.size() * sizeof(uint32_t);
+	}
+
+	void GlyphLookupTable::RunBenchmark(std::ostream& out)
+	{
+		constexpr int Repeats = 20;
+		constexpr size_t TextLength = 1 << 20;
+		const float scale = 0.5f;
+
+		auto measure = [&](const char* name, auto&& layout, double baseline)
+		{
+			float sum = 0.0f;
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < Repeats; i++)
+				sum += layout();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			double glyphsPerSecond = (double)TextLength * Repeats / elapsed.count();
+			out << "  " << std::left << std::setw(36) << name << std::right << "  Mglyphs/sec: " << glyphsPerSecond / 1e6;
+			if (baseline > 0.0)
+				out << "  speedup: " << glyphsPerSecond / baseline;
+			out << "  pen: " << sum / Repeats << std::endl;
+			return glyphsPerSecond;
+		};
+
+		std::mt19937 random(1337);
+
+		// ASCII, the range the bitmap font and the MSDF library cover today
+		{
+			std::map<char, Character> characters;
+			std::unordered_map<unsigned char, CharacterSDF> characterLibrary;
+			GlyphLookupTable table;
+			GlyphMetrics metrics;
+			for (unsigned int c = 32; c < 127; c++)
+			{
+				unsigned int advance = 8 + c % 23;
+				characters[(char)c] = { 0, glm::ivec2(advance), glm::ivec2(0), advance << 6 };
+				CharacterSDF sdf = {};
+				sdf.m_Advance = (int)advance;
+				characterLibrary[(unsigned char)c] = sdf;
+
+				table.Set(c, (uint32_t)metrics.GetCount());
+				metrics.Resize(metrics.GetCount() + 1);
+				metrics.Advances.back() = (float)advance;
+			}
+
+			std::string text(TextLength, ' ');
+			std::uniform_int_distribution<int> printable(32, 126);
+			for (char& c : text)
+				c = (char)printable(random);
+
+			out << "ascii, " << TextLength << " glyphs" << std::endl;
+			double baseline = measure("std::map copy (previous RenderText)", [&]()
+			{
+				float x = 0.0f;
+				for (char c : text)
+				{
+					Character ch = characters[c];
+					x += (ch.Advance >> 6) * scale;
+				}
+				return x;
+			}, 0.0);
+			measure("std::unordered_map find", [&]()
+			{
+				float x = 0.0f;
+				for (char c : text)
+				{
+					auto it = characterLibrary.find((unsigned char)c);
+					if (it != characterLibrary.end())
+						x += it->second.m_Advance * scale;
+				}
+				return x;
+			}, baseline);
+			measure("lookup table + SoA advances", [&]()
+			{
+				float x = 0.0f;
+				const float* advances = metrics.Advances.data();
+				for (char c : text)
+				{
+					uint32_t index = table.Find((unsigned char)c);
+					if (index != InvalidIndex)
+						x += advances[index] * scale;
+				}
+				return x;
+			}, baseline);
+		}
+
+		// sparse Unicode: mostly Latin with Cyrillic and a few thousand CJK ideographs
+		{
+			std::vector<uint32_t> codepoints;
+			for (uint32_t c = 32; c < 127; c++)
+				codepoints.push_back(c);
+			for (uint32_t c = 0x410; c < 0x450; c++)
+				codepoints.push_back(c);
+			for (uint32_t c = 0x4E00; c < 0x4E00 + 3000; c++)
+				codepoints.push_back(c);
+
+			std::map<uint32_t, Character> characters;
+			std::unordered_map<uint32_t, CharacterSDF> characterLibrary;
+			GlyphLookupTable table;
+			GlyphMetrics metrics;
+			for (uint32_t c : codepoints)
+			{
+				unsigned int advance = 8 + c % 23;
+				characters[c] = { 0, glm::ivec2(advance), glm::ivec2(0), advance << 6 };
+				CharacterSDF sdf = {};
+				sdf.m_Advance = (int)advance;
+				characterLibrary[c] = sdf;
+
+				table.Set(c, (uint32_t)metrics.GetCount());
+				metrics.Resize(metrics.GetCount() + 1);
+				metrics.Advances.back() = (float)advance;
+			}
+
+			std::vector<uint32_t> text(TextLength);
+			std::uniform_int_distribution<size_t> pick(0, codepoints.size() - 1);
+			std::uniform_int_distribution<int> latin(32, 126);
+			for (size_t i = 0; i < text.size(); i++)
+				text[i] = i % 4 ? (uint32_t)latin(random) : codepoints[pick(random)];
+
+			out << "mixed unicode, " << codepoints.size() << " glyphs in font, " << TextLength << " glyphs"
+				<< ", table " << table.GetMemoryUsage() / 1024 << " KB" << std::endl;
+			double baseline = measure("std::map find", [&]()
+			{
+				float x = 0.0f;
+				for (uint32_t c : text)
+				{
+					auto it = characters.find(c);
+					if (it != characters.end())
+						x += (it->second.Advance >> 6) * scale;
+				}
+				return x;
+			}, 0.0);
+			measure("std::unordered_map find", [&]()
+			{
+				float x = 0.0f;
+				for (uint32_t c : text)
+				{
+					auto it = characterLibrary.find(c);
+					if (it != characterLibrary.end())
+						x += it->second.m_Advance * scale;
+				}
+				return x;
+			}, baseline);
+			measure("lookup table + SoA advances", [&]()
+			{
+				float x = 0.0f;
+				const float* advances = metrics.Advances.data();
+				for (uint32_t c : text)
+				{
+					uint32_t index = table.Find(c);
+					if (index != InvalidIndex)
+						x += advances[index] * scale;
+				}
+				return x;
+			}, baseline);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace OpenGLSandbox {
+
+	// Maps codepoints to dense glyph indices. Latin-1 is a direct 256 entry table, the rest of
+	// Unicode goes through a two-level table whose 256 entry pages only exist once a codepoint in
+	// their range is set, so a handful of CJK glyphs costs a few KB instead of a whole plane.
+	class GlyphLookupTable
+	{
+	public:
+		static constexpr uint32_t InvalidIndex = UINT32_MAX;
+		static constexpr uint32_t MaxCodepoint = 0x10FFFF;
+
+		GlyphLookupTable();
+
+		inline uint32_t Find(uint32_t codepoint) const
+		{
+			if (codepoint < PageSize)
+				return m_Latin[codepoint];
+			if (codepoint > MaxCodepoint)
+				return InvalidIndex;
+			uint32_t page = m_Directory[codepoint >> PageBits];
+			return page == InvalidIndex ? InvalidIndex : m_Pages[page * PageSize + (codepoint & PageMask)];
+		}
+
+		void Set(uint32_t codepoint, uint32_t index);
+		void Remove(uint32_t codepoint);
+		void Clear();
+
+		size_t GetMemoryUsage() const;
+
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		static constexpr uint32_t PageBits = 8;
+		static constexpr uint32_t PageSize = 1u << PageBits;
+		static constexpr uint32_t PageMask = PageSize - 1;
+
+		std::array<uint32_t, PageSize> m_Latin;
+		std::vector<uint32_t> m_Directory;	// page index per 256 codepoints, or InvalidIndex
+		std::vector<uint32_t> m_Pages;		// PageSize entries per allocated page
+	};
+
+	// Glyph metrics with one contiguous array per field, indexed like the lookup table, so layout
+	// loops only stream through the fields they read.
+	struct GlyphMetrics
+	{
+		std::vector<float> Advances;		// in pixels
+		std::vector<glm::ivec2> Sizes;
+		std::vector<glm::ivec2> Bearings;	// left & top bearing
+		std::vector<glm::vec4> UVRects;		// top-left and bottom-right in normalized atlas coordinates
+
+		inline size_t GetCount() const { return Advances.size(); }
+
+		void Resize(size_t count)
+		{
+			Advances.resize(count, 0.0f);
+			Sizes.resize(count, glm::ivec2(0));
+			Bearings.resize(count, glm::ivec2(0));
+			UVRects.resize(count, glm::vec4(0.0f));
+		}
+	};
+}
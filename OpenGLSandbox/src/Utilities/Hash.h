@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace OpenGLSandbox {
+
+	namespace Hash {
+
+		constexpr uint64_t FNVOffsetBasis = 14695981039346656037ull;
+		constexpr uint64_t FNVPrime = 1099511628211ull;
+
+		/// 64 bit FNV-1a, usable at compile time for string literals.
+		constexpr uint64_t FNV1a(std::string_view string, uint64_t hash = FNVOffsetBasis)
+		{
+			for (char c : string)
+				hash = (hash ^ (uint64_t)(unsigned char)c) * FNVPrime;
+			return hash;
+		}
+
+		inline uint64_t FNV1a(const void* data, size_t size, uint64_t hash = FNVOffsetBasis)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++)
+				hash = (hash ^ bytes[i]) * FNVPrime;
+			return hash;
+		}
+
+		/// FNV style hash that consumes 8 bytes per step; meant for checksumming large blobs.
+		inline uint64_t Checksum(const void* data, size_t size, uint64_t hash = FNVOffsetBasis)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			size_t words = size / sizeof(uint64_t);
+			for (size_t i = 0; i < words; i++)
+			{
+				uint64_t word;
+				memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+				hash = (hash ^ word) * FNVPrime;
+				hash ^= hash >> 29;
+			}
+			return FNV1a(bytes + words * sizeof(uint64_t), size % sizeof(uint64_t), hash);
+		}
+
+		template<typename T>
+		inline uint64_t Combine(uint64_t hash, const T& value)
+		{
+			return FNV1a(&value, sizeof(T), hash);
+		}
+	}
+}
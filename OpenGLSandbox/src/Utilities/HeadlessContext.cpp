@@ -0,0 +1,135 @@
+#include "HeadlessContext.h"
+#include <iostream>
+#include <cstring>
+#include <glad/glad.h>
+#include <glfw3.h>
+
+#if defined(__linux__)
+	#define HEADLESS_CONTEXT_EGL 1
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#endif
+
+namespace OpenGLSandbox {
+
+	HeadlessContext::HeadlessContext()
+	{
+	}
+
+	HeadlessContext::~HeadlessContext()
+	{
+		Destroy();
+	}
+
+	bool HeadlessContext::Create()
+	{
+		Destroy();
+		if (CreateEGL() || CreateGLFW())
+			return true;
+
+		std::cout << "Failed to create a headless OpenGL context" << std::endl;
+		return false;
+	}
+
+	void HeadlessContext::Destroy()
+	{
+#ifdef HEADLESS_CONTEXT_EGL
+		if (m_Display) {
+			eglMakeCurrent((EGLDisplay)m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (m_Context)
+				eglDestroyContext((EGLDisplay)m_Display, (EGLContext)m_Context);
+			eglTerminate((EGLDisplay)m_Display);
+		}
+#endif
+		if (m_Window) {
+			glfwDestroyWindow(m_Window);
+			glfwTerminate();
+		}
+
+		m_Display = m_Context = nullptr;
+		m_Window = nullptr;
+		m_Backend = nullptr;
+	}
+
+	void HeadlessContext::MakeCurrent(bool current)
+	{
+#ifdef HEADLESS_CONTEXT_EGL
+		if (m_Display) {
+			eglMakeCurrent((EGLDisplay)m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, current ? (EGLContext)m_Context : EGL_NO_CONTEXT);
+			return;
+		}
+#endif
+		if (m_Window)
+			glfwMakeContextCurrent(current ? m_Window : nullptr);
+	}
+
+	bool HeadlessContext::CreateEGL()
+	{
+#ifdef HEADLESS_CONTEXT_EGL
+		// surfaceless needs no display server and no render node, so it runs on any Mesa install
+		const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (!extensions || !strstr(extensions, "EGL_MESA_platform_surfaceless"))
+			return false;
+
+		EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+			return false;
+		m_Display = display;
+
+		const char* displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+		if (!displayExtensions || !strstr(displayExtensions, "EGL_KHR_no_config_context") || !eglBindAPI(EGL_OPENGL_API)) {
+			Destroy();
+			return false;
+		}
+
+		const EGLint attributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3,
+			EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE
+		};
+		EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+		if (context == EGL_NO_CONTEXT) {
+			Destroy();
+			return false;
+		}
+		m_Context = context;
+
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)
+			|| !gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+			Destroy();
+			return false;
+		}
+		m_Backend = "EGL surfaceless";
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool HeadlessContext::CreateGLFW()
+	{
+		if (!glfwInit())
+			return false;
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+		m_Window = glfwCreateWindow(64, 64, "Headless", NULL, NULL);
+		if (!m_Window) {
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(m_Window);
+		glfwSwapInterval(0);
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+			Destroy();
+			return false;
+		}
+		m_Backend = "hidden GLFW window";
+		return true;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+struct GLFWwindow;
+
+namespace OpenGLSandbox {
+
+	// An OpenGL 3.3 core context without a window, for benchmarks and CI machines without a display
+	// or GPU. On Linux it is an EGL context on Mesa's surfaceless platform (llvmpipe works), elsewhere
+	// or when that fails a hidden GLFW window. There is no default framebuffer to draw into, render
+	// into a framebuffer object.
+	class HeadlessContext
+	{
+	public:
+		HeadlessContext();
+		~HeadlessContext();
+
+		HeadlessContext(const HeadlessContext&) = delete;
+		HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+		// Makes the context current and loads the GL functions.
+		bool Create();
+		void Destroy();
+		// Binds the context to the calling thread, or releases it so another thread can bind it.
+		void MakeCurrent(bool current);
+
+		inline bool IsValid() const { return m_Backend != nullptr; }
+		inline const char* GetBackend() const { return m_Backend; }
+
+	private:
+		bool CreateEGL();
+		bool CreateGLFW();
+
+	private:
+		const char* m_Backend = nullptr;
+		GLFWwindow* m_Window = nullptr;
+		void* m_Display = nullptr;	// EGLDisplay
+		void* m_Context = nullptr;	// EGLContext
+	};
+}
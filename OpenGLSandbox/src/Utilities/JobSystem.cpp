@@ -0,0 +1,461 @@
+#include "JobSystem.h"
+#include "WorkStealingDeque.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#elif defined(__linux__)
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+namespace OpenGLSandbox {
+
+	namespace JobSystem {
+
+		namespace Utils {
+
+			static_assert(sizeof(Job) == Job::Size, "a job is two cache lines");
+
+			// only written by the owning thread
+			struct ThreadCounters
+			{
+				std::atomic<uint64_t> Jobs{ 0 };
+				std::atomic<uint64_t> Steals{ 0 };
+				std::atomic<uint64_t> StealAttempts{ 0 };
+				std::atomic<uint64_t> Inline{ 0 };
+				std::atomic<uint64_t> Injected{ 0 };
+			};
+
+			struct alignas(64) JobThread
+			{
+				WorkStealingDeque<Job, MaxJobsPerThread> Deque;
+				ThreadCounters Counters;
+				uint32_t Random = 0;	// xorshift state, picks the first victim to steal from
+				std::thread Thread;		// none for thread 0
+			};
+
+			struct JobSystemState
+			{
+				std::vector<std::unique_ptr<JobThread>> Threads;
+				std::atomic<bool> Running{ false };
+
+				// idle workers sleep until the epoch moves, which every push does
+				std::mutex SleepMutex;
+				std::condition_variable SleepCondition;
+				std::atomic<uint64_t> Epoch{ 0 };
+				std::atomic<uint32_t> Sleepers{ 0 };
+
+				// jobs of the threads outside the system, which have no deque
+				std::mutex InjectMutex;
+				std::deque<Job*> Injected;
+				std::atomic<uint32_t> InjectedCount{ 0 };	// checked before taking the lock
+			};
+
+			// never destroyed, a process may exit without Shutdown() while the workers still run
+			static JobSystemState& GetState()
+			{
+				static JobSystemState* state = new JobSystemState();
+				return *state;
+			}
+
+			// Any thread that creates jobs gets a ring, allocated on first use.
+			struct JobRing
+			{
+				std::unique_ptr<Job[]> Jobs;
+				uint32_t Next = 0;
+			};
+
+			thread_local JobRing t_Ring;
+			thread_local uint32_t t_ThreadIndex = ~0u;
+
+			// spins before a worker goes to sleep, jobs often come in bursts
+			static constexpr uint32_t IdleSpins = 64;
+
+			static void Finish(Job* job)
+			{
+				// the parent is read first, a finished job may be reused by its owner right away
+				while (job)
+				{
+					Job* parent = job->Parent;
+					if (job->Unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+						return;
+					job = parent;
+				}
+			}
+
+			static void Execute(Job* job)
+			{
+				job->Run(*job);
+				Finish(job);
+			}
+
+			static Job* GetJob(JobSystemState& state, uint32_t index)
+			{
+				JobThread& thread = *state.Threads[index];
+				if (Job* job = thread.Deque.Pop())
+					return job;
+
+				if (index != 0 && state.InjectedCount.load(std::memory_order_acquire)) {
+					std::lock_guard<std::mutex> lock(state.InjectMutex);
+					if (!state.Injected.empty()) {
+						Job* job = state.Injected.front();
+						state.Injected.pop_front();
+						state.InjectedCount.fetch_sub(1, std::memory_order_relaxed);
+						thread.Counters.Injected.fetch_add(1, std::memory_order_relaxed);
+						return job;
+					}
+				}
+
+				uint32_t count = (uint32_t)state.Threads.size();
+				if (count == 1)
+					return nullptr;
+				thread.Random ^= thread.Random << 13;
+				thread.Random ^= thread.Random >> 17;
+				thread.Random ^= thread.Random << 5;
+				uint32_t first = thread.Random % count;
+				for (uint32_t i = 0; i < count; i++)
+				{
+					uint32_t victim = (first + i) % count;
+					if (victim == index)
+						continue;
+					thread.Counters.StealAttempts.fetch_add(1, std::memory_order_relaxed);
+					if (Job* job = state.Threads[victim]->Deque.Steal()) {
+						thread.Counters.Steals.fetch_add(1, std::memory_order_relaxed);
+						return job;
+					}
+				}
+				return nullptr;
+			}
+
+			static void ExecuteCounted(JobSystemState& state, uint32_t index, Job* job)
+			{
+				Execute(job);
+				state.Threads[index]->Counters.Jobs.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			static void WorkerLoop(uint32_t index)
+			{
+				JobSystemState& state = GetState();
+				t_ThreadIndex = index;
+				uint32_t idle = 0;
+				while (state.Running.load(std::memory_order_acquire))
+				{
+					uint64_t epoch = state.Epoch.load();
+					if (Job* job = GetJob(state, index)) {
+						ExecuteCounted(state, index, job);
+						idle = 0;
+						continue;
+					}
+					if (++idle < IdleSpins) {
+						std::this_thread::yield();
+						continue;
+					}
+
+					// a push after the epoch was read moves it and keeps the worker awake
+					std::unique_lock<std::mutex> lock(state.SleepMutex);
+					state.Sleepers++;
+					state.SleepCondition.wait(lock, [&]() { return state.Epoch.load() != epoch || !state.Running.load(); });
+					state.Sleepers--;
+					idle = 0;
+				}
+				t_ThreadIndex = ~0u;
+			}
+
+			static void PinThread(std::thread& thread, uint32_t core)
+			{
+#ifdef _WIN32
+				SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << (core % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+				cpu_set_t cores;
+				CPU_ZERO(&cores);
+				CPU_SET(core, &cores);
+				pthread_setaffinity_np(thread.native_handle(), sizeof(cores), &cores);
+#else
+				(void)thread;
+				(void)core;
+#endif
+			}
+
+			Job* AllocateJob(Job::Function run, Job* parent)
+			{
+				JobRing& ring = t_Ring;
+				if (!ring.Jobs)
+					ring.Jobs = std::make_unique<Job[]>(MaxJobsPerThread);
+
+				// the slots are reused in order, skipping the ones still in flight; when every one of
+				// them is, the thread helps until one finishes
+				Job* job = nullptr;
+				for (uint32_t attempt = 0; !job; attempt++)
+				{
+					Job* candidate = &ring.Jobs[ring.Next++ & (MaxJobsPerThread - 1)];
+					if (IsFinished(candidate))
+						job = candidate;
+					else if (attempt >= MaxJobsPerThread) {
+						JobSystemState& state = GetState();
+						Job* other = t_ThreadIndex != ~0u ? GetJob(state, t_ThreadIndex) : nullptr;
+						if (other)
+							ExecuteCounted(state, t_ThreadIndex, other);
+						else
+							std::this_thread::yield();
+					}
+				}
+
+				job->Run = run;
+				job->Parent = parent;
+				job->Unfinished.store(1, std::memory_order_relaxed);
+				if (parent)
+					parent->Unfinished.fetch_add(1, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		void Initialize(const Specification& specification)
+		{
+			Utils::JobSystemState& state = Utils::GetState();
+			if (state.Running)
+				Shutdown();
+
+			uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+			uint32_t workers = specification.WorkerCount == ~0u ? hardwareThreads - 1 : specification.WorkerCount;
+
+			// every deque exists before a worker can look for one to steal from
+			for (uint32_t i = 0; i <= workers; i++)
+			{
+				state.Threads.push_back(std::make_unique<Utils::JobThread>());
+				state.Threads.back()->Random = 0x9E3779B9u * (i + 1);
+			}
+			Utils::t_ThreadIndex = 0;
+			state.Running = true;
+			for (uint32_t i = 1; i <= workers; i++)
+			{
+				state.Threads[i]->Thread = std::thread(Utils::WorkerLoop, i);
+				if (specification.PinWorkers)
+					Utils::PinThread(state.Threads[i]->Thread, i % hardwareThreads);
+			}
+		}
+
+		void Shutdown()
+		{
+			Utils::JobSystemState& state = Utils::GetState();
+			if (!state.Running)
+				return;
+			{
+				std::lock_guard<std::mutex> lock(state.SleepMutex);
+				state.Running = false;
+				state.SleepCondition.notify_all();
+			}
+			for (auto& thread : state.Threads)
+			{
+				if (thread->Thread.joinable())
+					thread->Thread.join();
+			}
+			state.Threads.clear();
+			state.Injected.clear();
+			state.InjectedCount = 0;
+			Utils::t_ThreadIndex = ~0u;
+		}
+
+		uint32_t GetThreadCount()
+		{
+			Utils::JobSystemState& state = Utils::GetState();
+			return state.Running ? (uint32_t)state.Threads.size() : 1;
+		}
+
+		uint32_t GetThreadIndex()
+		{
+			return Utils::t_ThreadIndex;
+		}
+
+		void Run(Job* job)
+		{
+			Utils::JobSystemState& state = Utils::GetState();
+			uint32_t index = Utils::t_ThreadIndex;
+			// without workers nobody would take it from the queue
+			if (!state.Running.load(std::memory_order_relaxed) || (index == ~0u && state.Threads.size() == 1)) {
+				Utils::Execute(job);
+				return;
+			}
+
+			if (index == ~0u) {
+				std::lock_guard<std::mutex> lock(state.InjectMutex);
+				state.Injected.push_back(job);
+				state.InjectedCount.fetch_add(1, std::memory_order_release);
+			}
+			else {
+				Utils::JobThread& thread = *state.Threads[index];
+				if (!thread.Deque.Push(job)) {
+					thread.Counters.Inline.fetch_add(1, std::memory_order_relaxed);
+					Utils::ExecuteCounted(state, index, job);
+					return;
+				}
+			}
+
+			state.Epoch.fetch_add(1);
+			if (state.Sleepers.load()) {
+				std::lock_guard<std::mutex> lock(state.SleepMutex);
+				state.SleepCondition.notify_one();
+			}
+		}
+
+		void Wait(const Job* job)
+		{
+			Utils::JobSystemState& state = Utils::GetState();
+			uint32_t index = Utils::t_ThreadIndex;
+			while (!IsFinished(job))
+			{
+				Job* other = index != ~0u && state.Running.load(std::memory_order_relaxed) ? Utils::GetJob(state, index) : nullptr;
+				if (other)
+					Utils::ExecuteCounted(state, index, other);
+				else
+					std::this_thread::yield();
+			}
+		}
+
+		Statistics GetStatistics()
+		{
+			Statistics statistics;
+			for (auto& thread : Utils::GetState().Threads)
+			{
+				statistics.Jobs += thread->Counters.Jobs.load(std::memory_order_relaxed);
+				statistics.Steals += thread->Counters.Steals.load(std::memory_order_relaxed);
+				statistics.StealAttempts += thread->Counters.StealAttempts.load(std::memory_order_relaxed);
+				statistics.Inline += thread->Counters.Inline.load(std::memory_order_relaxed);
+				statistics.Injected += thread->Counters.Injected.load(std::memory_order_relaxed);
+			}
+			return statistics;
+		}
+
+		void ResetStatistics()
+		{
+			for (auto& thread : Utils::GetState().Threads)
+			{
+				thread->Counters.Jobs = 0;
+				thread->Counters.Steals = 0;
+				thread->Counters.StealAttempts = 0;
+				thread->Counters.Inline = 0;
+				thread->Counters.Injected = 0;
+			}
+		}
+
+		namespace Utils {
+
+			// a few microseconds of floating point work, the same on every thread count
+			static double Kernel(uint32_t seed, uint32_t iterations)
+			{
+				double value = seed;
+				for (uint32_t i = 0; i < iterations; i++)
+					value = std::sin(value) * 0.5 + std::cos(value + i) * 0.5;
+				return value;
+			}
+
+			static void ForkJoin(uint32_t depth, uint32_t node, std::vector<double>& leaves, Job* parent)
+			{
+				if (!depth) {
+					leaves[node - leaves.size()] = Kernel(node, 500);
+					return;
+				}
+				Run(Create([depth, node, &leaves, parent]() { ForkJoin(depth - 1, node * 2, leaves, parent); }, parent));
+				ForkJoin(depth - 1, node * 2 + 1, leaves, parent);
+			}
+		}
+
+		void RunBenchmark(std::ostream& out)
+		{
+			static constexpr uint32_t SpawnJobs = 1 << 18;
+			static constexpr uint32_t ForkJoinDepth = 12;	// 4096 leaves
+			static constexpr uint32_t ParallelForItems = 1 << 14;
+			static constexpr int Runs = 5;
+
+			// up to the threads it was started with, when that's more than the hardware has
+			uint32_t maxThreads = std::max({ 1u, std::thread::hardware_concurrency(), GetThreadCount() });
+			out << "JobSystem: best of " << Runs << " runs, " << SpawnJobs << " empty jobs, fork-join over "
+				<< (1u << ForkJoinDepth) << " leaves, parallel_for over " << ParallelForItems << " items" << std::endl;
+
+			std::vector<double> referenceLeaves, referenceItems;
+			double forkJoinBase = 0.0, parallelForBase = 0.0;
+			for (uint32_t threads = 1; threads <= maxThreads; threads++)
+			{
+				Specification specification;
+				specification.WorkerCount = threads - 1;
+				Initialize(specification);
+
+				// spawn overhead: create, run and finish empty children of one parent, from one thread
+				double spawnTime = 1e30;
+				for (int run = 0; run < Runs; run++)
+				{
+					auto start = std::chrono::steady_clock::now();
+					for (uint32_t batch = 0; batch < SpawnJobs; batch += MaxJobsPerThread / 2)
+					{
+						Job* root = Create([]() {});
+						for (uint32_t i = 0; i < MaxJobsPerThread / 2 - 1; i++)
+							Run(Create([]() {}, root));
+						Run(root);
+						Wait(root);
+					}
+					spawnTime = std::min(spawnTime, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+				}
+
+				// fork-join: a binary tree of jobs, every inner node forks one child and recurses
+				std::vector<double> leaves(1u << ForkJoinDepth);
+				double forkJoinTime = 1e30;
+				Statistics forkJoinStatistics;
+				for (int run = 0; run < Runs; run++)
+				{
+					ResetStatistics();
+					auto start = std::chrono::steady_clock::now();
+					Job* root = nullptr;
+					root = Create([&]() { Utils::ForkJoin(ForkJoinDepth, 1, leaves, root); });
+					Run(root);
+					Wait(root);
+					double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+					if (time < forkJoinTime) {
+						forkJoinTime = time;
+						forkJoinStatistics = GetStatistics();
+					}
+				}
+
+				// parallel_for with the automatic grain
+				std::vector<double> items(ParallelForItems);
+				double parallelForTime = 1e30;
+				for (int run = 0; run < Runs; run++)
+				{
+					auto start = std::chrono::steady_clock::now();
+					ParallelFor(ParallelForItems, [&](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t i = begin; i < end; i++)
+							items[i] = Utils::Kernel(i, 100);
+					});
+					parallelForTime = std::min(parallelForTime, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+				}
+
+				if (threads == 1) {
+					referenceLeaves = leaves;
+					referenceItems = items;
+					forkJoinBase = forkJoinTime;
+					parallelForBase = parallelForTime;
+				}
+
+				out << "  threads: " << threads
+					<< "  spawn: " << spawnTime / SpawnJobs << " ns/job"
+					<< "  fork-join: " << forkJoinTime << " ms (speedup " << forkJoinBase / forkJoinTime
+					<< ", " << 100.0 * forkJoinStatistics.Steals / std::max<uint64_t>(forkJoinStatistics.Jobs, 1) << "% stolen, "
+					<< forkJoinStatistics.StealAttempts << " attempts)"
+					<< "  parallel_for: " << parallelForTime << " ms (speedup " << parallelForBase / parallelForTime << ")"
+					<< "  identical: " << (leaves == referenceLeaves && items == referenceItems ? "yes" : "NO") << std::endl;
+			}
+
+			Initialize();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <ostream>
+#include <utility>
+#include <type_traits>
+#include <new>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// Work-stealing job system. The thread that calls Initialize() becomes thread 0 and the workers
+	// threads 1..N; each has a Chase-Lev deque it pushes its jobs onto and pops them back from, and
+	// an idle thread steals the oldest job of another. Jobs are small fixed size records taken from a
+	// ring owned by the creating thread, so creating one neither locks nor allocates.
+	//
+	// A job created with a parent keeps the parent unfinished until it is done itself, so waiting on
+	// a parent waits for everything spawned under it. Wait() runs other jobs while it waits instead
+	// of blocking, which is also how the main thread lends a hand. Idle workers sleep until a job is
+	// pushed.
+	//
+	// Threads that aren't part of the system, like a render thread, hand their jobs to the workers
+	// through a locked queue the workers check before they steal; only the workers take from it, so
+	// thread 0 doesn't pick up long jobs while it waits for its own. Such threads wait for a job by
+	// yielding, and their ParallelFor() runs serially. Before Initialize(), or without workers,
+	// Run() executes the job right away, so code using the jobs works without it.
+	namespace JobSystem {
+
+		struct Specification
+		{
+			uint32_t WorkerCount = ~0u;	// default: one per hardware thread besides the calling one
+			// Pins worker i to core i, leaving core 0 to the calling thread; only a hint, the OS
+			// may not allow it.
+			bool PinWorkers = false;
+		};
+
+		struct alignas(64) Job
+		{
+			static constexpr size_t Size = 128;
+			using Function = void(*)(Job&);
+
+			Function Run = nullptr;
+			Job* Parent = nullptr;
+			std::atomic<int32_t> Unfinished{ 0 };	// itself and its children
+			alignas(16) unsigned char Data[Size - 32];	// the callable
+		};
+
+		struct Statistics
+		{
+			uint64_t Jobs = 0;			// executed
+			uint64_t Steals = 0;		// of the executed jobs, the ones taken from another thread
+			uint64_t StealAttempts = 0;
+			uint64_t Inline = 0;		// run right away because a deque was full
+			uint64_t Injected = 0;		// of the executed jobs, the ones threads outside the system submitted
+		};
+
+		// Size of every thread's ring of jobs and of its deque. A ring skips the jobs still in flight
+		// when it wraps around.
+		static constexpr uint32_t MaxJobsPerThread = 4096;
+
+		void Initialize(const Specification& specification = Specification());
+		// Waits for nothing; every job has to be finished.
+		void Shutdown();
+
+		// 1 when not initialized
+		uint32_t GetThreadCount();
+		// of the calling thread, ~0u for threads that aren't part of the system
+		uint32_t GetThreadIndex();
+
+		namespace Utils {
+
+			Job* AllocateJob(Job::Function run, Job* parent);
+
+			template<typename F>
+			void RunCallable(Job& job)
+			{
+				F& function = *std::launder(reinterpret_cast<F*>(job.Data));
+				function();
+				function.~F();
+			}
+		}
+
+		// Not started until Run(); parent is optional.
+		template<typename F>
+		Job* Create(F&& function, Job* parent = nullptr)
+		{
+			using Callable = std::decay_t<F>;
+			static_assert(sizeof(Callable) <= sizeof(Job::Data), "capture less or capture by reference");
+			static_assert(alignof(Callable) <= 16, "the job's data is 16 byte aligned");
+			Job* job = Utils::AllocateJob(&Utils::RunCallable<Callable>, parent);
+			new (job->Data) Callable(std::forward<F>(function));
+			return job;
+		}
+
+		void Run(Job* job);
+		// Runs jobs until job and its children are finished.
+		void Wait(const Job* job);
+		inline bool IsFinished(const Job* job) { return job->Unfinished.load(std::memory_order_acquire) == 0; }
+
+		// Calls function(begin, end) on disjoint ranges covering [0, count) and returns once all of them
+		// are done. The range is split in halves, each half a job, until it is no larger than grainSize;
+		// 0 picks a grain that gives every thread about eight ranges.
+		template<typename F>
+		void ParallelFor(uint32_t count, const F& function, uint32_t grainSize = 0)
+		{
+			if (!count)
+				return;
+			uint32_t threads = GetThreadCount();
+			if (!grainSize)
+				grainSize = count / (threads * 8) + 1;
+			if (threads == 1 || count <= grainSize || GetThreadIndex() == ~0u) {
+				function(0u, count);
+				return;
+			}
+
+			struct Split
+			{
+				static void Range(const F& function, uint32_t begin, uint32_t end, uint32_t grainSize, Job* parent)
+				{
+					// keeps the left half and hands the right one out, so the largest pieces are the
+					// ones left to steal
+					while (end - begin > grainSize)
+					{
+						uint32_t middle = begin + (end - begin) / 2;
+						Run(Create([&function, middle, end, grainSize, parent]() { Range(function, middle, end, grainSize, parent); }, parent));
+						end = middle;
+					}
+					function(begin, end);
+				}
+			};
+
+			Job* root = nullptr;
+			root = Create([&]() { Split::Range(function, 0, count, grainSize, root); });
+			Run(root);
+			Wait(root);
+		}
+
+		// summed over every thread since Initialize() or the last reset
+		Statistics GetStatistics();
+		void ResetStatistics();
+
+		// Spawn overhead, steal rate and fork-join scaling for 1..N threads, N the hardware threads or
+		// the threads it runs on, whichever is more. Initializes the job system once per thread count
+		// and leaves it initialized with the default specification.
+		void RunBenchmark(std::ostream& out);
+	}
+}
@@ -0,0 +1,215 @@
+#include "MSDFAtlasGenerator.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "PixelBlit.h"
+#include "FontLibrary.h"
+#include "Profiler.h"
+#include "JobSystem.h"
+#include "msdfgen.h"
+#include "msdfgen-ext.h"
+
+namespace OpenGLSandbox {
+
+	MSDFAtlasGenerator::MSDFAtlasGenerator(const MSDFAtlasSpecification& specification)
+		: m_Specification(specification)
+	{
+	}
+
+	MSDFAtlasGenerator::~MSDFAtlasGenerator()
+	{
+	}
+
+	bool MSDFAtlasGenerator::Generate()
+	{
+		PROFILE_SCOPE("MSDF Atlas");
+		if (!PackGlyphs())
+			return false;
+
+		bool loaded = GenerateGlyphs();
+		CollectCharacters();
+		return loaded;
+	}
+
+	void MSDFAtlasGenerator::ExportCharacters(CharacterLibrary& library) const
+	{
+		for (const auto& [ch, character] : m_Characters)
+			library.Add(ch, character);
+	}
+
+	bool MSDFAtlasGenerator::GenerateGlyphs()
+	{
+		const MSDFAtlasSpecification& spec = m_Specification;
+
+		// FreeType faces are not thread safe, so every job thread opens its own face over the shared
+		// font mapping the first time it gets a glyph. Each glyph is a job of its own and is written
+		// straight into its own atlas rect, which no other glyph overlaps.
+		struct ThreadFont
+		{
+			FT_Face Face = nullptr;
+			msdfgen::FontHandle* Font = nullptr;
+			bool Failed = false;
+		};
+		std::vector<ThreadFont> fonts(JobSystem::GetThreadCount());
+		std::atomic<bool> fontLoaded = true;
+
+		JobSystem::ParallelFor((uint32_t)m_Glyphs.size(), [&](uint32_t begin, uint32_t end)
+		{
+			PROFILE_SCOPE("MSDF Glyphs");
+			uint32_t thread = JobSystem::GetThreadIndex();
+			ThreadFont& font = fonts[thread < fonts.size() ? thread : 0];
+			if (!font.Font && !font.Failed) {
+				font.Face = FontLibrary::OpenFace(spec.FontFilepath);
+				font.Font = font.Face ? msdfgen::adoptFreetypeFont(font.Face) : nullptr;
+				font.Failed = !font.Font;
+			}
+			if (font.Failed) {
+				fontLoaded = false;
+				return;
+			}
+
+			msdfgen::Bitmap<float, 3> msdf(spec.GlyphWidth, spec.GlyphHeight);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				GlyphCell& glyph = m_Glyphs[i];
+
+				msdfgen::Shape shape;
+				if (!msdfgen::loadGlyph(shape, font.Font, glyph.Codepoint))
+					continue;
+
+				shape.normalize();
+				shape.inverseYAxis = true; // horizontal flip
+				msdfgen::edgeColoringSimple(shape, spec.EdgeColoringAngle);
+
+				//output, shape, range, scale, translation
+				msdfgen::generateMSDF(msdf, shape, spec.Range, spec.Scale, msdfgen::Vector2(spec.Translation.x, spec.Translation.y));
+
+				const PackedRect& rect = glyph.Rect;
+				PixelBlit::BlitFloatToBytes((const float*)msdf, msdf.width(), msdf.height(), 3,
+					&m_Pixels[((size_t)rect.Y * m_Width + rect.X) * 3], (size_t)m_Width * 3, true);
+				glyph.Loaded = true;
+			}
+		}, 1);
+
+		for (ThreadFont& font : fonts)
+		{
+			// an adopted font leaves the face alone
+			if (font.Font)
+				msdfgen::destroyFont(font.Font);
+			FontLibrary::CloseFace(font.Face);
+		}
+		return fontLoaded;
+	}
+
+	bool MSDFAtlasGenerator::PackGlyphs()
+	{
+		const MSDFAtlasSpecification& spec = m_Specification;
+
+		// every glyph has the same cell size, so the layout is known before any glyph is generated
+		m_Glyphs.clear();
+		std::vector<PackedRect> rects;
+		for (unsigned int ch = spec.FirstCharacter; ch < spec.LastCharacter; ch++)
+		{
+			GlyphCell glyph;
+			glyph.Codepoint = ch;
+			m_Glyphs.push_back(glyph);
+
+			PackedRect rect;
+			rect.Width = spec.GlyphWidth;
+			rect.Height = spec.GlyphHeight;
+			rects.push_back(rect);
+		}
+
+		RectPackerSpecification packing = spec.Packing;
+		packing.AllowRotation = false;
+
+		m_Characters.clear();
+		m_Pixels.clear();
+		m_Width = m_Height = 0;
+		if (!RectPacker::Pack(rects, packing, m_PackingReport))
+			return false;
+
+		for (size_t i = 0; i < m_Glyphs.size(); i++)
+			m_Glyphs[i].Rect = rects[i];
+
+		m_Width = m_PackingReport.AtlasWidth;
+		m_Height = m_PackingReport.AtlasHeight;
+		m_Pixels.assign((size_t)m_Width * m_Height * 3, 0);
+		return true;
+	}
+
+	void MSDFAtlasGenerator::CollectCharacters()
+	{
+		// glyphs are visited in codepoint order, so the result does not depend on which worker made them
+		for (const GlyphCell& glyph : m_Glyphs)
+		{
+			if (!glyph.Loaded)
+				continue;
+
+			const PackedRect& rect = glyph.Rect;
+			CharacterSDF character;
+			character.x0 = rect.X;
+			character.y0 = rect.Y;
+			character.x1 = rect.X + rect.Width;
+			character.y1 = rect.Y + rect.Height;
+			character.m_Bearing.x = 0;
+			character.m_Bearing.y = 0;
+			character.m_Advance = rect.Width;
+			character.m_Size = glm::ivec2(rect.Width, rect.Height);
+			m_Characters.emplace_back((unsigned char)glyph.Codepoint, character);
+		}
+	}
+
+	void MSDFAtlasGenerator::RunBenchmark(std::ostream& out)
+	{
+		// the job system is brought up with every thread count in turn
+		unsigned int maxThreads = std::max({ 1u, std::thread::hardware_concurrency(), JobSystem::GetThreadCount() });
+
+		std::vector<std::filesystem::path> fonts;
+		for (const auto& entry : std::filesystem::directory_iterator("res/Fonts/OpenSans"))
+			if (entry.path().extension() == ".ttf")
+				fonts.push_back(entry.path());
+		std::sort(fonts.begin(), fonts.end());
+
+		for (const auto& fontpath : fonts)
+		{
+			MSDFAtlasSpecification spec;
+			spec.FontFilepath = fontpath.string();
+			out << spec.FontFilepath << std::endl;
+
+			std::vector<unsigned char> reference;
+			double singleThreadRate = 0.0;
+			for (unsigned int threads = 1; threads <= maxThreads; threads++)
+			{
+				JobSystem::Specification jobs;
+				jobs.WorkerCount = threads - 1;
+				JobSystem::Initialize(jobs);
+
+				MSDFAtlasGenerator generator(spec);
+				auto start = std::chrono::steady_clock::now();
+				if (!generator.Generate()) {
+					out << "  failed to load font" << std::endl;
+					break;
+				}
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+				double glyphsPerSecond = generator.GetGlyphCount() / elapsed.count();
+				if (threads == 1) {
+					reference = generator.GetPixels();
+					singleThreadRate = glyphsPerSecond;
+				}
+
+				out << "  threads: " << threads
+					<< "  glyphs/sec: " << glyphsPerSecond
+					<< "  speedup: " << glyphsPerSecond / singleThreadRate
+					<< "  identical: " << (generator.GetPixels() == reference ? "yes" : "NO") << std::endl;
+			}
+		}
+		JobSystem::Initialize();
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <glm/glm.hpp>
+#include "CharacterLibrary.h"
+#include "RectPacker.h"
+
+namespace OpenGLSandbox {
+
+	struct MSDFAtlasSpecification
+	{
+		std::string FontFilepath;
+		unsigned int FirstCharacter = 33;	// first codepoint in the atlas
+		unsigned int LastCharacter = 126;	// one past the last codepoint in the atlas
+		int GlyphWidth = 68;
+		int GlyphHeight = 68;
+		double Range = 4.0;					// distance field range in shape units
+		double Scale = 2.0;
+		glm::dvec2 Translation = { 4.0, 4.0 };
+		double EdgeColoringAngle = 3.0;		// max. angle for msdfgen::edgeColoringSimple
+		RectPackerSpecification Packing;	// rotation is ignored, glyph quads expect upright glyphs
+	};
+
+	// Builds an MSDF font atlas in two stages:
+	//   1. a serial stage that packs one fixed size cell per codepoint,
+	//   2. a parallel stage where every glyph is a job; each job thread owns a FreeType face,
+	//      generates glyph bitmaps and blits them straight into their cell.
+	// Each glyph only depends on its own shape, so the atlas is byte-identical for any thread count.
+	class MSDFAtlasGenerator
+	{
+	public:
+		MSDFAtlasGenerator(const MSDFAtlasSpecification& specification);
+		~MSDFAtlasGenerator();
+
+		// on every thread of the job system
+		bool Generate();
+		void ExportCharacters(CharacterLibrary& library) const;
+
+		inline const std::vector<std::pair<unsigned char, CharacterSDF>>& GetCharacters() const { return m_Characters; }
+		inline const std::vector<unsigned char>& GetPixels() const { return m_Pixels; }
+		inline int GetWidth() const { return m_Width; }
+		inline int GetHeight() const { return m_Height; }
+		inline int GetGlyphCount() const { return (int)m_Characters.size(); }
+		inline const PackingReport& GetPackingReport() const { return m_PackingReport; }
+
+		// Reports glyphs/sec for 1..N threads on every face in res/Fonts/OpenSans.
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		struct GlyphCell
+		{
+			unsigned int Codepoint = 0;
+			bool Loaded = false;
+			PackedRect Rect;
+		};
+
+		bool PackGlyphs();
+		bool GenerateGlyphs();
+		void CollectCharacters();
+
+	private:
+		MSDFAtlasSpecification m_Specification;
+
+		std::vector<GlyphCell> m_Glyphs;
+		std::vector<std::pair<unsigned char, CharacterSDF>> m_Characters;
+
+		std::vector<unsigned char> m_Pixels;
+		int m_Width = 0;
+		int m_Height = 0;
+		PackingReport m_PackingReport;
+	};
+}
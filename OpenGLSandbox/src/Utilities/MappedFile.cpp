@@ -0,0 +1,109 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace OpenGLSandbox {
+
+	MappedFile::MappedFile()
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::string& filepath)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		m_FileHandle = file;
+		m_MappingHandle = mapping;
+		m_Data = (const unsigned char*)data;
+		m_Size = (size_t)size.QuadPart;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_Data)
+			UnmapViewOfFile(m_Data);
+		if (m_MappingHandle)
+			CloseHandle(m_MappingHandle);
+		if (m_FileHandle)
+			CloseHandle(m_FileHandle);
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_MappingHandle = nullptr;
+		m_FileHandle = nullptr;
+	}
+#else
+	bool MappedFile::Open(const std::string& filepath)
+	{
+		Close();
+
+		int fd = open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			return false;
+		}
+
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// the mapping keeps its own reference to the file
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+
+		m_Data = (const unsigned char*)data;
+		m_Size = (size_t)info.st_size;
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_Data)
+			munmap((void*)m_Data, m_Size);
+
+		m_Data = nullptr;
+		m_Size = 0;
+	}
+#endif
+}
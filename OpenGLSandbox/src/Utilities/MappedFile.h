@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+namespace OpenGLSandbox {
+
+	// Read-only memory mapping of a whole file. The pages stay valid until Close() or destruction.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool Open(const std::string& filepath);
+		void Close();
+
+		inline bool IsOpen() const { return m_Data != nullptr; }
+		inline const unsigned char* GetData() const { return m_Data; }
+		inline size_t GetSize() const { return m_Size; }
+
+	private:
+		const unsigned char* m_Data = nullptr;
+		size_t m_Size = 0;
+#ifdef _WIN32
+		void* m_FileHandle = nullptr;
+		void* m_MappingHandle = nullptr;
+#endif
+	};
+}
@@ -0,0 +1,281 @@
+#include "PixelBlit.h"
+#include <vector>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define PIXEL_BLIT_X86 1
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define PIXEL_BLIT_TARGET(isa)
+	#else
+		#include <immintrin.h>
+		#define PIXEL_BLIT_TARGET(isa) __attribute__((target(isa)))
+	#endif
+#endif
+
+namespace OpenGLSandbox {
+
+	namespace PixelBlit {
+
+		namespace Utils {
+
+			inline unsigned char FloatToByte(float x)
+			{
+				float n = 256.0f * x;
+				return (unsigned char)(n >= 0.0f && n <= 255.0f ? n : float(n > 0.0f) * 255.0f);
+			}
+
+			static void ConvertScalar(const float* src, unsigned char* dst, size_t count)
+			{
+				for (size_t i = 0; i < count; i++)
+					dst[i] = FloatToByte(src[i]);
+			}
+
+#ifdef PIXEL_BLIT_X86
+			// max(x, 0) returns its second operand for NaN, so NaN becomes 0 like in the scalar clamp
+			PIXEL_BLIT_TARGET("sse2")
+			inline __m128i ClampToIntegers(const float* src)
+			{
+				__m128 x = _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(256.0f));
+				return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(255.0f)));
+			}
+
+			PIXEL_BLIT_TARGET("sse2")
+			static void ConvertSSE2(const float* src, unsigned char* dst, size_t count)
+			{
+				size_t i = 0;
+				for (; i + 16 <= count; i += 16)
+				{
+					__m128i a = _mm_packs_epi32(ClampToIntegers(src + i), ClampToIntegers(src + i + 4));
+					__m128i b = _mm_packs_epi32(ClampToIntegers(src + i + 8), ClampToIntegers(src + i + 12));
+					_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+				}
+				ConvertScalar(src + i, dst + i, count - i);
+			}
+
+			PIXEL_BLIT_TARGET("avx2")
+			inline __m256i ClampToIntegers256(const float* src)
+			{
+				__m256 x = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_set1_ps(256.0f));
+				return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(255.0f)));
+			}
+
+			PIXEL_BLIT_TARGET("avx2")
+			static void ConvertAVX2(const float* src, unsigned char* dst, size_t count)
+			{
+				// the packs work per 128 bit lane, this puts the 4 byte groups back in order
+				const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+				size_t i = 0;
+				for (; i + 32 <= count; i += 32)
+				{
+					__m256i a = _mm256_packs_epi32(ClampToIntegers256(src + i), ClampToIntegers256(src + i + 8));
+					__m256i b = _mm256_packs_epi32(ClampToIntegers256(src + i + 16), ClampToIntegers256(src + i + 24));
+					_mm256_storeu_si256((__m256i*)(dst + i), _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a, b), order));
+				}
+				// the tail runs legacy SSE code, which stalls while the upper halves of the YMM registers are dirty
+				_mm256_zeroupper();
+				ConvertSSE2(src + i, dst + i, count - i);
+			}
+
+			static bool HasAVX2()
+			{
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 0);
+				if (info[0] < 7)
+					return false;
+				__cpuid(info, 1);
+				bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+				// the OS has to save the YMM registers as well
+				if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+					return false;
+				__cpuidex(info, 7, 0);
+				return (info[1] & (1 << 5)) != 0;
+#else
+				return __builtin_cpu_supports("avx2");
+#endif
+			}
+#endif
+
+			static void BlitRows(const float* src, int width, int height, int channels, unsigned char* dst, size_t dstStride, bool flipY, InstructionSet instructionSet)
+			{
+				size_t rowLength = (size_t)width * channels;
+				for (int y = 0; y < height; y++)
+				{
+					const float* row = src + (size_t)(flipY ? height - 1 - y : y) * rowLength;
+					ConvertFloatToBytes(row, dst + y * dstStride, rowLength, instructionSet);
+				}
+			}
+		}
+
+		InstructionSet GetInstructionSet()
+		{
+#ifdef PIXEL_BLIT_X86
+			static const InstructionSet instructionSet = Utils::HasAVX2() ? InstructionSet::AVX2 : InstructionSet::SSE2;
+			return instructionSet;
+#else
+			return InstructionSet::Scalar;
+#endif
+		}
+
+		const char* GetInstructionSetName(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+				case InstructionSet::SSE2: return "SSE2";
+				case InstructionSet::AVX2: return "AVX2";
+				default: return "scalar";
+			}
+		}
+
+		void ConvertFloatToBytes(const float* src, unsigned char* dst, size_t count, InstructionSet instructionSet)
+		{
+			// never run code the CPU can't execute, whatever the caller asked for
+			if (instructionSet > GetInstructionSet())
+				instructionSet = GetInstructionSet();
+
+			switch (instructionSet)
+			{
+#ifdef PIXEL_BLIT_X86
+				case InstructionSet::AVX2: Utils::ConvertAVX2(src, dst, count); break;
+				case InstructionSet::SSE2: Utils::ConvertSSE2(src, dst, count); break;
+#endif
+				default: Utils::ConvertScalar(src, dst, count); break;
+			}
+		}
+
+		void BlitFloatToBytes(const float* src, int width, int height, int channels, unsigned char* dst, size_t dstStride, bool flipY)
+		{
+			Utils::BlitRows(src, width, height, channels, dst, dstStride, flipY, GetInstructionSet());
+		}
+
+		bool RunSelfCheck(std::ostream& out)
+		{
+			std::vector<float> values = {
+				0.0f, -0.0f, 1.0f, 0.5f, -1.0f, 2.0f, 255.0f / 256.0f, 254.999f / 256.0f, 1e-30f, -1e-30f,
+				std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(),
+				std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN()
+			};
+			// every byte boundary and its neighbours
+			for (int i = 0; i <= 256; i++)
+			{
+				float x = i / 256.0f;
+				values.push_back(x);
+				values.push_back(std::nextafter(x, -1.0f));
+				values.push_back(std::nextafter(x, 2.0f));
+			}
+			std::mt19937 random(1337);
+			std::uniform_real_distribution<float> distribution(-0.5f, 1.5f);
+			for (int i = 0; i < 100000; i++)
+				values.push_back(distribution(random));
+
+			bool passed = true;
+			for (int set = (int)InstructionSet::SSE2; set <= (int)GetInstructionSet(); set++)
+			{
+				InstructionSet instructionSet = (InstructionSet)set;
+				size_t mismatches = 0;
+
+				// every length and start offset around the vector widths, so tails and unaligned loads are covered
+				std::vector<unsigned char> expected(values.size()), actual(values.size());
+				for (size_t offset = 0; offset < 8; offset++)
+					for (size_t count = 0; count <= 80; count++)
+					{
+						Utils::ConvertScalar(values.data() + offset, expected.data(), count);
+						ConvertFloatToBytes(values.data() + offset, actual.data(), count, instructionSet);
+						mismatches += memcmp(expected.data(), actual.data(), count) != 0;
+					}
+				Utils::ConvertScalar(values.data(), expected.data(), values.size());
+				ConvertFloatToBytes(values.data(), actual.data(), values.size(), instructionSet);
+				for (size_t i = 0; i < values.size(); i++)
+					mismatches += expected[i] != actual[i];
+
+				// a flipped blit into the middle of a larger image must not touch the bytes around it
+				const int width = 37, height = 23, channels = 3, stride = 200;
+				std::vector<unsigned char> expectedImage(stride * (height + 2), 0xCD), actualImage = expectedImage;
+				for (int y = 0; y < height; y++)
+					Utils::ConvertScalar(values.data() + (size_t)(height - 1 - y) * width * channels, &expectedImage[(y + 1) * stride + 5], width * channels);
+				Utils::BlitRows(values.data(), width, height, channels, &actualImage[stride + 5], stride, true, instructionSet);
+				mismatches += expectedImage != actualImage;
+
+				out << "  " << GetInstructionSetName(instructionSet) << ": " << (mismatches ? "MISMATCH" : "matches scalar") << std::endl;
+				passed &= mismatches == 0;
+			}
+			if (GetInstructionSet() == InstructionSet::Scalar)
+				out << "  no SIMD support, scalar only" << std::endl;
+			return passed;
+		}
+
+		void RunBenchmark(std::ostream& out)
+		{
+			out << "self check" << std::endl;
+			if (!RunSelfCheck(out))
+				return;
+
+			// the default MSDF glyph cell in an atlas of 16 x 16 cells
+			const int glyphSize = 68, channels = 3, columns = 16, glyphs = columns * columns, repeats = 20;
+			const size_t atlasStride = (size_t)columns * glyphSize * channels;
+
+			std::mt19937 random(42);
+			std::uniform_real_distribution<float> distribution(-0.25f, 1.25f);
+			std::vector<std::vector<float>> bitmaps(16);
+			for (std::vector<float>& bitmap : bitmaps)
+			{
+				bitmap.resize((size_t)glyphSize * glyphSize * channels);
+				for (float& x : bitmap)
+					x = distribution(random);
+			}
+			std::vector<unsigned char> atlas(atlasStride * columns * glyphSize);
+
+			auto measure = [&](const char* name, auto&& blitGlyph, double baseline)
+			{
+				auto start = std::chrono::steady_clock::now();
+				for (int r = 0; r < repeats; r++)
+					for (int i = 0; i < glyphs; i++)
+					{
+						unsigned char* cell = &atlas[(i / columns) * glyphSize * atlasStride + (i % columns) * glyphSize * channels];
+						blitGlyph(bitmaps[i % bitmaps.size()].data(), cell);
+					}
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				double pixelsPerSecond = (double)glyphs * repeats * glyphSize * glyphSize / elapsed.count();
+				out << "  " << name << "  Mpixels/sec: " << pixelsPerSecond / 1e6;
+				if (baseline > 0.0)
+					out << "  speedup: " << pixelsPerSecond / baseline;
+				out << std::endl;
+				return pixelsPerSecond;
+			};
+
+			out << glyphs << " glyphs of " << glyphSize << "x" << glyphSize << " RGB, " << repeats << " times" << std::endl;
+
+			// previous pipeline: convert into a per glyph vector, then copy that into the atlas
+			std::vector<unsigned char> glyphPixels;
+			double baseline = measure("scalar + copy (previous)", [&](const float* bitmap, unsigned char* cell)
+			{
+				glyphPixels.resize((size_t)glyphSize * glyphSize * channels);
+				auto it = glyphPixels.begin();
+				for (int y = glyphSize - 1; y >= 0; --y)
+					for (int x = 0; x < glyphSize * channels; ++x)
+						*it++ = Utils::FloatToByte(bitmap[(size_t)y * glyphSize * channels + x]);
+				for (int row = 0; row < glyphSize; ++row)
+					memcpy(cell + row * atlasStride, &glyphPixels[(size_t)row * glyphSize * channels], (size_t)glyphSize * channels);
+			}, 0.0);
+
+			for (int set = 0; set <= (int)GetInstructionSet(); set++)
+			{
+				InstructionSet instructionSet = (InstructionSet)set;
+				std::string name = std::string("blit ") + GetInstructionSetName(instructionSet);
+				name.resize(24, ' ');
+				measure(name.c_str(), [&](const float* bitmap, unsigned char* cell)
+				{
+					Utils::BlitRows(bitmap, glyphSize, glyphSize, channels, cell, atlasStride, true, instructionSet);
+				}, baseline);
+			}
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <ostream>
+#include <cstddef>
+
+namespace OpenGLSandbox {
+
+	// Converts float channels to bytes the way msdfgen's pixelFloatToByte does, (byte)clamp(256 * x, 255),
+	// with NaN mapping to 0. The SIMD paths produce exactly the scalar results.
+	namespace PixelBlit {
+
+		enum class InstructionSet
+		{
+			Scalar = 0, SSE2, AVX2
+		};
+
+		/// Best instruction set this CPU and build support, detected once.
+		InstructionSet GetInstructionSet();
+		const char* GetInstructionSetName(InstructionSet instructionSet);
+
+		void ConvertFloatToBytes(const float* src, unsigned char* dst, size_t count, InstructionSet instructionSet);
+		inline void ConvertFloatToBytes(const float* src, unsigned char* dst, size_t count) { ConvertFloatToBytes(src, dst, count, GetInstructionSet()); }
+
+		/// Writes a tightly packed width x height float bitmap with the given channel count straight into
+		/// a byte image whose rows are dstStride bytes apart. flipY turns msdfgen's bottom-up rows into
+		/// texture rows.
+		void BlitFloatToBytes(const float* src, int width, int height, int channels, unsigned char* dst, size_t dstStride, bool flipY);
+
+		/// Compares every instruction set against the scalar reference on edge values and random bitmaps.
+		bool RunSelfCheck(std::ostream& out);
+		/// Reports Mpixels/sec of the old per glyph conversion and of the blit for each instruction set.
+		void RunBenchmark(std::ostream& out);
+	}
+}
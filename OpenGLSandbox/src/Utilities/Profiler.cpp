@@ -0,0 +1,349 @@
+#include "Profiler.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <deque>
+#include <string_view>
+#include <cstring>
+
+namespace OpenGLSandbox {
+
+	namespace Profiler {
+
+		namespace Utils {
+
+			struct Event
+			{
+				uint64_t Start, End;
+				ZoneID Zone;
+				uint16_t Depth;
+			};
+
+			// Single producer (the owning thread), single consumer (Collect). Head and Tail only grow,
+			// the slot is the index modulo the capacity.
+			struct ThreadBuffer
+			{
+				static constexpr uint32_t Capacity = 1 << 13;
+
+				Event Events[Capacity];
+				std::atomic<uint64_t> Head = 0;
+				std::atomic<uint64_t> Tail = 0;
+				std::atomic<uint64_t> Dropped = 0;
+				uint16_t Depth = 0;
+				uint32_t ThreadID = 0;
+				bool InUse = true;	// guarded by the state's mutex
+			};
+
+			struct ZoneStatistics
+			{
+				const char* Name = nullptr;
+				uint64_t Count = 0;
+				uint16_t Depth = 0;
+				bool GPU = false;
+				std::vector<double> Samples;	// ring of SampleWindow ms values
+			};
+
+			struct CapturedEvent
+			{
+				Event Zone;
+				uint32_t ThreadID;
+			};
+
+			// lane of the zones from RecordGPUZone
+			static constexpr uint32_t GPUThreadID = ~0u;
+
+			struct ProfilerState
+			{
+				std::mutex Mutex;
+				std::vector<std::unique_ptr<ThreadBuffer>> Threads;
+				std::deque<std::string> ZoneNames;	// never moves, the map and the summaries point into it
+				std::unordered_map<std::string_view, ZoneID> ZoneIDs;
+				std::vector<ZoneStatistics> Zones;
+				uint64_t Epoch = Now();
+
+				bool Capturing = false;
+				size_t MaxCapturedEvents = 0;
+				std::vector<CapturedEvent> Captured;
+				uint64_t Dropped = 0;
+			};
+
+			// never destroyed, threads may still end zones during static destruction
+			static ProfilerState& GetState()
+			{
+				static ProfilerState* state = new ProfilerState();
+				return *state;
+			}
+
+			// Hands the thread's ring back when the thread exits. A later thread reuses it, so short
+			// lived workers don't add a ring each and show up as the same lane in the trace.
+			struct ThreadBufferOwner
+			{
+				ThreadBuffer* Buffer = nullptr;
+
+				~ThreadBufferOwner()
+				{
+					if (!Buffer)
+						return;
+					std::lock_guard<std::mutex> lock(GetState().Mutex);
+					Buffer->InUse = false;
+				}
+			};
+
+			static ThreadBuffer* AcquireThreadBuffer()
+			{
+				ProfilerState& state = GetState();
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				for (auto& buffer : state.Threads)
+				{
+					if (!buffer->InUse) {
+						buffer->InUse = true;
+						buffer->Depth = 0;
+						return buffer.get();
+					}
+				}
+				state.Threads.push_back(std::make_unique<ThreadBuffer>());
+				state.Threads.back()->ThreadID = (uint32_t)state.Threads.size() - 1;
+				return state.Threads.back().get();
+			}
+
+			static ThreadBuffer& GetThreadBuffer()
+			{
+				thread_local ThreadBufferOwner owner;
+				if (!owner.Buffer)
+					owner.Buffer = AcquireThreadBuffer();
+				return *owner.Buffer;
+			}
+
+			// with the state's mutex held
+			static void AddEvent(ProfilerState& state, const Event& event, uint32_t threadID)
+			{
+				ZoneStatistics& zone = state.Zones[event.Zone];
+				double milliseconds = (event.End - event.Start) / 1e6;
+				if (zone.Samples.size() < SampleWindow)
+					zone.Samples.push_back(milliseconds);
+				else
+					zone.Samples[zone.Count % SampleWindow] = milliseconds;
+				zone.Count++;
+				zone.Depth = event.Depth;
+				zone.GPU = threadID == GPUThreadID;
+
+				if (state.Capturing) {
+					if (state.Captured.size() < state.MaxCapturedEvents)
+						state.Captured.push_back({ event, threadID });
+					else
+						state.Dropped++;
+				}
+			}
+
+			static void WriteEscaped(std::ostream& out, const char* string)
+			{
+				for (; *string; string++)
+				{
+					if (*string == '"' || *string == '\\')
+						out << '\\';
+					out << *string;
+				}
+			}
+		}
+
+		ZoneID RegisterZone(const char* name)
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			auto it = state.ZoneIDs.find(name);
+			if (it != state.ZoneIDs.end())
+				return it->second;
+
+			ZoneID id = (ZoneID)state.Zones.size();
+			const std::string& copy = state.ZoneNames.emplace_back(name);
+			state.ZoneIDs.emplace(copy, id);
+			state.Zones.emplace_back().Name = copy.c_str();
+			return id;
+		}
+
+		uint64_t Now()
+		{
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		Scope::Scope(ZoneID zone)
+			: m_Zone(zone)
+		{
+			Utils::GetThreadBuffer().Depth++;
+			m_Start = Now();
+		}
+
+		Scope::~Scope()
+		{
+			uint64_t end = Now();
+			Utils::ThreadBuffer& buffer = Utils::GetThreadBuffer();
+			buffer.Depth--;
+
+			uint64_t head = buffer.Head.load(std::memory_order_relaxed);
+			if (head - buffer.Tail.load(std::memory_order_acquire) >= Utils::ThreadBuffer::Capacity) {
+				buffer.Dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			buffer.Events[head % Utils::ThreadBuffer::Capacity] = { m_Start, end, m_Zone, buffer.Depth };
+			buffer.Head.store(head + 1, std::memory_order_release);
+		}
+
+		void Collect()
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			for (auto& buffer : state.Threads)
+			{
+				uint64_t tail = buffer->Tail.load(std::memory_order_relaxed);
+				uint64_t head = buffer->Head.load(std::memory_order_acquire);
+				for (; tail < head; tail++)
+					Utils::AddEvent(state, buffer->Events[tail % Utils::ThreadBuffer::Capacity], buffer->ThreadID);
+				buffer->Tail.store(head, std::memory_order_release);
+				state.Dropped += buffer->Dropped.exchange(0, std::memory_order_relaxed);
+			}
+		}
+
+		void RecordGPUZone(ZoneID zone, uint64_t start, uint64_t end, uint16_t depth)
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			Utils::AddEvent(state, { start, end, zone, depth }, Utils::GPUThreadID);
+		}
+
+		void BeginCapture(size_t maxEvents)
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Capturing = true;
+			state.MaxCapturedEvents = maxEvents;
+			state.Captured.clear();
+		}
+
+		bool WriteTrace(const std::string& filepath)
+		{
+			Collect();
+
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			std::ofstream stream(filepath, std::ios::trunc);
+			if (!stream)
+				return false;
+
+			// complete ("X") events, timestamps in microseconds; the viewer nests them by time. The GPU
+			// zones are a process of their own so they don't interleave with the CPU threads
+			stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n"
+				<< "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n"
+				<< "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+			for (const Utils::CapturedEvent& captured : state.Captured)
+			{
+				bool gpu = captured.ThreadID == Utils::GPUThreadID;
+				stream << ",\n{\"name\":\"";
+				Utils::WriteEscaped(stream, state.Zones[captured.Zone.Zone].Name);
+				stream << "\",\"cat\":\"" << (gpu ? "gpu" : "cpu") << "\",\"ph\":\"X\",\"pid\":" << (gpu ? 1 : 0)
+					<< ",\"tid\":" << (gpu ? 0 : captured.ThreadID)
+					<< ",\"ts\":" << (int64_t)(captured.Zone.Start - state.Epoch) / 1e3
+					<< ",\"dur\":" << (captured.Zone.End - captured.Zone.Start) / 1e3 << "}";
+			}
+			stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+			state.Capturing = false;
+			state.Captured.clear();
+			state.Captured.shrink_to_fit();
+			return (bool)stream;
+		}
+
+		std::vector<ZoneSummary> GetSummary()
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			std::vector<ZoneSummary> summaries;
+			std::vector<double> samples;
+			for (const Utils::ZoneStatistics& zone : state.Zones)
+			{
+				ZoneSummary summary;
+				summary.Name = zone.Name;
+				summary.Count = zone.Count;
+				if (!zone.Samples.empty()) {
+					samples = zone.Samples;
+					size_t p99 = std::min(samples.size() - 1, (size_t)(samples.size() * 0.99));
+					std::nth_element(samples.begin(), samples.begin() + p99, samples.end());
+					summary.P99 = samples[p99];
+					summary.Min = *std::min_element(samples.begin(), samples.end());
+					double total = 0.0;
+					for (double sample : samples)
+						total += sample;
+					summary.Average = total / samples.size();
+				}
+				summaries.push_back(summary);
+			}
+			return summaries;
+		}
+
+		bool FindZone(const char* name, ZoneSummary& summary)
+		{
+			for (const ZoneSummary& zone : GetSummary())
+			{
+				if (strcmp(zone.Name, name) == 0) {
+					summary = zone;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void PrintSummary(std::ostream& out)
+		{
+			std::vector<ZoneSummary> summaries = GetSummary();
+			if (std::none_of(summaries.begin(), summaries.end(), [](const ZoneSummary& summary) { return summary.Count > 0; }))
+				return;
+
+			std::vector<uint16_t> depths;
+			std::vector<bool> gpu;
+			{
+				Utils::ProfilerState& state = Utils::GetState();
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				for (const Utils::ZoneStatistics& zone : state.Zones)
+				{
+					depths.push_back(zone.Depth);
+					gpu.push_back(zone.GPU);
+				}
+			}
+
+			// registration order is the order the zones were first entered, so children follow their parent
+			std::ios::fmtflags flags = out.flags();
+			std::streamsize precision = out.precision();
+			out << std::fixed << std::setprecision(3);
+			out << "Profiler, last " << SampleWindow << " calls per zone:" << std::endl;
+			out << "  zone                              calls     min ms     avg ms     p99 ms" << std::endl;
+			// the CPU zones, then the GPU ones
+			for (size_t n = 0; n < 2 * summaries.size(); n++)
+			{
+				size_t i = n % summaries.size();
+				const ZoneSummary& summary = summaries[i];
+				if (!summary.Count || gpu[i] != (n >= summaries.size()))
+					continue;
+				std::string name = std::string(2 + 2 * depths[i], ' ') + summary.Name;
+				out << std::left << std::setw(34) << name << std::right
+					<< std::setw(7) << summary.Count
+					<< std::setw(11) << summary.Min
+					<< std::setw(11) << summary.Average
+					<< std::setw(11) << summary.P99 << std::endl;
+			}
+			out.flags(flags);
+			out.precision(precision);
+		}
+
+		uint64_t GetDroppedEvents()
+		{
+			Utils::ProfilerState& state = Utils::GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Dropped;
+		}
+	}
+}
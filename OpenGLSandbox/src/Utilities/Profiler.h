@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+// Zones compile to nothing when this is 0
+#ifndef OGS_PROFILE
+	#define OGS_PROFILE 1
+#endif
+
+namespace OpenGLSandbox {
+
+	// Hierarchical CPU profiler. A zone is a scope: PROFILE_SCOPE("Name") records its start and end
+	// (nanoseconds) and its nesting depth into a ring buffer owned by the calling thread, without
+	// locks or allocations. Once a frame the main thread calls Collect, which drains every thread's
+	// ring into rolling per-zone statistics and, while capturing, into a Chrome trace
+	// (chrome://tracing, ui.perfetto.dev).
+	//
+	// Zone names are copied when a zone is first registered; PROFILE_SCOPE looks its zone up once
+	// per call site.
+	namespace Profiler {
+
+		using ZoneID = uint16_t;
+
+		struct ZoneSummary
+		{
+			const char* Name = nullptr;
+			uint64_t Count = 0;				// since startup
+			double Min = 0.0, Average = 0.0, P99 = 0.0;	// ms, over the last SampleWindow calls
+		};
+
+		// calls per zone the rolling statistics are computed over
+		static constexpr uint32_t SampleWindow = 256;
+
+		ZoneID RegisterZone(const char* name);
+		uint64_t Now();	// ns, steady clock
+
+		// Drains the thread rings; call from one thread only.
+		void Collect();
+
+		// A zone timed on the GPU (see GPUProfiler), start and end converted to the Now() clock. Shown
+		// in the summary like any other zone and on its own lane in the trace.
+		void RecordGPUZone(ZoneID zone, uint64_t start, uint64_t end, uint16_t depth);
+
+		// Keeps every zone recorded until WriteTrace, up to maxEvents.
+		void BeginCapture(size_t maxEvents = 1 << 20);
+		bool WriteTrace(const std::string& filepath);
+
+		std::vector<ZoneSummary> GetSummary();
+		bool FindZone(const char* name, ZoneSummary& summary);
+		// one line per zone, children indented under the zone they were first entered from
+		void PrintSummary(std::ostream& out);
+		// events lost to full rings or a full capture
+		uint64_t GetDroppedEvents();
+
+		class Scope
+		{
+		public:
+			Scope(ZoneID zone);
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			ZoneID m_Zone;
+			uint64_t m_Start;
+		};
+	}
+}
+
+#if OGS_PROFILE
+	#define OGS_PROFILE_CONCAT2(a, b) a##b
+	#define OGS_PROFILE_CONCAT(a, b) OGS_PROFILE_CONCAT2(a, b)
+	#define PROFILE_SCOPE(name) \
+		static const ::OpenGLSandbox::Profiler::ZoneID OGS_PROFILE_CONCAT(s_ProfileZone, __LINE__) = ::OpenGLSandbox::Profiler::RegisterZone(name); \
+		::OpenGLSandbox::Profiler::Scope OGS_PROFILE_CONCAT(profileScope, __LINE__)(OGS_PROFILE_CONCAT(s_ProfileZone, __LINE__))
+	#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,493 @@
+#include "RectPacker.h"
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <random>
+#include <climits>
+#include <cmath>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		inline bool ContainedIn(int ax, int ay, int aw, int ah, int bx, int by, int bw, int bh)
+		{
+			return ax >= bx && ay >= by && ax + aw <= bx + bw && ay + ah <= by + bh;
+		}
+
+		inline int NextPowerOfTwo(int value)
+		{
+			int result = 1;
+			while (result < value) result <<= 1;
+			return result;
+		}
+
+		inline int AlignUp(int value, int alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	RectPacker::RectPacker(int width, int height, const RectPackerSpecification& specification)
+		: m_Width(width), m_Height(height), m_Specification(specification)
+	{
+		Clear();
+	}
+
+	bool RectPacker::Insert(PackedRect& rect)
+	{
+		rect.Packed = false;
+		rect.Rotated = false;
+		if (rect.Width <= 0 || rect.Height <= 0) {
+			rect.X = rect.Y = 0;
+			rect.Packed = true;
+			return true;
+		}
+
+		int width = rect.Width + m_Specification.Padding;
+		int height = rect.Height + m_Specification.Padding;
+
+		if (m_Specification.Heuristic == PackingHeuristic::Skyline)
+			return InsertSkyline(width, height, rect);
+		return InsertMaxRects(width, height, rect);
+	}
+
+	bool RectPacker::Remove(const PackedRect& rect)
+	{
+		if (m_Specification.Heuristic != PackingHeuristic::MaxRects || !rect.Packed || rect.Width <= 0 || rect.Height <= 0)
+			return false;
+
+		int width = (rect.Rotated ? rect.Height : rect.Width) + m_Specification.Padding;
+		int height = (rect.Rotated ? rect.Width : rect.Height) + m_Specification.Padding;
+		Rect freed = { rect.X, rect.Y, width, height };
+
+		// free rects inside the freed area are redundant now; neighbours are not merged, so
+		// heavy churn fragments the bin until it is cleared
+		m_FreeRects.erase(std::remove_if(m_FreeRects.begin(), m_FreeRects.end(), [&](const Rect& free)
+		{
+			return Utils::ContainedIn(free.X, free.Y, free.Width, free.Height, freed.X, freed.Y, freed.Width, freed.Height);
+		}), m_FreeRects.end());
+		m_FreeRects.push_back(freed);
+		return true;
+	}
+
+	bool RectPacker::Occupy(const PackedRect& rect)
+	{
+		if (m_Specification.Heuristic != PackingHeuristic::MaxRects || rect.Width <= 0 || rect.Height <= 0)
+			return false;
+
+		int width = (rect.Rotated ? rect.Height : rect.Width) + m_Specification.Padding;
+		int height = (rect.Rotated ? rect.Width : rect.Height) + m_Specification.Padding;
+		PlaceMaxRects({ rect.X, rect.Y, width, height });
+		return true;
+	}
+
+	void RectPacker::Clear()
+	{
+		m_Skyline.clear();
+		m_FreeRects.clear();
+
+		// the bin grows by the padding so rects touching the right/bottom edge don't waste it
+		int binWidth = m_Width + m_Specification.Padding;
+		int binHeight = m_Height + m_Specification.Padding;
+		if (m_Specification.Heuristic == PackingHeuristic::Skyline)
+			m_Skyline.push_back({ 0, 0, binWidth });
+		else
+			m_FreeRects.push_back({ 0, 0, binWidth, binHeight });
+	}
+
+	//////////////////////////////////////////// Skyline ////////////////////////////////////////////
+
+	bool RectPacker::FitSkyline(size_t index, int width, int height, int& y) const
+	{
+		int x = m_Skyline[index].X;
+		if (x + width > m_Width + m_Specification.Padding)
+			return false;
+
+		int widthLeft = width;
+		y = m_Skyline[index].Y;
+		while (widthLeft > 0)
+		{
+			if (index >= m_Skyline.size())
+				return false;
+			y = std::max(y, m_Skyline[index].Y);
+			if (y + height > m_Height + m_Specification.Padding)
+				return false;
+			widthLeft -= m_Skyline[index].Width;
+			index++;
+		}
+		return true;
+	}
+
+	bool RectPacker::InsertSkyline(int width, int height, PackedRect& rect)
+	{
+		int bestBottom = INT_MAX, bestWidth = INT_MAX;
+		size_t bestIndex = SIZE_MAX;
+		int bestX = 0, bestY = 0;
+		bool bestRotated = false;
+
+		for (int rotated = 0; rotated < (m_Specification.AllowRotation ? 2 : 1); rotated++)
+		{
+			int w = rotated ? height : width;
+			int h = rotated ? width : height;
+			for (size_t i = 0; i < m_Skyline.size(); i++)
+			{
+				int y;
+				if (!FitSkyline(i, w, h, y))
+					continue;
+				// bottom-left: lowest resulting top edge, then the narrowest segment
+				if (y + h < bestBottom || (y + h == bestBottom && m_Skyline[i].Width < bestWidth)) {
+					bestBottom = y + h;
+					bestWidth = m_Skyline[i].Width;
+					bestIndex = i;
+					bestX = m_Skyline[i].X;
+					bestY = y;
+					bestRotated = rotated;
+				}
+			}
+		}
+
+		if (bestIndex == SIZE_MAX)
+			return false;
+
+		int w = bestRotated ? height : width;
+		int h = bestRotated ? width : height;
+		AddSkylineLevel(bestIndex, bestX, bestY, w, h);
+
+		rect.X = bestX;
+		rect.Y = bestY;
+		rect.Rotated = bestRotated;
+		rect.Packed = true;
+		return true;
+	}
+
+	void RectPacker::AddSkylineLevel(size_t index, int x, int y, int width, int height)
+	{
+		m_Skyline.insert(m_Skyline.begin() + index, { x, y + height, width });
+
+		// shrink or drop the segments now covered by the new one
+		for (size_t i = index + 1; i < m_Skyline.size(); )
+		{
+			SkylineSegment& previous = m_Skyline[i - 1];
+			SkylineSegment& current = m_Skyline[i];
+			if (current.X >= previous.X + previous.Width)
+				break;
+
+			int shrink = previous.X + previous.Width - current.X;
+			current.X += shrink;
+			current.Width -= shrink;
+			if (current.Width > 0)
+				break;
+			m_Skyline.erase(m_Skyline.begin() + i);
+		}
+
+		// merge neighbours of equal height
+		for (size_t i = 0; i + 1 < m_Skyline.size(); )
+		{
+			if (m_Skyline[i].Y == m_Skyline[i + 1].Y) {
+				m_Skyline[i].Width += m_Skyline[i + 1].Width;
+				m_Skyline.erase(m_Skyline.begin() + i + 1);
+			}
+			else
+				i++;
+		}
+	}
+
+	/////////////////////////////////////////// MaxRects ////////////////////////////////////////////
+
+	bool RectPacker::InsertMaxRects(int width, int height, PackedRect& rect)
+	{
+		int bestShortSide = INT_MAX, bestLongSide = INT_MAX;
+		Rect best = { 0, 0, 0, 0 };
+		bool bestRotated = false;
+
+		for (const Rect& free : m_FreeRects)
+		{
+			for (int rotated = 0; rotated < (m_Specification.AllowRotation ? 2 : 1); rotated++)
+			{
+				int w = rotated ? height : width;
+				int h = rotated ? width : height;
+				if (free.Width < w || free.Height < h)
+					continue;
+
+				// best short side fit: keep the smallest leftover strip
+				int leftoverX = free.Width - w;
+				int leftoverY = free.Height - h;
+				int shortSide = std::min(leftoverX, leftoverY);
+				int longSide = std::max(leftoverX, leftoverY);
+				if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide)) {
+					bestShortSide = shortSide;
+					bestLongSide = longSide;
+					best = { free.X, free.Y, w, h };
+					bestRotated = rotated;
+				}
+			}
+		}
+
+		if (best.Width == 0)
+			return false;
+
+		PlaceMaxRects(best);
+
+		rect.X = best.X;
+		rect.Y = best.Y;
+		rect.Rotated = bestRotated;
+		rect.Packed = true;
+		return true;
+	}
+
+	void RectPacker::PlaceMaxRects(const Rect& node)
+	{
+		m_NewFreeRects.clear();
+		for (size_t i = 0; i < m_FreeRects.size(); )
+		{
+			if (SplitFreeRect(m_FreeRects[i], node)) {
+				m_FreeRects[i] = m_FreeRects.back();
+				m_FreeRects.pop_back();
+			}
+			else
+				i++;
+		}
+		PruneFreeRects();
+	}
+
+	bool RectPacker::SplitFreeRect(const Rect& free, const Rect& used)
+	{
+		if (used.X >= free.X + free.Width || used.X + used.Width <= free.X ||
+			used.Y >= free.Y + free.Height || used.Y + used.Height <= free.Y)
+			return false;
+
+		// up to four maximal rects remain around the used area
+		if (used.X > free.X)
+			m_NewFreeRects.push_back({ free.X, free.Y, used.X - free.X, free.Height });
+		if (used.X + used.Width < free.X + free.Width)
+			m_NewFreeRects.push_back({ used.X + used.Width, free.Y, free.X + free.Width - (used.X + used.Width), free.Height });
+		if (used.Y > free.Y)
+			m_NewFreeRects.push_back({ free.X, free.Y, free.Width, used.Y - free.Y });
+		if (used.Y + used.Height < free.Y + free.Height)
+			m_NewFreeRects.push_back({ free.X, used.Y + used.Height, free.Width, free.Y + free.Height - (used.Y + used.Height) });
+		return true;
+	}
+
+	void RectPacker::PruneFreeRects()
+	{
+		// new rects only need testing against each other and the survivors of the split
+		for (size_t i = 0; i < m_NewFreeRects.size(); )
+		{
+			const Rect& a = m_NewFreeRects[i];
+			bool contained = false;
+			for (size_t j = 0; j < m_NewFreeRects.size() && !contained; j++)
+			{
+				const Rect& b = m_NewFreeRects[j];
+				if (i != j && Utils::ContainedIn(a.X, a.Y, a.Width, a.Height, b.X, b.Y, b.Width, b.Height)
+					&& (a.Width != b.Width || a.Height != b.Height || a.X != b.X || a.Y != b.Y || i > j))
+					contained = true;
+			}
+			for (size_t j = 0; j < m_FreeRects.size() && !contained; j++)
+			{
+				const Rect& b = m_FreeRects[j];
+				contained = Utils::ContainedIn(a.X, a.Y, a.Width, a.Height, b.X, b.Y, b.Width, b.Height);
+			}
+
+			if (contained) {
+				m_NewFreeRects[i] = m_NewFreeRects.back();
+				m_NewFreeRects.pop_back();
+			}
+			else
+				i++;
+		}
+
+		m_FreeRects.insert(m_FreeRects.end(), m_NewFreeRects.begin(), m_NewFreeRects.end());
+	}
+
+	//////////////////////////////////////////// Offline ////////////////////////////////////////////
+
+	bool RectPacker::PackInto(int width, int height, std::vector<PackedRect>& rects, const RectPackerSpecification& specification)
+	{
+		// largest first; the stable sort keeps the result independent of the standard library
+		std::vector<size_t> order(rects.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+		{
+			int maxA = std::max(rects[a].Width, rects[a].Height), maxB = std::max(rects[b].Width, rects[b].Height);
+			if (maxA != maxB)
+				return maxA > maxB;
+			return std::min(rects[a].Width, rects[a].Height) > std::min(rects[b].Width, rects[b].Height);
+		});
+
+		RectPacker packer(width, height, specification);
+		for (size_t index : order)
+			if (!packer.Insert(rects[index]))
+				return false;
+		return true;
+	}
+
+	bool RectPacker::Pack(std::vector<PackedRect>& rects, const RectPackerSpecification& specification, PackingReport& report)
+	{
+		report = PackingReport();
+
+		uint64_t paddedArea = 0;
+		int minWidth = 1, minHeight = 1;
+		for (const PackedRect& rect : rects)
+		{
+			paddedArea += (uint64_t)(rect.Width + specification.Padding) * (rect.Height + specification.Padding);
+			report.UsedArea += (uint64_t)rect.Width * rect.Height;
+			int w = specification.AllowRotation ? std::min(rect.Width, rect.Height) : rect.Width;
+			int h = specification.AllowRotation ? std::min(rect.Width, rect.Height) : rect.Height;
+			minWidth = std::max(minWidth, w);
+			minHeight = std::max(minHeight, h);
+		}
+
+		// candidate sizes, smallest area first and squarer atlases preferred on ties
+		struct Candidate { int Width, Height; };
+		std::vector<Candidate> candidates;
+		if (specification.PowerOfTwo) {
+			for (int w = Utils::NextPowerOfTwo(minWidth); w <= specification.MaxSize; w <<= 1)
+				for (int h = Utils::NextPowerOfTwo(minHeight); h <= specification.MaxSize; h <<= 1)
+					if ((uint64_t)w * h >= report.UsedArea)
+						candidates.push_back({ w, h });
+		}
+		else {
+			// arbitrary sizes: for every width, binary search the smallest height that fits
+			int alignment = std::max(1, specification.SizeAlignment);
+			int side = (int)std::ceil(std::sqrt((double)paddedArea));
+			int firstWidth = Utils::AlignUp(std::max(minWidth, side / 2), alignment);
+			int lastWidth = std::min(specification.MaxSize, Utils::AlignUp(side * 2 + minWidth, alignment));
+			// sample at most ~16 widths, each one costs a binary search of full packs
+			int step = std::max(alignment, Utils::AlignUp((lastWidth - firstWidth) / 16, alignment));
+			std::vector<PackedRect> scratch;
+			for (int w = firstWidth; w <= lastWidth; w += step)
+			{
+				// a packer that can't reach 50% occupancy at this width is not worth searching
+				int low = Utils::AlignUp(std::max(minHeight, (int)(report.UsedArea / w)), alignment);
+				int high = std::min(Utils::AlignUp((int)(2 * paddedArea / w) + minHeight, alignment), specification.MaxSize);
+				if (low > high)
+					continue;
+
+				scratch = rects;
+				report.Attempts++;
+				if (!PackInto(w, high, scratch, specification))
+					continue;
+				while (low < high)
+				{
+					int middle = Utils::AlignUp(low + (high - low) / 2, alignment);
+					if (middle >= high)
+						middle = high - alignment;
+					if (middle < low)
+						break;
+					scratch = rects;
+					report.Attempts++;
+					if (PackInto(w, middle, scratch, specification))
+						high = middle;
+					else
+						low = middle + alignment;
+				}
+				candidates.push_back({ w, high });
+			}
+		}
+
+		std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+		{
+			uint64_t areaA = (uint64_t)a.Width * a.Height, areaB = (uint64_t)b.Width * b.Height;
+			if (areaA != areaB)
+				return areaA < areaB;
+			return std::abs(a.Width - a.Height) < std::abs(b.Width - b.Height);
+		});
+
+		for (const Candidate& candidate : candidates)
+		{
+			report.Attempts++;
+			if (!PackInto(candidate.Width, candidate.Height, rects, specification))
+				continue;
+
+			report.AtlasWidth = candidate.Width;
+			report.AtlasHeight = candidate.Height;
+			report.PackedCount = (int)rects.size();
+			report.Occupancy = (double)report.UsedArea / ((double)candidate.Width * candidate.Height);
+			return true;
+		}
+		return false;
+	}
+
+	void RectPacker::PrintReport(std::ostream& out, const PackingReport& report)
+	{
+		out << report.AtlasWidth << "x" << report.AtlasHeight
+			<< ", " << report.PackedCount << " rects"
+			<< ", occupancy " << report.Occupancy * 100.0 << "%"
+			<< ", " << report.Attempts << " attempts";
+	}
+
+	void RectPacker::RunBenchmark(std::ostream& out)
+	{
+		struct RectSet
+		{
+			const char* Name;
+			std::vector<PackedRect> Rects;
+		};
+
+		std::mt19937 random(1337);
+		auto makeSet = [&](const char* name, int count, int minSide, int maxSide)
+		{
+			RectSet set = { name, {} };
+			std::uniform_int_distribution<int> side(minSide, maxSide);
+			for (int i = 0; i < count; i++)
+			{
+				PackedRect rect;
+				rect.Width = side(random);
+				rect.Height = side(random);
+				set.Rects.push_back(rect);
+			}
+			return set;
+		};
+
+		std::vector<RectSet> sets;
+		sets.push_back({ "msdf glyphs 93 x 68x68", std::vector<PackedRect>(93, PackedRect{ 68, 68 }) });
+		sets.push_back(makeSet("bitmap glyphs 512 x 8..48", 512, 8, 48));
+		sets.push_back(makeSet("sprites 1000 x 16..96", 1000, 16, 96));
+		sets.push_back(makeSet("mixed 2000 x 4..128", 2000, 4, 128));
+
+		for (const RectSet& set : sets)
+		{
+			out << set.Name << std::endl;
+
+			// the old fixed 2048x2048 shelf for comparison
+			uint64_t usedArea = 0;
+			for (const PackedRect& rect : set.Rects)
+				usedArea += (uint64_t)rect.Width * rect.Height;
+			out << "  shelf 2048x2048 (previous)     ";
+			if (usedArea <= 2048ull * 2048ull)
+				out << "occupancy " << usedArea * 100.0 / (2048.0 * 2048.0) << "%" << std::endl;
+			else
+				out << "does not fit" << std::endl;
+
+			for (PackingHeuristic heuristic : { PackingHeuristic::Skyline, PackingHeuristic::MaxRects })
+			{
+				for (int powerOfTwo = 1; powerOfTwo >= 0; powerOfTwo--)
+				{
+					for (int rotation = 0; rotation < 2; rotation++)
+					{
+						RectPackerSpecification specification;
+						specification.Heuristic = heuristic;
+						specification.PowerOfTwo = powerOfTwo;
+						specification.AllowRotation = rotation;
+
+						std::vector<PackedRect> rects = set.Rects;
+						PackingReport report;
+						auto start = std::chrono::steady_clock::now();
+						bool packed = Pack(rects, specification, report);
+						std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+						out << "  " << (heuristic == PackingHeuristic::Skyline ? "skyline " : "maxrects")
+							<< (powerOfTwo ? " pow2     " : " arbitrary")
+							<< (rotation ? " rotate " : " upright") << "  ";
+						if (packed)
+							PrintReport(out, report);
+						else
+							out << "does not fit";
+						out << ", " << elapsed.count() << " ms" << std::endl;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <ostream>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	enum class PackingHeuristic
+	{
+		Skyline,	// bottom-left skyline, fast and good for similarly sized rects
+		MaxRects	// maximal rectangles with best short side fit, tighter but slower
+	};
+
+	struct RectPackerSpecification
+	{
+		PackingHeuristic Heuristic = PackingHeuristic::MaxRects;
+		int Padding = 1;				// empty pixels kept right of and below every rect
+		bool AllowRotation = false;		// rects may be placed rotated by 90 degrees
+		bool PowerOfTwo = true;			// otherwise atlas sides are multiples of SizeAlignment
+		int SizeAlignment = 4;
+		int MaxSize = 8192;
+	};
+
+	struct PackedRect
+	{
+		int Width = 0, Height = 0;	// requested size
+		int X = 0, Y = 0;			// top-left placement, valid when Packed is set
+		bool Rotated = false;		// placed as Height x Width
+		bool Packed = false;
+	};
+
+	struct PackingReport
+	{
+		int AtlasWidth = 0;
+		int AtlasHeight = 0;
+		int PackedCount = 0;
+		uint64_t UsedArea = 0;		// area of the packed rects without padding
+		double Occupancy = 0.0;		// UsedArea / atlas area
+		int Attempts = 0;			// atlas sizes tried before one fit
+	};
+
+	class RectPacker
+	{
+	public:
+		RectPacker(int width, int height, const RectPackerSpecification& specification);
+
+		// Places a single rect, online. Returns false when it does not fit anymore.
+		bool Insert(PackedRect& rect);
+		// Gives a packed rect's area back. MaxRects only, the skyline can't reclaim space.
+		bool Remove(const PackedRect& rect);
+		// Marks a rect as used at its current position. MaxRects only; together with Clear() this
+		// rebuilds unfragmented free space around the rects that are still alive.
+		bool Occupy(const PackedRect& rect);
+		void Clear();
+
+		inline int GetWidth() const { return m_Width; }
+		inline int GetHeight() const { return m_Height; }
+
+		// Packs all rects, largest first, into a fixed size atlas.
+		static bool PackInto(int width, int height, std::vector<PackedRect>& rects, const RectPackerSpecification& specification);
+		// Finds the smallest atlas (by area) that fits every rect and packs into it.
+		static bool Pack(std::vector<PackedRect>& rects, const RectPackerSpecification& specification, PackingReport& report);
+
+		static void PrintReport(std::ostream& out, const PackingReport& report);
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		struct Rect
+		{
+			int X, Y, Width, Height;
+		};
+
+		struct SkylineSegment
+		{
+			int X, Y, Width;
+		};
+
+		bool InsertSkyline(int width, int height, PackedRect& rect);
+		bool FitSkyline(size_t index, int width, int height, int& y) const;
+		void AddSkylineLevel(size_t index, int x, int y, int width, int height);
+
+		bool InsertMaxRects(int width, int height, PackedRect& rect);
+		void PlaceMaxRects(const Rect& node);
+		bool SplitFreeRect(const Rect& freeRect, const Rect& usedRect);
+		void PruneFreeRects();
+
+	private:
+		int m_Width, m_Height;
+		RectPackerSpecification m_Specification;
+
+		std::vector<SkylineSegment> m_Skyline;
+		std::vector<Rect> m_FreeRects;
+		std::vector<Rect> m_NewFreeRects;
+	};
+}
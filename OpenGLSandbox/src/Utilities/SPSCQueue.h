@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// Bounded lock-free queue for exactly one producer thread and one consumer thread. Capacity must be
+	// a power of two. The producer only writes m_Tail and the consumer only m_Head, each on its own
+	// cache line, so the two threads never contend for a line they both write.
+	template<typename T, uint32_t Capacity>
+	class SPSCQueue
+	{
+		static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		// producer only; false when full
+		bool TryPush(const T& value)
+		{
+			uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+			if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+				return false;
+			m_Items[tail & (Capacity - 1)] = value;
+			m_Tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer only; false when empty
+		bool TryPop(T& value)
+		{
+			uint32_t head = m_Head.load(std::memory_order_relaxed);
+			if (head == m_Tail.load(std::memory_order_acquire))
+				return false;
+			value = m_Items[head & (Capacity - 1)];
+			m_Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		alignas(64) std::atomic<uint32_t> m_Head{ 0 };
+		alignas(64) std::atomic<uint32_t> m_Tail{ 0 };
+		T m_Items[Capacity];
+	};
+}
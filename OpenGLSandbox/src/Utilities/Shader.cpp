@@ -1,105 +1,431 @@
 #include "Shader.h"
-#include <fstream>
 #include <iostream>
 #include <glad/glad.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <regex>
+#include "ShaderCompiler.h"
+#include "FileSystem.h"
+#include "Renderer/RenderState.h"
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile, not in the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace OpenGLSandbox {
-	Shader::Shader(const std::string& vertexSrcFilepath, const std::string& fragmentSrcFilepath)
+
+	namespace Utils {
+
+		static uint32_t UniformTypeSize(GLenum type)
+		{
+			switch (type)
+			{
+				case GL_FLOAT_VEC2:	return 2 * sizeof(float);
+				case GL_FLOAT_VEC3:	return 3 * sizeof(float);
+				case GL_FLOAT_VEC4:	return 4 * sizeof(float);
+				case GL_FLOAT_MAT3:	return 9 * sizeof(float);
+				case GL_FLOAT_MAT4:	return 16 * sizeof(float);
+				case GL_INT_VEC2:	return 2 * sizeof(int);
+				case GL_INT_VEC3:	return 3 * sizeof(int);
+				case GL_INT_VEC4:	return 4 * sizeof(int);
+				// float, int, bool and every sampler type
+				default:			return 4;
+			}
+		}
+
+		static std::string TrimArraySuffix(const char* name)
+		{
+			std::string trimmed = name;
+			size_t bracket = trimmed.find('[');
+			if (bracket != std::string::npos)
+				trimmed.resize(bracket);
+			return trimmed;
+		}
+
+		// items are sorted by NameHash
+		template<typename Vector>
+		static auto FindByHash(Vector& items, uint64_t nameHash) -> decltype(items.data())
+		{
+			auto it = std::lower_bound(items.begin(), items.end(), nameHash, [](const auto& item, uint64_t hash) { return item.NameHash < hash; });
+			return it != items.end() && it->NameHash == nameHash ? &*it : nullptr;
+		}
+
+		static std::string GetInfoLog(unsigned int id, bool program)
+		{
+			GLint length = 0;
+			if (program)
+				glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+			else
+				glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+			if (length <= 0)
+				return std::string();
+
+			std::string log(length, '\0');
+			if (program)
+				glGetProgramInfoLog(id, length, nullptr, log.data());
+			else
+				glGetShaderInfoLog(id, length, nullptr, log.data());
+			log.resize(strlen(log.c_str()));
+			return log;
+		}
+
+		// Prints every log line as "file:line: message" followed by the offending source line. Drivers
+		// differ in how they place the line number: "0:12(5): error" (Mesa), "0(12) : error" (NVIDIA),
+		// "ERROR: 0:12: ..." (AMD, Intel); the number after the source string index is the line.
+		static void PrintInfoLog(const std::string& log, const std::string& filepath, std::string_view source)
+		{
+			static const std::regex location(R"((?:^|\D)\d+[:(](\d+)[):(])");
+
+			std::istringstream lines(log);
+			std::string message;
+			while (std::getline(lines, message))
+			{
+				if (message.empty())
+					continue;
+
+				std::smatch match;
+				if (source.empty() || !std::regex_search(message, match, location)) {
+					std::cout << filepath << ": " << message << std::endl;
+					continue;
+				}
+
+				int line = std::stoi(match[1].str());
+				std::cout << filepath << ":" << line << ": " << message << std::endl;
+
+				std::istringstream sourceLines{ std::string(source) };
+				std::string sourceLine;
+				for (int i = 0; i < line && std::getline(sourceLines, sourceLine); i++)
+					;
+				if (line > 0 && sourceLines)
+					std::cout << "    " << sourceLine << std::endl;
+			}
+		}
+
+		static bool CheckCompileStatus(unsigned int shader, const std::string& filepath, std::string_view source)
+		{
+			GLint compiled = GL_FALSE;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if (!compiled) {
+				std::cout << "ERROR: compiling " << filepath << " failed" << std::endl;
+				PrintInfoLog(GetInfoLog(shader, false), filepath, source);
+			}
+			return compiled == GL_TRUE;
+		}
+	}
+
+	static Shader::Statistics s_Statistics;
+
+	Shader::Shader(const std::string& vertexSrcFilepath, const std::string& fragmentSrcFilepath, ShaderCache* cache)
+		: m_VertexFilepath(vertexSrcFilepath), m_FragmentFilepath(fragmentSrcFilepath)
 	{
-		std::string vertexSource = ReadFromFile(vertexSrcFilepath.c_str());
-		std::string fragmentSource = ReadFromFile(fragmentSrcFilepath.c_str());
+		StartBuild(cache);
+		PollBuild(true, false);
+	}
 
-		m_RendererID = Compile(vertexSource, fragmentSource);
+	Shader::Shader(const std::string& vertexSrcFilepath, const std::string& fragmentSrcFilepath, ShaderCompiler& compiler)
+		: m_VertexFilepath(vertexSrcFilepath), m_FragmentFilepath(fragmentSrcFilepath)
+	{
+		StartBuild(compiler.GetCache());
+		if (m_Status == ShaderStatus::Compiling) {
+			m_Compiler = &compiler;
+			compiler.Add(this);
+		}
 	}
 
 	Shader::~Shader()
 	{
+		if (m_Compiler)
+			m_Compiler->Remove(this);
+		glDeleteShader(m_VertexShaderID);
+		glDeleteShader(m_FragmentShaderID);
 		glDeleteProgram(m_RendererID);
 	}
 
 	void Shader::Bind()
 	{
-		glUseProgram(m_RendererID);
+		if (m_Status == ShaderStatus::Ready)
+			RenderState::UseProgram(m_RendererID);
+		else if (m_Compiler)
+			m_Compiler->GetFallback().Bind();
+		else
+			RenderState::UseProgram(0);
 	}
 
 	void Shader::Unbind()
 	{
-		glUseProgram(0);
+		RenderState::UseProgram(0);
+	}
+
+	void Shader::StartBuild(ShaderCache* cache)
+	{
+		FileView vertexFile = FileSystem::Read(m_VertexFilepath);
+		FileView fragmentFile = FileSystem::Read(m_FragmentFilepath);
+		if (!vertexFile)
+			std::cout << "ERROR: could not read " << m_VertexFilepath << std::endl;
+		if (!fragmentFile)
+			std::cout << "ERROR: could not read " << m_FragmentFilepath << std::endl;
+		m_VertexSource = vertexFile.AsString();
+		m_FragmentSource = fragmentFile.AsString();
+
+		m_Cache = cache;
+		if (m_Cache) {
+			m_SourceKey = ShaderCache::ComputeSourceKey(m_VertexSource, m_FragmentSource);
+			m_RendererID = m_Cache->Load(m_VertexFilepath + "|" + m_FragmentFilepath, m_SourceKey);
+			if (m_RendererID) {
+				m_Status = ShaderStatus::Ready;
+				m_VertexSource = m_FragmentSource = std::string_view();
+				Reflect();
+				return;
+			}
+		}
+
+		// only issue the work here, any status query would make the driver finish it on the spot
+		// the mapped sources aren't null terminated, their length is passed along
+		m_VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+		const char* vertexSource = m_VertexSource.data();
+		GLint vertexLength = (GLint)m_VertexSource.size();
+		glShaderSource(m_VertexShaderID, 1, &vertexSource, &vertexLength);
+		glCompileShader(m_VertexShaderID);
+
+		m_FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+		const char* fragmentSource = m_FragmentSource.data();
+		GLint fragmentLength = (GLint)m_FragmentSource.size();
+		glShaderSource(m_FragmentShaderID, 1, &fragmentSource, &fragmentLength);
+		glCompileShader(m_FragmentShaderID);
+
+		m_RendererID = glCreateProgram();
+		glAttachShader(m_RendererID, m_VertexShaderID);
+		glAttachShader(m_RendererID, m_FragmentShaderID);
+		if (m_Cache && m_Cache->IsSupported())
+			glProgramParameteri(m_RendererID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(m_RendererID);
+		m_Status = ShaderStatus::Compiling;
+	}
+
+	bool Shader::PollBuild(bool wait, bool parallel)
+	{
+		if (m_Status != ShaderStatus::Compiling)
+			return true;
+
+		if (!wait && parallel) {
+			GLint completed = GL_FALSE;
+			glGetProgramiv(m_RendererID, GL_COMPLETION_STATUS_KHR, &completed);
+			if (!completed)
+				return false;
+		}
+		FinishBuild();
+		return true;
+	}
+
+	void Shader::FinishBuild()
+	{
+		bool compiled = Utils::CheckCompileStatus(m_VertexShaderID, m_VertexFilepath, m_VertexSource);
+		compiled &= Utils::CheckCompileStatus(m_FragmentShaderID, m_FragmentFilepath, m_FragmentSource);
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(m_RendererID, GL_LINK_STATUS, &linked);
+		// a failed compile always fails the link as well, its log adds nothing
+		if (compiled && !linked) {
+			std::cout << "ERROR: linking " << m_VertexFilepath << " with " << m_FragmentFilepath << " failed" << std::endl;
+			Utils::PrintInfoLog(Utils::GetInfoLog(m_RendererID, true), m_VertexFilepath + "|" + m_FragmentFilepath, "");
+		}
+
+		glDetachShader(m_RendererID, m_VertexShaderID);
+		glDetachShader(m_RendererID, m_FragmentShaderID);
+		glDeleteShader(m_VertexShaderID);
+		glDeleteShader(m_FragmentShaderID);
+		m_VertexShaderID = m_FragmentShaderID = 0;
+		m_VertexSource = m_FragmentSource = std::string_view();
+
+		if (!linked) {
+			glDeleteProgram(m_RendererID);
+			m_RendererID = 0;
+			m_Status = ShaderStatus::Failed;
+			return;
+		}
+
+		if (m_Cache)
+			m_Cache->Store(m_VertexFilepath + "|" + m_FragmentFilepath, m_SourceKey, m_RendererID);
+		m_Status = ShaderStatus::Ready;
+		Reflect();
 	}
 
-	std::string Shader::ReadFromFile(const char* filepath)
+	void Shader::Reflect()
 	{
-		std::string content;
-		std::ifstream fileStream(filepath, std::ios::in);
-		std::string line = "";
+		m_Uniforms.clear();
+		m_Attributes.clear();
+		m_UniformBlocks.clear();
+		m_UniformCache.clear();
+
+		char name[256];
+		int count = 0;
+		glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORMS, &count);
+		for (int i = 0; i < count; i++)
+		{
+			GLint size;
+			GLenum type;
+			glGetActiveUniform(m_RendererID, (GLuint)i, sizeof(name), nullptr, &size, &type, name);
+
+			// members of uniform blocks have no location, they are set through the block's buffer
+			GLint blockIndex;
+			GLuint index = (GLuint)i;
+			glGetActiveUniformsiv(m_RendererID, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+			if (blockIndex != -1)
+				continue;
+
+			ShaderUniform uniform;
+			uniform.Name = Utils::TrimArraySuffix(name);
+			uniform.NameHash = Hash::FNV1a(uniform.Name);
+			uniform.Location = glGetUniformLocation(m_RendererID, name);
+			uniform.Type = type;
+			uniform.Count = size;
+			uniform.CacheOffset = (uint32_t)m_UniformCache.size();
+			uniform.CacheSize = Utils::UniformTypeSize(type);
+			m_UniformCache.resize(m_UniformCache.size() + uniform.CacheSize);
+			m_Uniforms.push_back(uniform);
+		}
 
-		while (!fileStream.eof())
+		glGetProgramiv(m_RendererID, GL_ACTIVE_ATTRIBUTES, &count);
+		for (int i = 0; i < count; i++)
 		{
-			std::getline(fileStream, line);
-			content.append(line + "\n");
+			GLint size;
+			GLenum type;
+			glGetActiveAttrib(m_RendererID, (GLuint)i, sizeof(name), nullptr, &size, &type, name);
+			// built-ins such as gl_VertexID are listed by some drivers
+			if (strncmp(name, "gl_", 3) == 0)
+				continue;
+
+			ShaderAttribute attribute;
+			attribute.Name = Utils::TrimArraySuffix(name);
+			attribute.NameHash = Hash::FNV1a(attribute.Name);
+			attribute.Location = glGetAttribLocation(m_RendererID, name);
+			attribute.Type = type;
+			attribute.Count = size;
+			m_Attributes.push_back(attribute);
+		}
+
+		glGetProgramiv(m_RendererID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		for (int i = 0; i < count; i++)
+		{
+			glGetActiveUniformBlockName(m_RendererID, (GLuint)i, sizeof(name), nullptr, name);
+
+			ShaderUniformBlock block;
+			block.Name = name;
+			block.NameHash = Hash::FNV1a(block.Name);
+			block.Index = (unsigned int)i;
+			glGetActiveUniformBlockiv(m_RendererID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.DataSize);
+			m_UniformBlocks.push_back(block);
+		}
+
+		auto byHash = [](const auto& a, const auto& b) { return a.NameHash < b.NameHash; };
+		std::sort(m_Uniforms.begin(), m_Uniforms.end(), byHash);
+		std::sort(m_Attributes.begin(), m_Attributes.end(), byHash);
+		std::sort(m_UniformBlocks.begin(), m_UniformBlocks.end(), byHash);
+
+		// bindings requested while the program was still compiling
+		for (const auto& [blockHash, binding] : m_BlockBindings)
+			if (const ShaderUniformBlock* block = Utils::FindByHash(m_UniformBlocks, blockHash))
+				glUniformBlockBinding(m_RendererID, block->Index, binding);
+	}
+
+	const ShaderUniform* Shader::FindUniform(uint64_t nameHash) const
+	{
+		return Utils::FindByHash(m_Uniforms, nameHash);
+	}
+
+	const ShaderAttribute* Shader::FindAttribute(uint64_t nameHash) const
+	{
+		return Utils::FindByHash(m_Attributes, nameHash);
+	}
+
+	bool Shader::BindUniformBlock(std::string_view blockName, unsigned int binding)
+	{
+		uint64_t blockHash = Hash::FNV1a(blockName);
+		if (m_Status == ShaderStatus::Compiling) {
+			m_BlockBindings.emplace_back(blockHash, binding);
+			return true;
 		}
-		fileStream.close();
-		return content;
+
+		const ShaderUniformBlock* block = Utils::FindByHash(m_UniformBlocks, blockHash);
+		if (!block)
+			return false;
+
+		glUniformBlockBinding(m_RendererID, block->Index, binding);
+		return true;
 	}
 
-	unsigned int Shader::Compile(const std::string& vertexSrc, const std::string& fragmentSrc)
+	ShaderUniform* Shader::PrepareSet(uint64_t nameHash, const void* value, uint32_t size)
 	{
-		// create shader objects (vertex and fragment)
-		unsigned int vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-		unsigned int fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-	
-		// vertex shader setup and error handling
-		const char* vertexStringPrt = vertexSrc.c_str();
-		glShaderSource(vertexShaderID, 1, &vertexStringPrt, 0); // 0 = NULL
-		glCompileShader(vertexShaderID);
-		//TODO: Error Handling
-		int result;
-		char msg[512];
-		glGetProgramiv(fragmentShaderID, GL_LINK_STATUS, &result);
-		if (!result) {
-			glGetProgramInfoLog(fragmentShaderID, 512, NULL, msg);
-			std::cout << "ERROR::FRAGMENT_SHADER::PROGRAM::LINKING_FAILED\n" << msg << std::endl;
+		if (m_Status != ShaderStatus::Ready)
+			return nullptr;
+
+		ShaderUniform* uniform = Utils::FindByHash(m_Uniforms, nameHash);
+		if (!uniform) {
+			s_Statistics.UnknownUniforms++;
+			return nullptr;
 		}
-		// fragment shader setup and error handling
-		const char* fragmentStringPrt = fragmentSrc.c_str();
-		glShaderSource(fragmentShaderID, 1, &fragmentStringPrt, NULL);
-		glCompileShader(fragmentShaderID);
-		glGetProgramiv(fragmentShaderID, GL_LINK_STATUS, &result);
-		if (!result) {
-			glGetProgramInfoLog(fragmentShaderID, 512, NULL, msg);
-			std::cout << "ERROR::FRAGMENT_SHADER::PROGRAM::LINKING_FAILED\n" << msg << std::endl;
+
+		size = std::min(size, uniform->CacheSize);
+		uint8_t* cached = &m_UniformCache[uniform->CacheOffset];
+		if (uniform->Cached && memcmp(cached, value, size) == 0) {
+			s_Statistics.SkippedUniformCalls++;
+			return nullptr;
 		}
 
-		// create, attach, and setup shader program
-		unsigned int shaderProgram = glCreateProgram();
-		glAttachShader(shaderProgram, vertexShaderID);
-		glAttachShader(shaderProgram, fragmentShaderID);
-		glLinkProgram(shaderProgram);
+		memcpy(cached, value, size);
+		uniform->Cached = true;
+		s_Statistics.UniformCalls++;
+		// glUniform* sets the current program's uniforms
+		RenderState::UseProgram(m_RendererID);
+		return uniform;
+	}
 
-		//Clean up Shaders
-		glDeleteShader(vertexShaderID);
-		glDeleteShader(fragmentShaderID);
+	void Shader::SetUniform1i(uint64_t nameHash, int value)
+	{
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &value, sizeof(value)))
+			glUniform1i(uniform->Location, value);
+	}
 
-		return shaderProgram;
+	void Shader::SetUniform1f(uint64_t nameHash, float value)
+	{
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &value, sizeof(value)))
+			glUniform1f(uniform->Location, value);
 	}
 
-	void Shader::SetUniform4f(const std::string& uniformName, float x, float y, float z, float w)
+	void Shader::SetUniform2f(uint64_t nameHash, const glm::vec2& value)
 	{
-		int vertexColorLocation = glGetUniformLocation(m_RendererID, uniformName.c_str());
-		glUniform4f(vertexColorLocation, x, y, x, w);
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &value, sizeof(value)))
+			glUniform2f(uniform->Location, value.x, value.y);
 	}
 
-	void Shader::SetUniform1i(const std::string& uniformName, int data)
+	void Shader::SetUniform3f(uint64_t nameHash, const glm::vec3& value)
 	{
-		int attributeLocation = glGetUniformLocation(m_RendererID, uniformName.c_str());
-		glUniform1i(attributeLocation, data);
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &value, sizeof(value)))
+			glUniform3f(uniform->Location, value.x, value.y, value.z);
 	}
 
-	void Shader::SetUniform4m(const std::string& uniformName, const glm::mat4& matrix)
+	void Shader::SetUniform4f(uint64_t nameHash, const glm::vec4& value)
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_RendererID, uniformName.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &value, sizeof(value)))
+			glUniform4f(uniform->Location, value.x, value.y, value.z, value.w);
 	}
 
-}
+	void Shader::SetUniform4m(uint64_t nameHash, const glm::mat4& matrix)
+	{
+		if (ShaderUniform* uniform = PrepareSet(nameHash, &matrix, sizeof(matrix)))
+			glUniformMatrix4fv(uniform->Location, 1, GL_FALSE, glm::value_ptr(matrix));
+	}
 
+	const Shader::Statistics& Shader::GetStatistics()
+	{
+		return s_Statistics;
+	}
+
+	void Shader::ResetStatistics()
+	{
+		s_Statistics = Statistics();
+	}
+}
@@ -1,28 +1,144 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 #include <glm/glm.hpp>
+#include "Hash.h"
+#include "ShaderCache.h"
 
 namespace OpenGLSandbox {
 
+	class ShaderCompiler;
+
+	enum class ShaderStatus
+	{
+		Compiling = 0, Ready, Failed
+	};
+
+	struct ShaderUniform
+	{
+		std::string Name;		// without the "[0]" suffix of arrays
+		uint64_t NameHash = 0;
+		int Location = -1;
+		unsigned int Type = 0;	// GL type enum
+		int Count = 1;			// array length
+		uint32_t CacheOffset = 0;	// last value set, in the program's uniform cache
+		uint32_t CacheSize = 0;
+		bool Cached = false;
+	};
+
+	struct ShaderAttribute
+	{
+		std::string Name;
+		uint64_t NameHash = 0;
+		int Location = -1;
+		unsigned int Type = 0;
+		int Count = 1;
+	};
+
+	struct ShaderUniformBlock
+	{
+		std::string Name;
+		uint64_t NameHash = 0;
+		unsigned int Index = 0;
+		int DataSize = 0;	// bytes, as laid out by the driver
+	};
+
+	// A linked program with every active uniform, attribute and uniform block reflected at link time.
+	// Uniforms are found by the FNV-1a hash of their name, so a caller can hash the name once, e.g.
+	//     static constexpr uint64_t ColorUniform = Hash::FNV1a("u_Color");
+	// and setting a uniform never goes to the driver for a location. The setters remember the last
+	// value of every uniform and skip the GL call when it didn't change; a set that reaches GL makes
+	// the program current through RenderState.
+	// With a ShaderCache the program is loaded from its cached binary when the sources are unchanged.
+	// A shader created with a ShaderCompiler is built in the background and binds the compiler's
+	// fallback program until it is ready; uniform sets before that are dropped.
 	class Shader
 	{
 	public:
-		Shader(const std::string& vertexSrc, const std::string& fragmentSrc);
+		struct Statistics
+		{
+			uint32_t UniformCalls = 0;		// glUniform* calls issued
+			uint32_t SkippedUniformCalls = 0;	// sets that matched the cached value
+			uint32_t UnknownUniforms = 0;	// sets of names the program doesn't have
+		};
+
+	public:
+		// Blocks until the program is linked.
+		Shader(const std::string& vertexSrc, const std::string& fragmentSrc, ShaderCache* cache = nullptr);
+		// Returns right away, the compiler finishes the build; the compiler must outlive the shader.
+		Shader(const std::string& vertexSrc, const std::string& fragmentSrc, ShaderCompiler& compiler);
 		~Shader();
 
+		Shader(const Shader&) = delete;
+		Shader& operator=(const Shader&) = delete;
+
+		inline ShaderStatus GetStatus() const { return m_Status; }
+		inline bool IsReady() const { return m_Status == ShaderStatus::Ready; }
+
 		void Bind();
 		void Unbind();
-		void SetUniform4f(const std::string& uniformName, float x, float y, float z, float w);
-		void SetUniform1i(const std::string& uniformName, int data);
-		void SetUniform4m(const std::string& uniformName, const glm::mat4& matrix);
+
+		void SetUniform1i(uint64_t nameHash, int value);
+		void SetUniform1f(uint64_t nameHash, float value);
+		void SetUniform2f(uint64_t nameHash, const glm::vec2& value);
+		void SetUniform3f(uint64_t nameHash, const glm::vec3& value);
+		void SetUniform4f(uint64_t nameHash, const glm::vec4& value);
+		void SetUniform4m(uint64_t nameHash, const glm::mat4& matrix);
+
+		inline void SetUniform1i(std::string_view uniformName, int value) { SetUniform1i(Hash::FNV1a(uniformName), value); }
+		inline void SetUniform1f(std::string_view uniformName, float value) { SetUniform1f(Hash::FNV1a(uniformName), value); }
+		inline void SetUniform2f(std::string_view uniformName, const glm::vec2& value) { SetUniform2f(Hash::FNV1a(uniformName), value); }
+		inline void SetUniform3f(std::string_view uniformName, const glm::vec3& value) { SetUniform3f(Hash::FNV1a(uniformName), value); }
+		inline void SetUniform4f(std::string_view uniformName, float x, float y, float z, float w) { SetUniform4f(Hash::FNV1a(uniformName), glm::vec4(x, y, z, w)); }
+		inline void SetUniform4m(std::string_view uniformName, const glm::mat4& matrix) { SetUniform4m(Hash::FNV1a(uniformName), matrix); }
+
+		// Uniform blocks are matched by name; the block reads from whatever buffer is bound at the binding point.
+		// While compiling the binding is remembered and applied once the program is ready.
+		bool BindUniformBlock(std::string_view blockName, unsigned int binding);
+
+		const ShaderUniform* FindUniform(uint64_t nameHash) const;
+		const ShaderAttribute* FindAttribute(uint64_t nameHash) const;
+		inline const std::vector<ShaderUniform>& GetUniforms() const { return m_Uniforms; }
+		inline const std::vector<ShaderAttribute>& GetAttributes() const { return m_Attributes; }
+		inline const std::vector<ShaderUniformBlock>& GetUniformBlocks() const { return m_UniformBlocks; }
 
 		inline unsigned int GetRendererID() { return m_RendererID; }
+
+		// Counted across all programs; reset once per frame.
+		static const Statistics& GetStatistics();
+		static void ResetStatistics();
 	private:
-		std::string ReadFromFile(const char* filepath);
-		unsigned int Compile(const std::string& vertexSrc, const std::string& fragmentSrc);
-		
+		friend class ShaderCompiler;
+
+		void StartBuild(ShaderCache* cache);
+		// Returns true once the build is finished. Unless wait is set, only asks the driver whether it is done.
+		bool PollBuild(bool wait, bool parallel);
+		void FinishBuild();
+		void Reflect();
+
+		// Returns the uniform to update, or nullptr when the program doesn't have it or the value is cached.
+		ShaderUniform* PrepareSet(uint64_t nameHash, const void* value, uint32_t size);
+
 	private:
-		unsigned int m_RendererID;
+		unsigned int m_RendererID = 0;
+		ShaderStatus m_Status = ShaderStatus::Compiling;
+
+		// only kept while compiling; the sources point into the FileSystem mapping
+		std::string m_VertexFilepath, m_FragmentFilepath;
+		std::string_view m_VertexSource, m_FragmentSource;
+		unsigned int m_VertexShaderID = 0, m_FragmentShaderID = 0;
+		ShaderCache* m_Cache = nullptr;
+		uint64_t m_SourceKey = 0;
+
+		ShaderCompiler* m_Compiler = nullptr;
+		std::vector<std::pair<uint64_t, unsigned int>> m_BlockBindings;	// block name hash, binding
+
+		// sorted by NameHash
+		std::vector<ShaderUniform> m_Uniforms;
+		std::vector<ShaderAttribute> m_Attributes;
+		std::vector<ShaderUniformBlock> m_UniformBlocks;
+		std::vector<uint8_t> m_UniformCache;
 	};
 }
-
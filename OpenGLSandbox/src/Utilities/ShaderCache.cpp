@@ -0,0 +1,257 @@
+#include "ShaderCache.h"
+#include <glad/glad.h>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Shader.h"
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static constexpr char ProgramMagic[8] = { 'O', 'G', 'S', 'P', 'R', 'O', 'G', '\0' };
+
+		struct ProgramHeader
+		{
+			char Magic[8];
+			uint32_t Version;
+			uint32_t HeaderSize;
+			uint64_t SourceKey;
+			uint64_t DriverKey;
+			uint64_t PayloadChecksum;	// over the binary
+			uint64_t FileSize;
+			uint32_t BinaryFormat;
+			uint32_t BinarySize;
+		};
+
+		static uint64_t ComputeDriverKey()
+		{
+			uint64_t key = Hash::Combine(Hash::FNVOffsetBasis, ShaderCache::Version);
+			for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION })
+			{
+				const char* string = (const char*)glGetString(name);
+				key = Hash::FNV1a(std::string_view(string ? string : ""), key);
+				key = Hash::Combine(key, '\0');
+			}
+			return key;
+		}
+	}
+
+	ShaderCache::ShaderCache(const std::string& directory)
+		: m_Directory(directory)
+	{
+		// glProgramBinary is core in 4.1 and only loaded on 3.3 contexts whose driver exposes it
+		GLint formats = 0;
+		if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		m_Supported = formats > 0;
+		m_DriverKey = Utils::ComputeDriverKey();
+	}
+
+	ShaderCache::~ShaderCache()
+	{
+	}
+
+	unsigned int ShaderCache::Load(const std::string& name, uint64_t sourceKey)
+	{
+		if (!m_Supported) {
+			m_Statistics.Misses++;
+			return 0;
+		}
+
+		std::string filepath = GetFilepath(name);
+		MappedFile file;
+		if (!file.Open(filepath)) {
+			m_Statistics.Misses++;
+			return 0;
+		}
+
+		const unsigned char* data = file.GetData();
+		uint64_t size = file.GetSize();
+
+		Utils::ProgramHeader header = {};
+		bool valid = size >= sizeof(header);
+		if (valid) {
+			memcpy(&header, data, sizeof(header));
+			valid = memcmp(header.Magic, Utils::ProgramMagic, sizeof(header.Magic)) == 0
+				&& header.Version == Version
+				&& header.HeaderSize == sizeof(header)
+				&& header.FileSize == size
+				&& header.BinarySize == size - sizeof(header)
+				&& header.PayloadChecksum == Hash::Checksum(data + sizeof(header), header.BinarySize);
+		}
+		if (!valid)
+			std::cout << "ShaderCache: " << filepath << " is corrupt or from another version, recompiling " << name << std::endl;
+		else if (header.DriverKey != m_DriverKey)
+			std::cout << "ShaderCache: " << filepath << " was built by another driver, recompiling " << name << std::endl;
+		if (!valid || header.SourceKey != sourceKey || header.DriverKey != m_DriverKey) {
+			m_Statistics.Misses++;
+			return 0;
+		}
+
+		unsigned int program = glCreateProgram();
+		glProgramBinary(program, header.BinaryFormat, data + sizeof(header), (GLsizei)header.BinarySize);
+
+		// a driver may still refuse a binary, e.g. after an update that kept the version string
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			std::cout << "ShaderCache: driver rejected " << filepath << ", recompiling " << name << std::endl;
+			glDeleteProgram(program);
+			m_Statistics.Rejected++;
+			m_Statistics.Misses++;
+			return 0;
+		}
+
+		m_Statistics.Hits++;
+		return program;
+	}
+
+	bool ShaderCache::Store(const std::string& name, uint64_t sourceKey, unsigned int program)
+	{
+		if (!m_Supported || !program)
+			return false;
+
+		GLint linked = GL_FALSE, length = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (!linked || length <= 0)
+			return false;
+
+		Utils::ProgramHeader header = {};
+		std::vector<unsigned char> file(sizeof(header) + length);
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &format, file.data() + sizeof(header));
+		if (written <= 0)
+			return false;
+		file.resize(sizeof(header) + written);
+
+		memcpy(header.Magic, Utils::ProgramMagic, sizeof(header.Magic));
+		header.Version = Version;
+		header.HeaderSize = sizeof(header);
+		header.SourceKey = sourceKey;
+		header.DriverKey = m_DriverKey;
+		header.FileSize = file.size();
+		header.BinaryFormat = format;
+		header.BinarySize = (uint32_t)written;
+		header.PayloadChecksum = Hash::Checksum(file.data() + sizeof(header), header.BinarySize);
+		memcpy(file.data(), &header, sizeof(header));
+
+		// write next to the destination and rename, so a crash never leaves a half written binary behind
+		std::string filepath = GetFilepath(name);
+		std::error_code error;
+		std::filesystem::create_directories(m_Directory, error);
+
+		std::string temporary = filepath + ".tmp";
+		{
+			std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+			if (!stream.write((const char*)file.data(), file.size()))
+				return false;
+		}
+		std::filesystem::rename(temporary, filepath, error);
+		if (error) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	std::string ShaderCache::GetFilepath(const std::string& name) const
+	{
+		std::ostringstream filename;
+		filename << std::hex << std::setw(16) << std::setfill('0') << Hash::FNV1a(name) << ".glbin";
+		return (std::filesystem::path(m_Directory) / filename.str()).string();
+	}
+
+	uint64_t ShaderCache::ComputeSourceKey(std::string_view vertexSrc, std::string_view fragmentSrc)
+	{
+		uint64_t key = Hash::FNV1a(vertexSrc);
+		key = Hash::Combine(key, (uint64_t)vertexSrc.size());
+		key = Hash::FNV1a(fragmentSrc, key);
+		return Hash::Combine(key, (uint64_t)fragmentSrc.size());
+	}
+
+	void ShaderCache::RunBenchmark(std::ostream& out)
+	{
+		const std::pair<const char*, const char*> programs[] = {
+			{ "res/Shaders/QuadVertexShader.shader", "res/Shaders/QuadFragmentShader.shader" },
+			{ "res/Shaders/ScreenVertex.shader", "res/Shaders/ScreenFragment.shader" },
+			{ "res/Shaders/TextV.shader", "res/Shaders/TextF.shader" },
+		};
+		const std::string directory = "cache/ShaderBenchmark";
+		constexpr int Repeats = 10;
+
+		out << "driver: " << glGetString(GL_VENDOR) << " / " << glGetString(GL_RENDERER) << " / " << glGetString(GL_VERSION) << std::endl;
+		if (strstr((const char*)glGetString(GL_VERSION), "Mesa"))
+			out << "note: Mesa's own shader cache makes repeated compiles cheaper than a true cold start (disabling it disables program binaries too)" << std::endl;
+
+		// reads the link status so drivers that link lazily finish the work inside the timed region
+		auto createPrograms = [&](ShaderCache* cache, std::vector<std::unique_ptr<Shader>>& shaders)
+		{
+			shaders.clear();
+			auto start = std::chrono::steady_clock::now();
+			for (const auto& [vertex, fragment] : programs)
+			{
+				shaders.push_back(std::make_unique<Shader>(vertex, fragment, cache));
+				GLint linked;
+				glGetProgramiv(shaders.back()->GetRendererID(), GL_LINK_STATUS, &linked);
+			}
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			return elapsed.count();
+		};
+
+		std::vector<std::unique_ptr<Shader>> reference, shaders;
+		double uncached = 0.0, cold = 0.0, warm = 0.0;
+		uint32_t hits = 0;
+		bool supported = true, identical = true;
+		for (int i = 0; i < Repeats; i++)
+		{
+			uncached += createPrograms(nullptr, reference);
+
+			std::error_code error;
+			std::filesystem::remove_all(directory, error);
+			{
+				ShaderCache cache(directory);
+				supported = cache.IsSupported();
+				cold += createPrograms(&cache, shaders);
+			}
+			ShaderCache cache(directory);
+			warm += createPrograms(&cache, shaders);
+			hits += cache.GetStatistics().Hits;
+
+			// a program loaded from a binary must expose the same interface as the compiled one
+			for (size_t p = 0; p < shaders.size(); p++)
+			{
+				const auto& a = reference[p]->GetUniforms();
+				const auto& b = shaders[p]->GetUniforms();
+				identical &= a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+					[](const ShaderUniform& x, const ShaderUniform& y) { return x.NameHash == y.NameHash && x.Type == y.Type; });
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+		if (!supported) {
+			out << "  the driver offers no program binary formats, every start compiles from source" << std::endl;
+			return;
+		}
+
+		out << "  " << std::size(programs) << " programs, average of " << Repeats << " runs" << std::endl;
+		out << "  from source, no cache    ms: " << uncached / Repeats << std::endl;
+		out << "  cold cache, compile+store ms: " << cold / Repeats << std::endl;
+		out << "  warm cache, load binary   ms: " << warm / Repeats << "  speedup: " << uncached / warm
+			<< "  hits: " << hits << "/" << Repeats * std::size(programs)
+			<< "  same uniforms: " << (identical ? "yes" : "NO") << std::endl;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// On-disk cache of linked program binaries (glGetProgramBinary), one file per program. A binary
+	// is only used when both the GLSL sources and the driver's vendor, renderer and version strings
+	// match the ones it was built with; anything else, including a binary the driver rejects, is a
+	// miss and the caller compiles from source as usual.
+	class ShaderCache
+	{
+	public:
+		static constexpr uint32_t Version = 1;
+
+		struct Statistics
+		{
+			uint32_t Hits = 0;
+			uint32_t Misses = 0;
+			uint32_t Rejected = 0;	// binaries the driver refused to load
+		};
+
+	public:
+		// Needs a current GL context.
+		ShaderCache(const std::string& directory);
+		~ShaderCache();
+
+		// False when the driver offers no binary formats; Load then always misses and Store does nothing.
+		inline bool IsSupported() const { return m_Supported; }
+
+		// name identifies the program across runs, e.g. its source paths. Returns 0 on a miss.
+		unsigned int Load(const std::string& name, uint64_t sourceKey);
+		bool Store(const std::string& name, uint64_t sourceKey, unsigned int program);
+
+		inline const Statistics& GetStatistics() const { return m_Statistics; }
+
+		static uint64_t ComputeSourceKey(std::string_view vertexSrc, std::string_view fragmentSrc);
+
+		// Times creating the sample's programs from source, into an empty cache and from a warm cache.
+		// Needs a current GL context.
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		std::string GetFilepath(const std::string& name) const;
+
+	private:
+		std::string m_Directory;
+		uint64_t m_DriverKey = 0;
+		bool m_Supported = false;
+		Statistics m_Statistics;
+	};
+}
@@ -0,0 +1,134 @@
+#include "ShaderCompiler.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <iterator>
+
+namespace OpenGLSandbox {
+
+	namespace Utils {
+
+		static bool HasExtension(const char* name)
+		{
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++)
+			{
+				const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+				if (extension && strcmp(extension, name) == 0)
+					return true;
+			}
+			return false;
+		}
+	}
+
+	ShaderCompiler::ShaderCompiler(ShaderCache* cache)
+		: m_Cache(cache)
+	{
+		m_Parallel = Utils::HasExtension("GL_KHR_parallel_shader_compile") || Utils::HasExtension("GL_ARB_parallel_shader_compile");
+		// tiny, so building it synchronously costs nothing; it has to work before anything else does
+		m_Fallback = std::make_unique<Shader>("res/Shaders/FallbackVertex.shader", "res/Shaders/FallbackFragment.shader", m_Cache);
+	}
+
+	ShaderCompiler::~ShaderCompiler()
+	{
+		for (Shader* shader : m_Pending)
+			shader->m_Compiler = nullptr;
+	}
+
+	void ShaderCompiler::Poll()
+	{
+		// without the extension any query blocks until the program is done, so only take the oldest one
+		size_t count = m_Parallel ? m_Pending.size() : std::min<size_t>(m_Pending.size(), 1);
+		auto finished = std::remove_if(m_Pending.begin(), m_Pending.begin() + count, [this](Shader* shader)
+		{
+			if (!shader->PollBuild(!m_Parallel, m_Parallel))
+				return false;
+			(shader->IsReady() ? m_Ready : m_Failed)++;
+			return true;
+		});
+		m_Pending.erase(finished, m_Pending.begin() + count);
+	}
+
+	void ShaderCompiler::WaitAll()
+	{
+		for (Shader* shader : m_Pending)
+		{
+			shader->PollBuild(true, m_Parallel);
+			(shader->IsReady() ? m_Ready : m_Failed)++;
+		}
+		m_Pending.clear();
+	}
+
+	ShaderCompiler::Statistics ShaderCompiler::GetStatistics() const
+	{
+		Statistics statistics;
+		statistics.Pending = (uint32_t)m_Pending.size();
+		statistics.Ready = m_Ready;
+		statistics.Failed = m_Failed;
+		return statistics;
+	}
+
+	void ShaderCompiler::Add(Shader* shader)
+	{
+		m_Pending.push_back(shader);
+	}
+
+	void ShaderCompiler::Remove(Shader* shader)
+	{
+		m_Pending.erase(std::remove(m_Pending.begin(), m_Pending.end(), shader), m_Pending.end());
+	}
+
+	void ShaderCompiler::RunBenchmark(std::ostream& out)
+	{
+		const std::pair<const char*, const char*> programs[] = {
+			{ "res/Shaders/QuadVertexShader.shader", "res/Shaders/QuadFragmentShader.shader" },
+			{ "res/Shaders/ScreenVertex.shader", "res/Shaders/ScreenFragment.shader" },
+			{ "res/Shaders/TextV.shader", "res/Shaders/TextF.shader" },
+		};
+		constexpr int Repeats = 10;
+		using Milliseconds = std::chrono::duration<double, std::milli>;
+
+		ShaderCompiler compiler;
+		out << "  parallel compile extension: " << (compiler.IsParallel() ? "yes" : "no, one program per poll") << std::endl;
+
+		double blocking = 0.0, submit = 0.0, longestPoll = 0.0, ready = 0.0;
+		int polls = 0;
+		uint32_t failed = 0;
+		for (int i = 0; i < Repeats; i++)
+		{
+			std::vector<std::unique_ptr<Shader>> shaders;
+			auto start = std::chrono::steady_clock::now();
+			for (const auto& [vertex, fragment] : programs)
+				shaders.push_back(std::make_unique<Shader>(vertex, fragment));
+			blocking += Milliseconds(std::chrono::steady_clock::now() - start).count();
+			shaders.clear();
+
+			start = std::chrono::steady_clock::now();
+			for (const auto& [vertex, fragment] : programs)
+				shaders.push_back(std::make_unique<Shader>(vertex, fragment, compiler));
+			submit += Milliseconds(std::chrono::steady_clock::now() - start).count();
+
+			// one poll per frame, with the rest of the frame spent elsewhere
+			while (compiler.GetStatistics().Pending)
+			{
+				auto pollStart = std::chrono::steady_clock::now();
+				compiler.Poll();
+				longestPoll = std::max(longestPoll, Milliseconds(std::chrono::steady_clock::now() - pollStart).count());
+				polls++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			ready += Milliseconds(std::chrono::steady_clock::now() - start).count();
+			failed = compiler.GetStatistics().Failed;
+		}
+
+		out << "  " << std::size(programs) << " programs, average of " << Repeats << " runs" << std::endl;
+		out << "  blocking compile            ms: " << blocking / Repeats << std::endl;
+		out << "  submit without waiting      ms: " << submit / Repeats << std::endl;
+		out << "  longest single poll         ms: " << longestPoll << std::endl;
+		out << "  all ready after             ms: " << ready / Repeats << "  (" << (double)polls / Repeats << " polls, 1 ms apart)"
+			<< "  failed: " << failed << std::endl;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include "Shader.h"
+#include "ShaderCache.h"
+
+namespace OpenGLSandbox {
+
+	// Builds programs without stalling the frame. A Shader created with the compiler issues its
+	// compile and link right away and returns; Poll, once per frame, finishes the programs the driver
+	// is done with. With KHR_parallel_shader_compile the driver compiles on its own threads and Poll
+	// only asks for the completion status, without it Poll finishes one program per call. Until then
+	// the shader draws with a flat magenta fallback program.
+	class ShaderCompiler
+	{
+	public:
+		struct Statistics
+		{
+			uint32_t Pending = 0;
+			uint32_t Ready = 0;		// finished here, cache hits are ready on creation
+			uint32_t Failed = 0;
+		};
+
+	public:
+		// Needs a current GL context. The cache, if any, must outlive the compiler.
+		ShaderCompiler(ShaderCache* cache = nullptr);
+		~ShaderCompiler();
+
+		void Poll();
+		// Finishes every pending program, blocking until the driver is done.
+		void WaitAll();
+
+		inline bool IsParallel() const { return m_Parallel; }
+		inline ShaderCache* GetCache() const { return m_Cache; }
+		inline Shader& GetFallback() { return *m_Fallback; }
+		Statistics GetStatistics() const;
+
+		// Times creating the sample's programs synchronously against submitting them all and polling
+		// once per simulated frame. Needs a current GL context.
+		static void RunBenchmark(std::ostream& out);
+
+	private:
+		friend class Shader;
+		void Add(Shader* shader);
+		void Remove(Shader* shader);
+
+	private:
+		ShaderCache* m_Cache;
+		bool m_Parallel = false;
+		std::unique_ptr<Shader> m_Fallback;
+		std::vector<Shader*> m_Pending;	// in submission order
+		uint32_t m_Ready = 0, m_Failed = 0;
+	};
+}
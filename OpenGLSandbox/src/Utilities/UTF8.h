@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	namespace UTF8 {
+
+		constexpr uint32_t ReplacementCharacter = 0xFFFD;
+
+		/// Decodes the codepoint at it and advances past it. Malformed, overlong and surrogate
+		/// sequences yield U+FFFD and consume a single byte, so decoding always makes progress.
+		inline uint32_t Next(const char*& it, const char* end)
+		{
+			unsigned char lead = (unsigned char)*it++;
+			if (lead < 0x80)
+				return lead;
+
+			int length;
+			uint32_t codepoint, minimum;
+			if ((lead & 0xE0) == 0xC0) { length = 1; codepoint = lead & 0x1F; minimum = 0x80; }
+			else if ((lead & 0xF0) == 0xE0) { length = 2; codepoint = lead & 0x0F; minimum = 0x800; }
+			else if ((lead & 0xF8) == 0xF0) { length = 3; codepoint = lead & 0x07; minimum = 0x10000; }
+			else
+				return ReplacementCharacter;
+
+			if (end - it < length)
+				return ReplacementCharacter;
+			for (int i = 0; i < length; i++)
+			{
+				unsigned char continuation = (unsigned char)it[i];
+				if ((continuation & 0xC0) != 0x80)
+					return ReplacementCharacter;
+				codepoint = (codepoint << 6) | (continuation & 0x3F);
+			}
+
+			if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+				return ReplacementCharacter;
+			it += length;
+			return codepoint;
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#include "UniformBuffer.h"
+#include <glad/glad.h>
+#include <cstring>
+#include "Renderer/RenderState.h"
+
+namespace OpenGLSandbox {
+
+	UniformBuffer::UniformBuffer(uint32_t size, uint32_t binding)
+		: m_Binding(binding), m_Data(size, 0)
+	{
+		glGenBuffers(1, &m_RendererID);
+		RenderState::BindBuffer(GL_UNIFORM_BUFFER, m_RendererID);
+		// starts zeroed like the CPU copy, so the copy always matches the buffer
+		glBufferData(GL_UNIFORM_BUFFER, size, m_Data.data(), GL_DYNAMIC_DRAW);
+		RenderState::BindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_RendererID);
+	}
+
+	UniformBuffer::~UniformBuffer()
+	{
+		RenderState::DeleteBuffer(m_RendererID);
+	}
+
+	void UniformBuffer::SetData(const void* data, uint32_t size, uint32_t offset)
+	{
+		if (offset + size > m_Data.size())
+			return;
+		if (memcmp(&m_Data[offset], data, size) == 0)
+			return;
+
+		memcpy(&m_Data[offset], data, size);
+		RenderState::BindBuffer(GL_UNIFORM_BUFFER, m_RendererID);
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	}
+}
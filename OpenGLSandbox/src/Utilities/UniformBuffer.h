@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// A std140 uniform buffer attached to a fixed binding point, for data that several programs
+	// share, e.g. per frame matrices. Programs pick it up with Shader::BindUniformBlock. A CPU copy
+	// of the contents lets SetData skip uploads of unchanged bytes.
+	class UniformBuffer
+	{
+	public:
+		UniformBuffer(uint32_t size, uint32_t binding);
+		~UniformBuffer();
+
+		void SetData(const void* data, uint32_t size, uint32_t offset = 0);
+
+		inline uint32_t GetBinding() const { return m_Binding; }
+		inline unsigned int GetRendererID() const { return m_RendererID; }
+
+	private:
+		unsigned int m_RendererID = 0;
+		uint32_t m_Binding = 0;
+		std::vector<uint8_t> m_Data;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace OpenGLSandbox {
+
+	// Bounded Chase-Lev deque of pointers (Lê et al., "Correct and Efficient Work-Stealing for Weak
+	// Memory Models"). The owning thread pushes and pops at the bottom, last in first out, so it keeps
+	// working on what it touched last; any other thread steals from the top, taking the oldest and
+	// usually largest piece of work. Only a steal and the pop of the last item race, on m_Top.
+	// Capacity must be a power of two.
+	template<typename T, uint32_t Capacity>
+	class WorkStealingDeque
+	{
+		static_assert(Capacity && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		// owner only; false when full
+		bool Push(T* item)
+		{
+			int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+			int64_t top = m_Top.load(std::memory_order_acquire);
+			if (bottom - top >= (int64_t)Capacity)
+				return false;
+			m_Items[bottom & (Capacity - 1)].store(item, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		// owner only; nullptr when empty
+		T* Pop()
+		{
+			int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+			m_Bottom.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t top = m_Top.load(std::memory_order_relaxed);
+			if (top > bottom) {
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+				return nullptr;
+			}
+
+			T* item = m_Items[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+			if (top == bottom) {
+				// the last item, thieves may be after it too
+				if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					item = nullptr;
+				m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+			return item;
+		}
+
+		// any thread; nullptr when empty or another thread got there first
+		T* Steal()
+		{
+			int64_t top = m_Top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+			if (top >= bottom)
+				return nullptr;
+
+			T* item = m_Items[top & (Capacity - 1)].load(std::memory_order_relaxed);
+			if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				return nullptr;
+			return item;
+		}
+
+		// a snapshot, exact only on the owner thread while nobody steals
+		inline bool IsEmpty() const
+		{
+			return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+		}
+
+	private:
+		alignas(64) std::atomic<int64_t> m_Top{ 0 };
+		alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+		std::atomic<T*> m_Items[Capacity];
+	};
+}